@@ -49,6 +49,12 @@ endif
 include common_features.mk
 include $(TMK_PATH)/common.mk
 include $(QUANTUM_PATH)/serial_link/tests/rules.mk
+include $(QUANTUM_PATH)/split_common/tests/rules.mk
+include $(DRIVER_PATH)/ugfx/gdisp/st7565/tests/rules.mk
+include $(DRIVER_PATH)/arm/tests/rules.mk
+include $(QUANTUM_PATH)/visualizer/tests/rules.mk
+include $(QUANTUM_PATH)/tests/rules.mk
+include $(QUANTUM_PATH)/audio/tests/rules.mk
 ifneq ($(filter $(FULL_TESTS),$(TEST)),)
 include build_full_test.mk
 endif
@@ -36,8 +36,10 @@ ifeq ($(strip $(AUDIO_ENABLE)), yes)
     SRC += $(QUANTUM_DIR)/process_keycode/process_audio.c
     ifeq ($(PLATFORM),AVR)
         SRC += $(QUANTUM_DIR)/audio/audio.c
+        SRC += $(QUANTUM_DIR)/audio/note_periods.c
     else
         SRC += $(QUANTUM_DIR)/audio/audio_arm.c
+        SRC += $(QUANTUM_DIR)/audio/synth.c
     endif
     SRC += $(QUANTUM_DIR)/audio/voices.c
     SRC += $(QUANTUM_DIR)/audio/luts.c
@@ -104,15 +106,29 @@ endif
 ifeq ($(strip $(RGBLIGHT_ENABLE)), yes)
     OPT_DEFS += -DRGBLIGHT_ENABLE
     SRC += $(QUANTUM_DIR)/rgblight.c
+    SRC += $(QUANTUM_DIR)/led_frame.c
+    SRC += $(QUANTUM_DIR)/rgblight_output.c
     CIE1931_CURVE = yes
     LED_BREATHING_TABLE = yes
     ifeq ($(strip $(RGBLIGHT_CUSTOM_DRIVER)), yes)
         OPT_DEFS += -DRGBLIGHT_CUSTOM_DRIVER
     else
 	    SRC += ws2812.c
+	    ifeq ($(PLATFORM),CHIBIOS)
+	        SRC += ws2812_encoder.c
+	    endif
     endif
 endif
 
+ifeq ($(strip $(RGB_MATRIX_ENABLE)), yes)
+    OPT_DEFS += -DRGB_MATRIX_ENABLE
+    SRC += $(QUANTUM_DIR)/rgb_matrix.c
+endif
+
+ifneq ($(filter yes,$(strip $(RGBLIGHT_ENABLE)) $(strip $(RGB_MATRIX_ENABLE))),)
+    SRC += $(QUANTUM_DIR)/color.c
+endif
+
 ifeq ($(strip $(TAP_DANCE_ENABLE)), yes)
     OPT_DEFS += -DTAP_DANCE_ENABLE
     SRC += $(QUANTUM_DIR)/process_keycode/process_tap_dance.c
@@ -190,6 +206,19 @@ QUANTUM_SRC:= \
     $(QUANTUM_DIR)/keycode_config.c \
     $(QUANTUM_DIR)/process_keycode/process_leader.c
 
+ifeq ($(strip $(SPLIT_KEYBOARD)), yes)
+    OPT_DEFS += -DSPLIT_KEYBOARD
+    QUANTUM_SRC += $(QUANTUM_DIR)/split_common/split_util.c \
+                   $(QUANTUM_DIR)/split_common/split_transport.c \
+                   $(QUANTUM_DIR)/split_common/i2c.c \
+                   $(QUANTUM_DIR)/split_common/serial.c
+    VPATH += $(QUANTUM_PATH)/split_common
+endif
+
 ifndef CUSTOM_MATRIX
-    QUANTUM_SRC += $(QUANTUM_DIR)/matrix.c
+    ifeq ($(strip $(SPLIT_KEYBOARD)), yes)
+        QUANTUM_SRC += $(QUANTUM_DIR)/split_common/matrix.c
+    else
+        QUANTUM_SRC += $(QUANTUM_DIR)/matrix.c
+    endif
 endif
@@ -0,0 +1,3 @@
+ws2812_encoder_SRC :=\
+	$(DRIVER_PATH)/arm/tests/ws2812_encoder_tests.cpp \
+	$(DRIVER_PATH)/arm/ws2812_encoder.c
\ No newline at end of file
@@ -0,0 +1,2 @@
+TEST_LIST +=\
+	ws2812_encoder
\ No newline at end of file
@@ -0,0 +1,124 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <vector>
+extern "C" {
+#include "arm/ws2812_encoder.h"
+}
+
+// WS2812B datasheet timing in nanoseconds, each +-150ns
+static const double t0h = 400;
+static const double t0l = 850;
+static const double t1h = 800;
+static const double t1l = 450;
+static const double tolerance = 150;
+static const double reset = 280000;
+
+// Decodes the SPI output the way the LEDs see it, checking the length of
+// every pulse
+class WS2812Receiver {
+public:
+  WS2812Receiver(double spi_hz) : bit_ns(1e9 / spi_hz) {}
+
+  void receive(const std::vector<uint8_t>& stream) {
+    std::vector<double> pulses;
+    bool level = false;
+    double length = 0;
+    for (uint8_t byte : stream) {
+      for (int bit = 7; bit >= 0; bit--) {
+        bool b = byte & (1 << bit);
+        if (b != level && length > 0) {
+          pulses.push_back(length);
+          length = 0;
+        }
+        level = b;
+        length += bit_ns;
+      }
+    }
+    ASSERT_FALSE(level) << "The line has to stay low after the frame";
+    pulses.push_back(length);
+
+    uint8_t byte = 0;
+    int bits = 0;
+    for (size_t i = 0; i + 1 < pulses.size(); i += 2) {
+      double high = pulses[i];
+      double low = pulses[i + 1];
+      bool last = i + 2 >= pulses.size();
+      bool one = high > (t0h + t1h) / 2;
+      EXPECT_NEAR(high, one ? t1h : t0h, tolerance) << "bit " << bits;
+      if (last) {
+        EXPECT_GE(low, reset);
+      } else {
+        EXPECT_NEAR(low, one ? t1l : t0l, tolerance) << "bit " << bits;
+      }
+      byte = (byte << 1) | one;
+      if (++bits % 8 == 0) {
+        data.push_back(byte);
+      }
+    }
+    EXPECT_EQ(bits % 8, 0);
+  }
+
+  double bit_ns;
+  std::vector<uint8_t> data;
+};
+
+static std::vector<uint8_t> encode(const std::vector<uint8_t>& data) {
+  std::vector<uint8_t> out(WS2812_ENCODED_SIZE(data.size()), 0xAA);
+  uint16_t length = ws2812_encode(data.data(), data.size(), out.data());
+  EXPECT_EQ(length, out.size());
+  return out;
+}
+
+TEST(WS2812Encoder, encodes_every_byte_value) {
+  std::vector<uint8_t> data;
+  for (int i = 0; i < 256; i++) {
+    data.push_back(i);
+  }
+  WS2812Receiver receiver(2250000);
+  receiver.receive(encode(data));
+  EXPECT_EQ(receiver.data, data);
+}
+
+TEST(WS2812Encoder, meets_the_timing_at_the_fastest_spi_clock) {
+  std::vector<uint8_t> data = {0x00, 0xFF, 0x55, 0xAA, 0x0F, 0xF0};
+  WS2812Receiver receiver(2700000);
+  receiver.receive(encode(data));
+  EXPECT_EQ(receiver.data, data);
+}
+
+TEST(WS2812Encoder, each_byte_becomes_three) {
+  uint8_t data[] = {0x80};
+  uint8_t out[WS2812_ENCODED_SIZE(1)];
+  ws2812_encode(data, 1, out);
+  // 110 100 100 100 100 100 100 100
+  EXPECT_EQ(out[0], 0xD2);
+  EXPECT_EQ(out[1], 0x49);
+  EXPECT_EQ(out[2], 0x24);
+}
+
+TEST(WS2812Encoder, ends_with_the_reset) {
+  std::vector<uint8_t> out = encode({0xFF});
+  for (size_t i = 3; i < out.size(); i++) {
+    EXPECT_EQ(out[i], 0) << "at " << i;
+  }
+}
+
+TEST(WS2812Encoder, an_empty_frame_is_only_the_reset) {
+  uint8_t out[WS2812_ENCODED_SIZE(0)];
+  EXPECT_EQ(ws2812_encode(NULL, 0, out), WS2812_RESET_BYTES);
+}
@@ -0,0 +1,91 @@
+/*
+Copyright 2018 Fred Sundvik
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ws2812.h"
+#include "ws2812_encoder.h"
+#include "ch.h"
+#include "hal.h"
+#include "config.h"
+
+// The SPI configuration uses the STM32 registers
+#if !defined(STM32F0XX) && !defined(STM32F1XX) && !defined(STM32F3XX) && \
+    !defined(STM32F4XX) && !defined(STM32F7XX) && !defined(STM32L0XX) && \
+    !defined(STM32L4XX)
+#error "The WS2812 SPI driver only supports STM32 MCUs, use RGBLIGHT_CUSTOM_DRIVER on other boards"
+#endif
+
+#ifndef WS2812_SPI
+#define WS2812_SPI SPID1
+#endif
+
+// Divides a 72MHz bus clock by 32
+#ifndef WS2812_SPI_BAUD
+#define WS2812_SPI_BAUD (SPI_CR1_BR_2)
+#endif
+
+// The MOSI pin depends on the board, and the alternate function on the MCU
+#if !defined(WS2812_MOSI_PORT) || !defined(WS2812_MOSI_PAD) || !defined(WS2812_MOSI_PAL_MODE)
+#error "Define WS2812_MOSI_PORT, WS2812_MOSI_PAD and WS2812_MOSI_PAL_MODE in config.h"
+#endif
+
+#define WS2812_MAX_DATA (RGBLED_NUM * sizeof(LED_TYPE))
+
+static const SPIConfig spi_config = {
+  .end_cb = NULL,
+  .cr1 = WS2812_SPI_BAUD,
+#ifdef SPI_CR2_DS
+  // 8 bit frames
+  .cr2 = SPI_CR2_DS_2 | SPI_CR2_DS_1 | SPI_CR2_DS_0,
+#endif
+};
+
+// The DMA reads the frame from here while it's being sent
+static uint8_t encoded[WS2812_ENCODED_SIZE(WS2812_MAX_DATA)];
+static bool initialized = false;
+
+static void ws2812_init(void) {
+  palSetPadMode(WS2812_MOSI_PORT, WS2812_MOSI_PAD, PAL_MODE_ALTERNATE(WS2812_MOSI_PAL_MODE));
+  spiStart(&WS2812_SPI, &spi_config);
+  initialized = true;
+}
+
+void ws2812_setleds(LED_TYPE *ledarray, uint16_t number_of_leds) {
+  ws2812_sendarray((uint8_t*)ledarray, number_of_leds * sizeof(LED_TYPE));
+}
+
+// The LED type includes the white channel when RGBW is defined
+void ws2812_setleds_rgbw(LED_TYPE *ledarray, uint16_t number_of_leds) {
+  ws2812_sendarray((uint8_t*)ledarray, number_of_leds * sizeof(LED_TYPE));
+}
+
+void ws2812_sendarray(uint8_t *data, uint16_t length) {
+  if (!initialized) {
+    ws2812_init();
+  }
+  if (length > WS2812_MAX_DATA) {
+    length = WS2812_MAX_DATA;
+  }
+
+  // A frame takes around 1ms for 30 LEDs, so the previous one has normally
+  // been sent long ago
+  while (WS2812_SPI.state == SPI_ACTIVE) {
+    chThdYield();
+  }
+
+  uint16_t encoded_length = ws2812_encode(data, length, encoded);
+  spiStartSend(&WS2812_SPI, encoded_length, encoded);
+}
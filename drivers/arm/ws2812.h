@@ -0,0 +1,43 @@
+/*
+Copyright 2018 Fred Sundvik
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WS2812_H
+#define WS2812_H
+
+#include <stdint.h>
+#include "rgblight_types.h"
+
+/* The same interface as the AVR driver, but the LED data is sent in the
+ * background by the SPI peripheral and its DMA, so the keyboard keeps running
+ * and interrupts stay enabled. Only the MOSI pin is used, connect it to the
+ * data input of the first LED.
+ *
+ * Options for config.h:
+ * WS2812_SPI           The SPI driver, SPID1 by default
+ * WS2812_SPI_BAUD      The SPI_CR1_BR bits that give a 2.25 - 2.7MHz clock,
+ *                      the default divides a 72MHz bus clock by 32
+ * WS2812_MOSI_PORT     The port and pad of the MOSI pin, and the alternate
+ * WS2812_MOSI_PAD      function that connects it to the SPI peripheral
+ * WS2812_MOSI_PAL_MODE
+ */
+
+void ws2812_setleds     (LED_TYPE *ledarray, uint16_t number_of_leds);
+void ws2812_setleds_rgbw(LED_TYPE *ledarray, uint16_t number_of_leds);
+
+void ws2812_sendarray(uint8_t *array, uint16_t length);
+
+#endif
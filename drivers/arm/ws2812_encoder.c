@@ -0,0 +1,39 @@
+/*
+Copyright 2018 Fred Sundvik
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ws2812_encoder.h"
+
+// The SPI bits for each nibble of LED data, a nibble becomes 12 bits
+static const uint16_t nibble_bits[16] = {
+  04444, 04446, 04464, 04466, 04644, 04646, 04664, 04666,
+  06444, 06446, 06464, 06466, 06644, 06646, 06664, 06666,
+};
+
+uint16_t ws2812_encode(const uint8_t* data, uint16_t length, uint8_t* out) {
+  uint8_t* start = out;
+  for (uint16_t i = 0; i < length; i++) {
+    uint16_t high = nibble_bits[data[i] >> 4];
+    uint16_t low = nibble_bits[data[i] & 0xF];
+    *out++ = high >> 4;
+    *out++ = (high << 4) | (low >> 8);
+    *out++ = low;
+  }
+  for (uint8_t i = 0; i < WS2812_RESET_BYTES; i++) {
+    *out++ = 0;
+  }
+  return out - start;
+}
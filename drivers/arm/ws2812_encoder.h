@@ -0,0 +1,41 @@
+/*
+Copyright 2018 Fred Sundvik
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WS2812_ENCODER_H
+#define WS2812_ENCODER_H
+
+#include <stdint.h>
+
+// The WS2812 data is sent through the MOSI pin of a SPI peripheral. Each
+// bit of LED data becomes three SPI bits, 100 for a zero and 110 for a one,
+// so with a SPI clock of 2.25 - 2.7MHz the pulses match the WS2812 timing.
+// The low time between the frames, which latches the colors, is sent as
+// WS2812_RESET_BYTES zero bytes after the data.
+
+// At least 280us at 2.7MHz, which is enough for the newer WS2812B that need
+// a longer reset than the 50us of the original WS2812
+#ifndef WS2812_RESET_BYTES
+#define WS2812_RESET_BYTES 96
+#endif
+
+#define WS2812_ENCODED_SIZE(length) ((length) * 3 + WS2812_RESET_BYTES)
+
+// Encodes length bytes of LED data, out has to fit WS2812_ENCODED_SIZE(length)
+// bytes. Returns the number of bytes to send, including the reset.
+uint16_t ws2812_encode(const uint8_t* data, uint16_t length, uint8_t* out);
+
+#endif
@@ -27,6 +27,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "src/gdisp/gdisp_driver.h"
 
 #include "board_is31fl3731c.h"
+#include "led_power.h"
 
 
 // Can't include led_tables from here
@@ -43,6 +44,15 @@ extern const uint8_t CIE1931_CURVE[];
     #define GDISP_INITIAL_BACKLIGHT   0
 #endif
 
+// The total current the LEDs are allowed to draw in mA, and the average
+// current of a single LED at full brightness. The chip drives one of its nine
+// rows at a time, so that's about a ninth of the current set by Rext.
+#ifdef IS31_MAX_CURRENT
+    #ifndef IS31_LED_CURRENT
+        #define IS31_LED_CURRENT 2
+    #endif
+#endif
+
 #define GDISP_FLG_NEEDFLUSH           (GDISP_FLG_DRIVER<<0)
 
 #define IS31_ADDR_DEFAULT 0x74
@@ -95,6 +105,9 @@ extern const uint8_t CIE1931_CURVE[];
 
 #define IS31_PWM_REG 0x24
 #define IS31_PWM_SIZE 0x90
+// The PWM registers are laid out as 9 rows of 16 LEDs
+#define IS31_PWM_ROW_SIZE 0x10
+#define IS31_PWM_ROWS (IS31_PWM_SIZE / IS31_PWM_ROW_SIZE)
 
 #define IS31_LED_MASK_SIZE 0x12
 
@@ -108,6 +121,8 @@ typedef struct{
     uint8_t write_buffer_offset;
     uint8_t write_buffer[IS31_FRAME_SIZE];
     uint8_t frame_buffer[GDISP_SCREEN_HEIGHT * GDISP_SCREEN_WIDTH];
+    // The PWM values last written to the two frames that are flipped between
+    uint8_t pwm_shadow[2][IS31_PWM_SIZE];
     uint8_t page;
 }__attribute__((__packed__)) PrivData;
 
@@ -139,6 +154,30 @@ static GFXINLINE void write_ram(GDisplay *g, uint8_t page, uint16_t offset, uint
     write_data(g, (uint8_t*)PRIV(g), length + 1);
 }
 
+// Writes the PWM rows of the current page that differ from what it had
+// before, returns the number of rows written
+static uint8_t write_dirty_pwm_rows(GDisplay *g) {
+    uint8_t* shadow = PRIV(g)->pwm_shadow[PRIV(g)->page];
+    uint8_t written = 0;
+    for (uint8_t row = 0; row < IS31_PWM_ROWS; row++) {
+        uint8_t offset = row * IS31_PWM_ROW_SIZE;
+        uint8_t* src = PRIV(g)->write_buffer + offset;
+        if (__builtin_memcmp(src, shadow + offset, IS31_PWM_ROW_SIZE) == 0) {
+            continue;
+        }
+        if (written == 0) {
+            write_page(g, PRIV(g)->page);
+        }
+        uint8_t tx[IS31_PWM_ROW_SIZE + 1] __attribute__((aligned(2)));
+        tx[0] = IS31_PWM_REG + offset;
+        __builtin_memcpy(tx + 1, src, IS31_PWM_ROW_SIZE);
+        write_data(g, tx, sizeof(tx));
+        __builtin_memcpy(shadow + offset, src, IS31_PWM_ROW_SIZE);
+        written++;
+    }
+    return written;
+}
+
 LLDSPEC bool_t gdisp_lld_init(GDisplay *g) {
     // The private area is the display surface.
     g->priv = gfxAlloc(sizeof(PrivData));
@@ -191,12 +230,6 @@ LLDSPEC bool_t gdisp_lld_init(GDisplay *g) {
         if (!(g->flags & GDISP_FLG_NEEDFLUSH))
             return;
 
-        PRIV(g)->page++;
-        PRIV(g)->page %= 2;
-        // TODO: some smarter algorithm for this
-        // We should run only one physical page at a time
-        // This way we don't need to send so much data, and
-        // we could use slightly less memory
         uint8_t* src = PRIV(g)->frame_buffer;
         for (int y=0;y<GDISP_SCREEN_HEIGHT;y++) {
             for (int x=0;x<GDISP_SCREEN_WIDTH;x++) {
@@ -205,8 +238,39 @@ LLDSPEC bool_t gdisp_lld_init(GDisplay *g) {
                 ++src;
             }
         }
-        write_ram(g, PRIV(g)->page, IS31_PWM_REG, IS31_PWM_SIZE);
-        gfxSleepMilliseconds(1);
+
+#ifdef IS31_MAX_CURRENT
+        // The PWM values of the LEDs that are masked off don't draw any
+        // current. They still hold the LED mask copied in at init, or the
+        // unmapped pixels, so they are cleared before the frame is summed.
+        const uint8_t* mask = get_led_mask(g);
+        for (uint8_t i = 0; i < IS31_PWM_SIZE; i++) {
+            if (!(mask[i / 8] & (1 << (i % 8)))) {
+                PRIV(g)->write_buffer[i] = 0;
+            }
+        }
+        // Only the PWM values are scaled, the write buffer is filled from
+        // the frame buffer again on every flush
+        led_power_limit(PRIV(g)->write_buffer, IS31_PWM_SIZE, IS31_LED_CURRENT, IS31_MAX_CURRENT);
+#endif
+
+        // Nothing to do if the frame on display already has these values,
+        // this is common for keyframes that redraw everything on each step
+        uint8_t* displayed = PRIV(g)->pwm_shadow[PRIV(g)->page];
+        if (__builtin_memcmp(PRIV(g)->write_buffer, displayed, IS31_PWM_SIZE) == 0) {
+            g->flags &= ~GDISP_FLG_NEEDFLUSH;
+            return;
+        }
+
+        // Two of the hardware frames are used for double buffering, the
+        // frame that is not on display is updated and then shown, so there's
+        // no tearing. Only the rows that have changed since that frame was
+        // last written are sent.
+        PRIV(g)->page++;
+        PRIV(g)->page %= 2;
+        if (write_dirty_pwm_rows(g) > 0) {
+            gfxSleepMilliseconds(1);
+        }
         write_register(g, IS31_FUNCTIONREG, IS31_REG_PICTDISP, PRIV(g)->page);
 
         g->flags &= ~GDISP_FLG_NEEDFLUSH;
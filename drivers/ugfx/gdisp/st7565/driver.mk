@@ -1,3 +1,4 @@
 GFXINC += drivers/ugfx/gdisp/st7565
 GFXSRC += drivers/ugfx/gdisp/st7565/gdisp_lld_ST7565.c
+GFXSRC += drivers/ugfx/gdisp/st7565/st7565_dirty.c
 GDISP_DRIVER_LIST += GDISPVMT_ST7565_QMK
\ No newline at end of file
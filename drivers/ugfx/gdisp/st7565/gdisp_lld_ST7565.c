@@ -35,6 +35,7 @@
 #define GDISP_FLG_NEEDFLUSH         (GDISP_FLG_DRIVER<<0)
 
 #include "st7565.h"
+#include "st7565_dirty.h"
 
 /*===========================================================================*/
 /* Driver config defaults for backward compatibility.                        */
@@ -56,11 +57,17 @@
 /* Driver local functions.                                                   */
 /*===========================================================================*/
 
+#define GDISP_SCREEN_PAGES          (GDISP_SCREEN_HEIGHT / 8)
+
 typedef struct{
     bool_t buffer2;
     uint8_t data_pos;
     uint8_t data[16];
     uint8_t ram[GDISP_SCREEN_HEIGHT * GDISP_SCREEN_WIDTH / 8];
+    // What has been sent to each of the two buffers of the controller
+    uint8_t shadow[2][GDISP_SCREEN_HEIGHT * GDISP_SCREEN_WIDTH / 8];
+    // The number of buffers with unknown contents
+    uint8_t full_flushes;
 }PrivData;
 
 // Some common routines and macros
@@ -95,6 +102,8 @@ static GFXINLINE void flush_cmd(GDisplay* g) {
  * the entire display surface in memory so that we can do the necessary bit
  * operations. Fortunately it is a small display in monochrome.
  * 64 * 128 / 8 = 1024 bytes.
+ * Two more copies of it are kept, one per controller buffer, so that only
+ * the changed columns have to be sent when flushing.
  */
 
 LLDSPEC bool_t gdisp_lld_init(GDisplay *g) {
@@ -102,6 +111,7 @@ LLDSPEC bool_t gdisp_lld_init(GDisplay *g) {
     g->priv = gfxAlloc(sizeof(PrivData));
     PRIV(g)->buffer2 = false;
     PRIV(g)->data_pos = 0;
+    PRIV(g)->full_flushes = 2;
 
     // Initialise the board interface
     init_board(g);
@@ -149,27 +159,35 @@ LLDSPEC bool_t gdisp_lld_init(GDisplay *g) {
 }
 
 #if GDISP_HARDWARE_FLUSH
-LLDSPEC void gdisp_lld_flush(GDisplay *g) {
-    unsigned    p;
+static void write_columns(void* arg, uint8_t page, uint8_t column, const uint8_t* data, uint8_t length) {
+    GDisplay* g = (GDisplay*)arg;
+    unsigned dstOffset = (PRIV(g)->buffer2 ? GDISP_SCREEN_PAGES : 0);
+    write_cmd(g, ST7565_PAGE | (page + dstOffset));
+    write_cmd(g, ST7565_COLUMN_MSB | (column >> 4));
+    write_cmd(g, ST7565_COLUMN_LSB | (column & 0xF));
+    write_cmd(g, ST7565_RMW);
+    flush_cmd(g);
+    enter_data_mode(g);
+    write_data(g, (uint8_t*)data, length);
+    enter_cmd_mode(g);
+}
 
+LLDSPEC void gdisp_lld_flush(GDisplay *g) {
     // Don't flush if we don't need it.
     if (!(g->flags & GDISP_FLG_NEEDFLUSH))
         return;
 
     acquire_bus(g);
     enter_cmd_mode(g);
-    unsigned dstOffset = (PRIV(g)->buffer2 ? 4 : 0);
-    for (p = 0; p < 4; p++) {
-        write_cmd(g, ST7565_PAGE | (p + dstOffset));
-        write_cmd(g, ST7565_COLUMN_MSB | 0);
-        write_cmd(g, ST7565_COLUMN_LSB | 0);
-        write_cmd(g, ST7565_RMW);
-        flush_cmd(g);
-        enter_data_mode(g);
-        write_data(g, RAM(g) + (p*GDISP_SCREEN_WIDTH), GDISP_SCREEN_WIDTH);
-        enter_cmd_mode(g);
+    // The controller is double buffered, so the buffer that is written now
+    // is compared with what it got two flushes ago
+    bool full = PRIV(g)->full_flushes > 0;
+    st7565_flush_dirty(RAM(g), PRIV(g)->shadow[PRIV(g)->buffer2 ? 1 : 0],
+            GDISP_SCREEN_WIDTH, GDISP_SCREEN_PAGES, full, write_columns, g);
+    if (full) {
+        PRIV(g)->full_flushes--;
     }
-    unsigned line = (PRIV(g)->buffer2 ? 32 : 0);
+    unsigned line = (PRIV(g)->buffer2 ? GDISP_SCREEN_HEIGHT : 0);
     write_cmd(g, ST7565_START_LINE | line);
     flush_cmd(g);
     PRIV(g)->buffer2 = !PRIV(g)->buffer2;
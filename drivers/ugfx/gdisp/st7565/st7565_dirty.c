@@ -0,0 +1,55 @@
+/*
+Copyright 2018 Fred Sundvik <fsundvik@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "st7565_dirty.h"
+#include <string.h>
+
+bool st7565_find_dirty_columns(const uint8_t* ram, const uint8_t* shadow, uint8_t width,
+        uint8_t* first, uint8_t* last) {
+    uint8_t begin = 0;
+    while (begin < width && ram[begin] == shadow[begin]) {
+        begin++;
+    }
+    if (begin == width) {
+        return false;
+    }
+    uint8_t end = width - 1;
+    while (ram[end] == shadow[end]) {
+        end--;
+    }
+    *first = begin;
+    *last = end;
+    return true;
+}
+
+uint16_t st7565_flush_dirty(const uint8_t* ram, uint8_t* shadow, uint8_t width, uint8_t pages,
+        bool full, st7565_write_columns_t write, void* arg) {
+    uint16_t written = 0;
+    for (uint8_t page = 0; page < pages; page++) {
+        const uint8_t* ram_page = ram + page * width;
+        uint8_t* shadow_page = shadow + page * width;
+        uint8_t first = 0;
+        uint8_t last = width - 1;
+        if (full || st7565_find_dirty_columns(ram_page, shadow_page, width, &first, &last)) {
+            uint8_t length = last - first + 1;
+            write(arg, page, first, ram_page + first, length);
+            memcpy(shadow_page + first, ram_page + first, length);
+            written += length;
+        }
+    }
+    return written;
+}
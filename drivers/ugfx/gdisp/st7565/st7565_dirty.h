@@ -0,0 +1,46 @@
+/*
+Copyright 2018 Fred Sundvik <fsundvik@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _ST7565_DIRTY_H
+#define _ST7565_DIRTY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// The controller is written a page (8 pixel rows) at a time, starting from
+// any column. A flush only sends the columns of each page that differ from
+// what the controller already has, which is kept in a shadow copy. Layer
+// name changes and similar small updates then only cost a few bytes, even
+// when the keyframe redraws the whole screen.
+
+// Called for each run of changed columns, the data has to be written to the
+// given page starting at column
+typedef void (*st7565_write_columns_t)(void* arg, uint8_t page, uint8_t column,
+    const uint8_t* data, uint8_t length);
+
+// Finds the first and the last column of a page that differ between ram and
+// shadow. Returns false if the page hasn't changed.
+bool st7565_find_dirty_columns(const uint8_t* ram, const uint8_t* shadow, uint8_t width,
+    uint8_t* first, uint8_t* last);
+
+// Writes the changed columns of all pages and updates the shadow to match.
+// If full is set every page is written, which is needed when the contents
+// of the controller are unknown. Returns the number of data bytes written.
+uint16_t st7565_flush_dirty(const uint8_t* ram, uint8_t* shadow, uint8_t width, uint8_t pages,
+    bool full, st7565_write_columns_t write, void* arg);
+
+#endif
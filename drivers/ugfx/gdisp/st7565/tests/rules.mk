@@ -0,0 +1,3 @@
+st7565_dirty_SRC :=\
+	$(DRIVER_PATH)/ugfx/gdisp/st7565/tests/st7565_dirty_tests.cpp \
+	$(DRIVER_PATH)/ugfx/gdisp/st7565/st7565_dirty.c
@@ -0,0 +1,196 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <cstring>
+#include <cstdlib>
+extern "C" {
+#include "ugfx/gdisp/st7565/st7565_dirty.h"
+}
+
+// The size of the Infinity Ergodox LCD
+static const uint8_t width = 128;
+static const uint8_t pages = 4;
+static const unsigned screen_size = width * pages;
+
+// The number of command bytes the driver sends before each run of columns
+static const unsigned command_bytes = 4;
+
+// Emulates the display memory of the controller, with the two buffers that
+// the driver flips between, and counts the bytes sent to it
+class EmulatedST7565 {
+public:
+    EmulatedST7565() {
+        // the contents are random when the controller is powered on
+        for (unsigned i = 0; i < sizeof(memory); i++) {
+            memory[i] = rand();
+        }
+        start_page = 0;
+        buffer2 = false;
+        full_flushes = 2;
+        bytes = 0;
+        memset(ram, 0, sizeof(ram));
+        memset(shadow, 0, sizeof(shadow));
+    }
+
+    // The same steps as gdisp_lld_flush
+    unsigned flush() {
+        unsigned before = bytes;
+        bool full = full_flushes > 0;
+        st7565_flush_dirty(ram, shadow[buffer2 ? 1 : 0], width, pages, full, write_columns, this);
+        if (full) {
+            full_flushes--;
+        }
+        start_page = buffer2 ? pages : 0;
+        bytes++;
+        buffer2 = !buffer2;
+        return bytes - before;
+    }
+
+    bool shows_ram() {
+        return memcmp(memory + start_page * width, ram, screen_size) == 0;
+    }
+
+    void fill(uint8_t page, uint8_t first, uint8_t last, uint8_t value) {
+        for (unsigned i = first; i <= last; i++) {
+            ram[page * width + i] = value;
+        }
+    }
+
+    void clear() {
+        memset(ram, 0, sizeof(ram));
+    }
+
+    uint8_t ram[screen_size];
+    unsigned bytes;
+
+private:
+    static void write_columns(void* arg, uint8_t page, uint8_t column, const uint8_t* data, uint8_t length) {
+        EmulatedST7565* lcd = static_cast<EmulatedST7565*>(arg);
+        uint8_t hw_page = page + (lcd->buffer2 ? pages : 0);
+        EXPECT_LE(column + length, width);
+        memcpy(lcd->memory + hw_page * width + column, data, length);
+        lcd->bytes += command_bytes + length;
+    }
+
+    uint8_t memory[2 * screen_size];
+    uint8_t shadow[2][screen_size];
+    uint8_t start_page;
+    bool buffer2;
+    uint8_t full_flushes;
+};
+
+class ST7565Dirty : public testing::Test {
+protected:
+    // Gets both controller buffers in sync with the ram
+    void settle() {
+        lcd.flush();
+        lcd.flush();
+    }
+
+    EmulatedST7565 lcd;
+};
+
+TEST_F(ST7565Dirty, finds_no_columns_in_identical_pages) {
+    uint8_t a[width] = {0};
+    uint8_t b[width] = {0};
+    uint8_t first, last;
+    EXPECT_FALSE(st7565_find_dirty_columns(a, b, width, &first, &last));
+}
+
+TEST_F(ST7565Dirty, finds_the_range_of_changed_columns) {
+    uint8_t a[width] = {0};
+    uint8_t b[width] = {0};
+    a[5] = 1;
+    a[17] = 2;
+    uint8_t first, last;
+    EXPECT_TRUE(st7565_find_dirty_columns(a, b, width, &first, &last));
+    EXPECT_EQ(first, 5);
+    EXPECT_EQ(last, 17);
+    b[127] = 3;
+    b[0] = 3;
+    EXPECT_TRUE(st7565_find_dirty_columns(a, b, width, &first, &last));
+    EXPECT_EQ(first, 0);
+    EXPECT_EQ(last, 127);
+}
+
+TEST_F(ST7565Dirty, writes_both_buffers_completely_at_startup) {
+    unsigned full_frame = 1 + pages * (command_bytes + width);
+    EXPECT_EQ(lcd.flush(), full_frame);
+    EXPECT_TRUE(lcd.shows_ram());
+    EXPECT_EQ(lcd.flush(), full_frame);
+    EXPECT_TRUE(lcd.shows_ram());
+    EXPECT_EQ(lcd.flush(), 1);
+    EXPECT_TRUE(lcd.shows_ram());
+}
+
+TEST_F(ST7565Dirty, sends_only_the_changed_columns_to_both_buffers) {
+    settle();
+    // a new layer name in the middle of the screen
+    lcd.fill(1, 40, 79, 0x5A);
+    lcd.fill(2, 40, 79, 0xA5);
+    unsigned frame = 1 + 2 * (command_bytes + 40);
+    EXPECT_EQ(lcd.flush(), frame);
+    EXPECT_TRUE(lcd.shows_ram());
+    // the other buffer still has the old name
+    EXPECT_EQ(lcd.flush(), frame);
+    EXPECT_TRUE(lcd.shows_ram());
+    EXPECT_EQ(lcd.flush(), 1);
+    EXPECT_TRUE(lcd.shows_ram());
+}
+
+TEST_F(ST7565Dirty, redrawing_the_same_screen_sends_nothing) {
+    lcd.fill(0, 0, 127, 0xFF);
+    lcd.fill(3, 10, 20, 0x81);
+    settle();
+    for (int i = 0; i < 10; i++) {
+        // keyframes clear the screen and draw everything again
+        lcd.clear();
+        lcd.fill(0, 0, 127, 0xFF);
+        lcd.fill(3, 10, 20, 0x81);
+        EXPECT_EQ(lcd.flush(), 1);
+        EXPECT_TRUE(lcd.shows_ram());
+    }
+}
+
+TEST_F(ST7565Dirty, alternating_frames_are_shown_correctly) {
+    settle();
+    for (int i = 0; i < 6; i++) {
+        lcd.clear();
+        if (i & 1) {
+            lcd.fill(2, 0, 9, 0x0F);
+        }
+        lcd.flush();
+        EXPECT_TRUE(lcd.shows_ram());
+    }
+}
+
+TEST_F(ST7565Dirty, random_drawing_always_shows_the_ram) {
+    srand(1234);
+    settle();
+    unsigned total = 0;
+    const int frames = 200;
+    for (int i = 0; i < frames; i++) {
+        uint8_t page = rand() % pages;
+        uint8_t first = rand() % width;
+        uint8_t last = first + rand() % (width - first);
+        lcd.fill(page, first, last, rand());
+        total += lcd.flush();
+        ASSERT_TRUE(lcd.shows_ram());
+    }
+    // small changes should cost much less than full frames
+    EXPECT_LT(total, frames * pages * width / 2);
+}
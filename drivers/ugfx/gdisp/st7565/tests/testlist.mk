@@ -0,0 +1,2 @@
+TEST_LIST +=\
+	st7565_dirty
\ No newline at end of file
@@ -220,9 +220,8 @@ static void update_emulated_leds(visualizer_state_t* state, visualizer_keyboard_
 static void update_lcd_text(visualizer_state_t* state, visualizer_keyboard_status_t* prev_status) {
     if (state->status.leds) {
         if (lcd_state != LCD_STATE_BITMAP_AND_LEDS ||
-                state->status.leds != prev_status->leds ||
-                state->status.layer != prev_status->layer ||
-                state->status.default_layer != prev_status->default_layer) {
+                (state->changes & (VISUALIZER_CHANGED_LEDS | VISUALIZER_CHANGED_LAYER |
+                    VISUALIZER_CHANGED_DEFAULT_LAYER))) {
 
             // NOTE: that it doesn't matter if the animation isn't playing, stop will do nothing in that case
             stop_keyframe_animation(&lcd_bitmap_animation);
@@ -235,8 +234,7 @@ static void update_lcd_text(visualizer_state_t* state, visualizer_keyboard_statu
         }
     } else {
         if (lcd_state != LCD_STATE_LAYER_BITMAP ||
-                state->status.layer != prev_status->layer ||
-                state->status.default_layer != prev_status->default_layer) {
+                (state->changes & (VISUALIZER_CHANGED_LAYER | VISUALIZER_CHANGED_DEFAULT_LAYER))) {
 
             stop_keyframe_animation(&lcd_bitmap_leds_animation);
 
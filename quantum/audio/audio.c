@@ -24,6 +24,7 @@
 #endif
 #include "print.h"
 #include "audio.h"
+#include "note_periods.h"
 #include "keymap.h"
 #include "wait.h"
 
@@ -76,45 +77,87 @@
 // -----------------------------------------------------------------------------
 
 
+// The interrupts only use integer math. The notes are converted to pitches,
+// see note_periods.h, outside of them, and the pitches are turned into timer
+// periods with a table lookup. The glissando, vibrato and polyphony are
+// stepped by the length of the last period. Only the AUDIO_VOICES voices
+// other than the default one still use float math in the interrupt.
+
+// Rests keep the timer running with this period, so their length can be
+// measured, with the output off
+#define NOTE_REST_PERIOD (NOTE_PERIOD_CLOCK / 1000)
+
 int voices = 0;
 int voice_place = 0;
-float frequency = 0;
-float frequency_alt = 0;
+uint16_t pitch = 0;
+uint16_t pitch_alt = 0;
 int volume = 0;
 long position = 0;
 
 float frequencies[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+uint16_t pitches[8] = {0, 0, 0, 0, 0, 0, 0, 0};
 int volumes[8] = {0, 0, 0, 0, 0, 0, 0, 0};
 bool sliding = false;
 
-float place = 0;
+// Timer ticks since polyphony switched voices
+uint32_t place = 0;
 
 uint8_t * sample;
 uint16_t sample_length = 0;
 
 bool     playing_notes = false;
 bool     playing_note = false;
-float    note_frequency = 0;
-float    note_length = 0;
+uint16_t note_pitch_current = 0;
 uint8_t  note_tempo = TEMPO_DEFAULT;
 float    note_timbre = TIMBRE_DEFAULT;
-uint16_t note_position = 0;
+// The length of the current note and how much of it has been played, in timer ticks
+uint32_t note_ticks = 0;
+uint32_t note_elapsed = 0;
 float (* notes_pointer)[][2];
 uint16_t notes_count;
 bool     notes_repeat;
 bool     note_resting = false;
 
-uint8_t current_note = 0;
+uint16_t current_note = 0;
 uint8_t rest_counter = 0;
 
+// The notes of the song, converted to a pitch and a length in timer ticks.
+// play_notes converts the first ones, and audio_task the rest, a few notes
+// ahead of the interrupt, so long songs don't need a buffer of their own.
+#ifndef AUDIO_SONG_QUEUE_SIZE
+    #define AUDIO_SONG_QUEUE_SIZE 8
+#endif
+
+typedef struct {
+    uint16_t pitch;
+    uint32_t ticks;
+} song_note_t;
+
+static song_note_t song_queue[AUDIO_SONG_QUEUE_SIZE];
+// Written by audio_task and play_notes
+static volatile uint8_t song_queue_head = 0;
+// Written by the interrupt
+static volatile uint8_t song_queue_tail = 0;
+// Set when the last note of the song is in the queue, current_note is the
+// next one to convert until then
+static volatile bool song_queue_done = false;
+
 #ifdef VIBRATO_ENABLE
-float vibrato_counter = 0;
 float vibrato_strength = .5;
 float vibrato_rate = 0.125;
+note_vibrato_t vibrato;
 #endif
 
 float polyphony_rate = 0;
 
+// note_timbre in 8.8 fixed point, and the timer ticks polyphony plays each
+// voice for, 0 when it's off
+uint16_t note_duty = TIMBRE_DEFAULT * 256;
+uint32_t polyphony_ticks = 0;
+// The values note_duty and polyphony_ticks were converted from
+static float rates_timbre = TIMBRE_DEFAULT;
+static float rates_polyphony = 0;
+
 static bool audio_initialized = false;
 
 audio_config_t audio_config;
@@ -135,6 +178,29 @@ float startup_song[][2] = STARTUP_SONG;
 float audio_on_song[][2] = AUDIO_ON_SONG;
 float audio_off_song[][2] = AUDIO_OFF_SONG;
 
+// Converts the timbre and the polyphony rate for the interrupts, only when
+// the setters or a voice have changed them
+static void update_rates(void) {
+    if (note_timbre != rates_timbre) {
+        rates_timbre = note_timbre;
+        note_duty = note_timbre * 256;
+    }
+    if (polyphony_rate != rates_polyphony) {
+        rates_polyphony = polyphony_rate;
+        polyphony_ticks = polyphony_rate > 0 ? NOTE_PERIOD_CLOCK / (polyphony_rate * CPU_PRESCALER) : 0;
+    }
+}
+
+static void update_vibrato(void) {
+    #ifdef VIBRATO_ENABLE
+        #ifdef VIBRATO_STRENGTH_ENABLE
+            note_vibrato_init(&vibrato, vibrato_rate, vibrato_strength);
+        #else
+            note_vibrato_init(&vibrato, vibrato_rate, vibrato_strength > 0 ? 1 : 0);
+        #endif
+    #endif
+}
+
 void audio_init()
 {
 
@@ -189,6 +255,7 @@ void audio_init()
             TIMER_1_DUTY_CYCLE = (uint16_t)((((float)F_CPU) / (440 * CPU_PRESCALER)) * note_timbre);
         #endif
 
+        update_vibrato();
         audio_initialized = true;
     }
 
@@ -220,13 +287,14 @@ void stop_all_notes()
 
     playing_notes = false;
     playing_note = false;
-    frequency = 0;
-    frequency_alt = 0;
+    pitch = 0;
+    pitch_alt = 0;
     volume = 0;
 
     for (uint8_t i = 0; i < 8; i++)
     {
         frequencies[i] = 0;
+        pitches[i] = 0;
         volumes[i] = 0;
     }
 }
@@ -242,10 +310,13 @@ void stop_note(float freq)
         for (int i = 7; i >= 0; i--) {
             if (frequencies[i] == freq) {
                 frequencies[i] = 0;
+                pitches[i] = 0;
                 volumes[i] = 0;
                 for (int j = i; (j < 7); j++) {
                     frequencies[j] = frequencies[j+1];
                     frequencies[j+1] = 0;
+                    pitches[j] = pitches[j+1];
+                    pitches[j+1] = 0;
                     volumes[j] = volumes[j+1];
                     volumes[j+1] = 0;
                 }
@@ -267,206 +338,190 @@ void stop_note(float freq)
                 DISABLE_AUDIO_COUNTER_1_ISR;
                 DISABLE_AUDIO_COUNTER_1_OUTPUT;
             #endif
-            frequency = 0;
-            frequency_alt = 0;
+            pitch = 0;
+            pitch_alt = 0;
             volume = 0;
             playing_note = false;
         }
     }
 }
 
-#ifdef VIBRATO_ENABLE
-
-float mod(float a, int b)
-{
-    float r = fmod(a, b);
-    return r < 0 ? r + b : r;
+// The default voice only sets the timbre and the glissando, the same for
+// every note, so it's done when play_note or play_notes is called. The other
+// voices change the note while it plays, they still need the float math in
+// the interrupt.
+static void voice_start(float freq) {
+    envelope_index = 0;
+    voice_envelope(freq);
+    update_rates();
 }
 
-float vibrato(float average_freq) {
-    #ifdef VIBRATO_STRENGTH_ENABLE
-        float vibrated_freq = average_freq * pow(vibrato_lut[(int)vibrato_counter], vibrato_strength);
+static inline uint16_t voice_period(uint16_t period) {
+    #ifdef AUDIO_VOICES
+        if (envelope_index < 65535) {
+            envelope_index++;
+        }
+        float freq = voice_envelope((float)NOTE_PERIOD_CLOCK / period);
+        update_rates();
+        if (freq < 30.517578125) {
+            freq = 30.52;
+        }
+        return NOTE_PERIOD_CLOCK / freq;
     #else
-        float vibrated_freq = average_freq * vibrato_lut[(int)vibrato_counter];
+        return period;
     #endif
-    vibrato_counter = mod((vibrato_counter + vibrato_rate * (1.0 + 440.0/average_freq)), VIBRATO_LUT_LENGTH);
-    return vibrated_freq;
 }
 
-#endif
-
-#ifdef C6_AUDIO
-ISR(TIMER3_COMPA_vect)
-{
-    float freq;
+static inline uint16_t duty_cycle(uint16_t period) {
+    return ((uint32_t)period * note_duty) >> 8;
+}
 
-    if (playing_note) {
-        if (voices > 0) {
+// Returns the timer period of a pitch, with the vibrato and the voice, the
+// last period is how long the previous one took
+static inline uint16_t pitch_period(uint16_t p, uint16_t last_period) {
+    #ifdef VIBRATO_ENABLE
+        if (vibrato.strength > 0) {
+            p = note_vibrato(&vibrato, p, last_period);
+        }
+    #endif
+    return voice_period(note_period(p));
+}
 
-            #ifdef B5_AUDIO
-            float freq_alt = 0;
-                if (voices > 1) {
-                    if (polyphony_rate == 0) {
-                        if (glissando) {
-                            if (frequency_alt != 0 && frequency_alt < frequencies[voices - 2] && frequency_alt < frequencies[voices - 2] * pow(2, -440/frequencies[voices - 2]/12/2)) {
-                                frequency_alt = frequency_alt * pow(2, 440/frequency_alt/12/2);
-                            } else if (frequency_alt != 0 && frequency_alt > frequencies[voices - 2] && frequency_alt > frequencies[voices - 2] * pow(2, 440/frequencies[voices - 2]/12/2)) {
-                                frequency_alt = frequency_alt * pow(2, -440/frequency_alt/12/2);
-                            } else {
-                                frequency_alt = frequencies[voices - 2];
-                            }
-                        } else {
-                            frequency_alt = frequencies[voices - 2];
-                        }
-
-                        #ifdef VIBRATO_ENABLE
-                            if (vibrato_strength > 0) {
-                                freq_alt = vibrato(frequency_alt);
-                            } else {
-                                freq_alt = frequency_alt;
-                            }
-                        #else
-                            freq_alt = frequency_alt;
-                        #endif
-                    }
-
-                    if (envelope_index < 65535) {
-                        envelope_index++;
-                    }
-
-                    freq_alt = voice_envelope(freq_alt);
-
-                    if (freq_alt < 30.517578125) {
-                        freq_alt = 30.52;
-                    }
-
-                    TIMER_1_PERIOD = (uint16_t)(((float)F_CPU) / (freq_alt * CPU_PRESCALER));
-                    TIMER_1_DUTY_CYCLE = (uint16_t)((((float)F_CPU) / (freq_alt * CPU_PRESCALER)) * note_timbre);
-                }
-            #endif
+static inline uint16_t glide(uint16_t from, uint16_t to, uint16_t last_period) {
+    if (!glissando || from == 0) {
+        return to;
+    }
+    return note_glide(from, to, last_period);
+}
 
-            if (polyphony_rate > 0) {
-                if (voices > 1) {
-                    voice_place %= voices;
-                    if (place++ > (frequencies[voice_place] / polyphony_rate / CPU_PRESCALER)) {
-                        voice_place = (voice_place + 1) % voices;
-                        place = 0.0;
-                    }
-                }
+// Returns the pitch to play for the notes started with play_note
+static inline uint16_t live_pitch(uint16_t last_period) {
+    if (polyphony_ticks > 0) {
+        if (voices > 1) {
+            voice_place %= voices;
+            place += last_period;
+            if (place > polyphony_ticks) {
+                voice_place = (voice_place + 1) % voices;
+                place = 0;
+            }
+        }
+        return pitches[voice_place];
+    }
+    pitch = glide(pitch, pitches[voices - 1], last_period);
+    return pitch;
+}
 
-                #ifdef VIBRATO_ENABLE
-                    if (vibrato_strength > 0) {
-                        freq = vibrato(frequencies[voice_place]);
-                    } else {
-                        freq = frequencies[voice_place];
-                    }
-                #else
-                    freq = frequencies[voice_place];
-                #endif
+// Converts the next notes of the song, until the queue is full. Called with
+// the interrupts disabled, or with the interrupt running, it only reads the
+// tail.
+static void song_fill_queue(void) {
+    while (!song_queue_done) {
+        uint8_t head = song_queue_head;
+        uint8_t next_head = (head + 1) % AUDIO_SONG_QUEUE_SIZE;
+        if (next_head == song_queue_tail) {
+            return;
+        }
+        song_queue[head].pitch = note_pitch((*notes_pointer)[current_note][0]);
+        song_queue[head].ticks = note_duration((*notes_pointer)[current_note][1], note_tempo);
+        song_queue_head = next_head;
+
+        current_note++;
+        if (current_note >= notes_count) {
+            if (notes_repeat) {
+                current_note = 0;
             } else {
-                if (glissando) {
-                    if (frequency != 0 && frequency < frequencies[voices - 1] && frequency < frequencies[voices - 1] * pow(2, -440/frequencies[voices - 1]/12/2)) {
-                        frequency = frequency * pow(2, 440/frequency/12/2);
-                    } else if (frequency != 0 && frequency > frequencies[voices - 1] && frequency > frequencies[voices - 1] * pow(2, 440/frequencies[voices - 1]/12/2)) {
-                        frequency = frequency * pow(2, -440/frequency/12/2);
-                    } else {
-                        frequency = frequencies[voices - 1];
-                    }
-                } else {
-                    frequency = frequencies[voices - 1];
-                }
-
-                #ifdef VIBRATO_ENABLE
-                    if (vibrato_strength > 0) {
-                        freq = vibrato(frequency);
-                    } else {
-                        freq = frequency;
-                    }
-                #else
-                    freq = frequency;
-                #endif
+                song_queue_done = true;
             }
+        }
+    }
+}
 
-            if (envelope_index < 65535) {
-                envelope_index++;
-            }
+static inline bool song_queue_empty(void) {
+    return song_queue_tail == song_queue_head;
+}
 
-            freq = voice_envelope(freq);
+// Takes the next note from the queue, which must not be empty
+static inline void song_start_note(void) {
+    uint8_t tail = song_queue_tail;
+    note_pitch_current = song_queue[tail].pitch;
+    note_ticks = song_queue[tail].ticks;
+    note_elapsed = 0;
+    song_queue_tail = (tail + 1) % AUDIO_SONG_QUEUE_SIZE;
+    envelope_index = 0;
+}
 
-            if (freq < 30.517578125) {
-                freq = 30.52;
-            }
+// Moves the song forward by one period, returns false when it has ended
+static inline bool song_advance(uint16_t period) {
+    note_elapsed += period;
+    if (note_elapsed + period < note_ticks) {
+        return true;
+    }
 
-            TIMER_3_PERIOD = (uint16_t)(((float)F_CPU) / (freq * CPU_PRESCALER));
-            TIMER_3_DUTY_CYCLE = (uint16_t)((((float)F_CPU) / (freq * CPU_PRESCALER)) * note_timbre);
+    if (song_queue_empty() && song_queue_done) {
+        playing_notes = false;
+        return false;
+    }
+    if (!note_resting) {
+        // Rest for a period between the notes, the rest is silent if the
+        // next note is the same
+        note_resting = true;
+        if (!song_queue_empty() && song_queue[song_queue_tail].pitch == note_pitch_current) {
+            note_pitch_current = 0;
         }
+    } else if (song_queue_empty()) {
+        // audio_task hasn't converted the next note yet, keep resting
+        note_pitch_current = 0;
+    } else {
+        note_resting = false;
+        song_start_note();
+        return true;
     }
+    note_ticks = 0;
+    note_elapsed = 0;
+    return true;
+}
 
-    if (playing_notes) {
-        if (note_frequency > 0) {
-            #ifdef VIBRATO_ENABLE
-                if (vibrato_strength > 0) {
-                    freq = vibrato(note_frequency);
-                } else {
-                    freq = note_frequency;
+void audio_task(void) {
+    if (playing_notes && !song_queue_done) {
+        song_fill_queue();
+    }
+}
+
+#ifdef C6_AUDIO
+ISR(TIMER3_COMPA_vect)
+{
+    if (playing_note) {
+        if (voices > 0) {
+
+            #ifdef B5_AUDIO
+                if (voices > 1 && polyphony_ticks == 0) {
+                    pitch_alt = glide(pitch_alt, pitches[voices - 2], TIMER_1_PERIOD);
+                    uint16_t period_alt = pitch_period(pitch_alt, TIMER_1_PERIOD);
+                    TIMER_1_PERIOD = period_alt;
+                    TIMER_1_DUTY_CYCLE = duty_cycle(period_alt);
                 }
-            #else
-                    freq = note_frequency;
             #endif
 
-            if (envelope_index < 65535) {
-                envelope_index++;
-            }
-            freq = voice_envelope(freq);
-
-            TIMER_3_PERIOD = (uint16_t)(((float)F_CPU) / (freq * CPU_PRESCALER));
-            TIMER_3_DUTY_CYCLE = (uint16_t)((((float)F_CPU) / (freq * CPU_PRESCALER)) * note_timbre);
-        } else {
-            TIMER_3_PERIOD = 0;
-            TIMER_3_DUTY_CYCLE = 0;
+            uint16_t period = pitch_period(live_pitch(TIMER_3_PERIOD), TIMER_3_PERIOD);
+            TIMER_3_PERIOD = period;
+            TIMER_3_DUTY_CYCLE = duty_cycle(period);
         }
+    }
 
-        note_position++;
-        bool end_of_note = false;
-        if (TIMER_3_PERIOD > 0) {
-            if (!note_resting) 
-                end_of_note = (note_position >= (note_length / TIMER_3_PERIOD * 0xFFFF - 1));
-            else
-                end_of_note = (note_position >= (note_length));
-        } else {
-            end_of_note = (note_position >= (note_length));
+    if (playing_notes) {
+        uint16_t period = NOTE_REST_PERIOD;
+        uint16_t duty = 0;
+        if (note_pitch_current > 0) {
+            period = pitch_period(note_pitch_current, TIMER_3_PERIOD);
+            duty = duty_cycle(period);
         }
+        TIMER_3_PERIOD = period;
+        TIMER_3_DUTY_CYCLE = duty;
 
-        if (end_of_note) {
-            current_note++;
-            if (current_note >= notes_count) {
-                if (notes_repeat) {
-                    current_note = 0;
-                } else {
-                    DISABLE_AUDIO_COUNTER_3_ISR;
-                    DISABLE_AUDIO_COUNTER_3_OUTPUT;
-                    playing_notes = false;
-                    return;
-                }
-            }
-            if (!note_resting) {
-                note_resting = true;
-                current_note--;
-                if ((*notes_pointer)[current_note][0] == (*notes_pointer)[current_note + 1][0]) {
-                    note_frequency = 0;
-                    note_length = 1;
-                } else {
-                    note_frequency = (*notes_pointer)[current_note][0];
-                    note_length = 1;
-                }
-            } else {
-                note_resting = false;
-                envelope_index = 0;
-                note_frequency = (*notes_pointer)[current_note][0];
-                note_length = ((*notes_pointer)[current_note][1] / 4) * (((float)note_tempo) / 100);
-            }
-
-            note_position = 0;
+        if (!song_advance(period)) {
+            DISABLE_AUDIO_COUNTER_3_ISR;
+            DISABLE_AUDIO_COUNTER_3_OUTPUT;
+            return;
         }
     }
 
@@ -481,132 +536,28 @@ ISR(TIMER3_COMPA_vect)
 ISR(TIMER1_COMPA_vect)
 {
     #if defined(B5_AUDIO) && !defined(C6_AUDIO)
-    float freq = 0;
-
     if (playing_note) {
         if (voices > 0) {
-            if (polyphony_rate > 0) {
-                if (voices > 1) {
-                    voice_place %= voices;
-                    if (place++ > (frequencies[voice_place] / polyphony_rate / CPU_PRESCALER)) {
-                        voice_place = (voice_place + 1) % voices;
-                        place = 0.0;
-                    }
-                }
-
-                #ifdef VIBRATO_ENABLE
-                    if (vibrato_strength > 0) {
-                        freq = vibrato(frequencies[voice_place]);
-                    } else {
-                        freq = frequencies[voice_place];
-                    }
-                #else
-                    freq = frequencies[voice_place];
-                #endif
-            } else {
-                if (glissando) {
-                    if (frequency != 0 && frequency < frequencies[voices - 1] && frequency < frequencies[voices - 1] * pow(2, -440/frequencies[voices - 1]/12/2)) {
-                        frequency = frequency * pow(2, 440/frequency/12/2);
-                    } else if (frequency != 0 && frequency > frequencies[voices - 1] && frequency > frequencies[voices - 1] * pow(2, 440/frequencies[voices - 1]/12/2)) {
-                        frequency = frequency * pow(2, -440/frequency/12/2);
-                    } else {
-                        frequency = frequencies[voices - 1];
-                    }
-                } else {
-                    frequency = frequencies[voices - 1];
-                }
-
-                #ifdef VIBRATO_ENABLE
-                    if (vibrato_strength > 0) {
-                        freq = vibrato(frequency);
-                    } else {
-                        freq = frequency;
-                    }
-                #else
-                    freq = frequency;
-                #endif
-            }
-
-            if (envelope_index < 65535) {
-                envelope_index++;
-            }
-
-            freq = voice_envelope(freq);
-
-            if (freq < 30.517578125) {
-                freq = 30.52;
-            }
-
-            TIMER_1_PERIOD = (uint16_t)(((float)F_CPU) / (freq * CPU_PRESCALER));
-            TIMER_1_DUTY_CYCLE = (uint16_t)((((float)F_CPU) / (freq * CPU_PRESCALER)) * note_timbre);
+            uint16_t period = pitch_period(live_pitch(TIMER_1_PERIOD), TIMER_1_PERIOD);
+            TIMER_1_PERIOD = period;
+            TIMER_1_DUTY_CYCLE = duty_cycle(period);
         }
     }
 
     if (playing_notes) {
-        if (note_frequency > 0) {
-            #ifdef VIBRATO_ENABLE
-                if (vibrato_strength > 0) {
-                    freq = vibrato(note_frequency);
-                } else {
-                    freq = note_frequency;
-                }
-            #else
-                    freq = note_frequency;
-            #endif
-
-            if (envelope_index < 65535) {
-                envelope_index++;
-            }
-            freq = voice_envelope(freq);
-
-            TIMER_1_PERIOD = (uint16_t)(((float)F_CPU) / (freq * CPU_PRESCALER));
-            TIMER_1_DUTY_CYCLE = (uint16_t)((((float)F_CPU) / (freq * CPU_PRESCALER)) * note_timbre);
-        } else {
-            TIMER_1_PERIOD = 0;
-            TIMER_1_DUTY_CYCLE = 0;
+        uint16_t period = NOTE_REST_PERIOD;
+        uint16_t duty = 0;
+        if (note_pitch_current > 0) {
+            period = pitch_period(note_pitch_current, TIMER_1_PERIOD);
+            duty = duty_cycle(period);
         }
+        TIMER_1_PERIOD = period;
+        TIMER_1_DUTY_CYCLE = duty;
 
-        note_position++;
-        bool end_of_note = false;
-        if (TIMER_1_PERIOD > 0) {
-            if (!note_resting) 
-                end_of_note = (note_position >= (note_length / TIMER_1_PERIOD * 0xFFFF - 1));
-            else
-                end_of_note = (note_position >= (note_length));
-        } else {
-            end_of_note = (note_position >= (note_length));
-        }
-
-        if (end_of_note) {
-            current_note++;
-            if (current_note >= notes_count) {
-                if (notes_repeat) {
-                    current_note = 0;
-                } else {
-                    DISABLE_AUDIO_COUNTER_1_ISR;
-                    DISABLE_AUDIO_COUNTER_1_OUTPUT;
-                    playing_notes = false;
-                    return;
-                }
-            }
-            if (!note_resting) {
-                note_resting = true;
-                current_note--;
-                if ((*notes_pointer)[current_note][0] == (*notes_pointer)[current_note + 1][0]) {
-                    note_frequency = 0;
-                    note_length = 1;
-                } else {
-                    note_frequency = (*notes_pointer)[current_note][0];
-                    note_length = 1;
-                }
-            } else {
-                note_resting = false;
-                envelope_index = 0;
-                note_frequency = (*notes_pointer)[current_note][0];
-                note_length = ((*notes_pointer)[current_note][1] / 4) * (((float)note_tempo) / 100);
-            }
-
-            note_position = 0;
+        if (!song_advance(period)) {
+            DISABLE_AUDIO_COUNTER_1_ISR;
+            DISABLE_AUDIO_COUNTER_1_OUTPUT;
+            return;
         }
     }
 
@@ -640,10 +591,11 @@ void play_note(float freq, int vol) {
 
         playing_note = true;
 
-        envelope_index = 0;
+        voice_start(freq);
 
         if (freq > 0) {
             frequencies[voices] = freq;
+            pitches[voices] = note_pitch(freq);
             volumes[voices] = vol;
             voices++;
         }
@@ -695,10 +647,15 @@ void play_notes(float (*np)[][2], uint16_t n_count, bool n_repeat)
 
         place = 0;
         current_note = 0;
+        note_resting = false;
 
-        note_frequency = (*notes_pointer)[current_note][0];
-        note_length = ((*notes_pointer)[current_note][1] / 4) * (((float)note_tempo) / 100);
-        note_position = 0;
+        song_queue_head = 0;
+        song_queue_tail = 0;
+        song_queue_done = false;
+        song_fill_queue();
+        // The voice is the same for all the notes of the song
+        voice_start((*notes_pointer)[0][0]);
+        song_start_note();
 
 
         #ifdef C6_AUDIO
@@ -751,28 +708,34 @@ void audio_off(void) {
 
 void set_vibrato_rate(float rate) {
     vibrato_rate = rate;
+    update_vibrato();
 }
 
 void increase_vibrato_rate(float change) {
     vibrato_rate *= change;
+    update_vibrato();
 }
 
 void decrease_vibrato_rate(float change) {
     vibrato_rate /= change;
+    update_vibrato();
 }
 
 #ifdef VIBRATO_STRENGTH_ENABLE
 
 void set_vibrato_strength(float strength) {
     vibrato_strength = strength;
+    update_vibrato();
 }
 
 void increase_vibrato_strength(float change) {
     vibrato_strength *= change;
+    update_vibrato();
 }
 
 void decrease_vibrato_strength(float change) {
     vibrato_strength /= change;
+    update_vibrato();
 }
 
 #endif  /* VIBRATO_STRENGTH_ENABLE */
@@ -783,28 +746,34 @@ void decrease_vibrato_strength(float change) {
 
 void set_polyphony_rate(float rate) {
     polyphony_rate = rate;
+    update_rates();
 }
 
 void enable_polyphony() {
     polyphony_rate = 5;
+    update_rates();
 }
 
 void disable_polyphony() {
     polyphony_rate = 0;
+    update_rates();
 }
 
 void increase_polyphony_rate(float change) {
     polyphony_rate *= change;
+    update_rates();
 }
 
 void decrease_polyphony_rate(float change) {
     polyphony_rate /= change;
+    update_rates();
 }
 
 // Timbre function
 
 void set_timbre(float timbre) {
     note_timbre = timbre;
+    update_rates();
 }
 
 // Tempo functions
@@ -82,6 +82,8 @@ void increase_tempo(uint8_t tempo_change);
 void decrease_tempo(uint8_t tempo_change);
 
 void audio_init(void);
+// Called from the main loop, converts the next notes of the song that's playing
+void audio_task(void);
 
 #ifdef PWM_AUDIO
 void play_sample(uint8_t * s, uint16_t l, bool r);
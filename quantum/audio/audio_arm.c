@@ -15,6 +15,7 @@
  */
 
 #include "audio.h"
+#include "synth.h"
 #include "ch.h"
 #include "hal.h"
 
@@ -26,39 +27,56 @@
 
 // -----------------------------------------------------------------------------
 
-int voices = 0;
-int voice_place = 0;
-float frequency = 0;
-float frequency_alt = 0;
-int volume = 0;
-long position = 0;
-
-float frequencies[8] = {0, 0, 0, 0, 0, 0, 0, 0};
-int volumes[8] = {0, 0, 0, 0, 0, 0, 0, 0};
-bool sliding = false;
-
-float place = 0;
-
-uint8_t * sample;
-uint16_t sample_length = 0;
+// The notes are rendered by the synth, see synth.h. The DAC buffer holds two
+// blocks of SYNTH_BLOCK_SIZE samples, which DMA plays in a loop, triggered by
+// TIM6 at the sample rate. When one block has been played, the DMA interrupt
+// renders the next one into it, while the other block is playing, so there's
+// no work per sample. The speaker is driven from both DAC channels, A4 and
+// A5, with the samples inverted on A5. TIM6 is stopped once the synth has
+// gone quiet, and started again by the next note.
+//
+// The notes of a song are converted to phase increments and lengths in
+// samples by the song thread, a few notes ahead, so the DMA interrupt only
+// has to do integer math.
 
 bool     playing_notes = false;
-bool     playing_note = false;
-float    note_frequency = 0;
-float    note_length = 0;
 uint8_t  note_tempo = TEMPO_DEFAULT;
 float    note_timbre = TIMBRE_DEFAULT;
-uint16_t note_position = 0;
 float (* notes_pointer)[][2];
 uint16_t notes_count;
 bool     notes_repeat;
-bool     note_resting = false;
-
-uint8_t current_note = 0;
-uint8_t rest_counter = 0;
+// The next note the song thread converts
+uint16_t current_note = 0;
+
+typedef struct {
+    uint32_t increment;
+    uint32_t samples;
+} song_note_t;
+
+// The converted notes, the song thread adds them at the head and the
+// interrupt takes them from the tail. The size has to be a power of two.
+#define SONG_QUEUE_SIZE 4
+static song_note_t song_queue[SONG_QUEUE_SIZE];
+static uint8_t song_queue_head = 0;
+static uint8_t song_queue_tail = 0;
+// Set when the last note of a song that doesn't repeat has been queued
+static bool song_queue_done = false;
+static binary_semaphore_t song_semaphore;
+
+// The note of the song that is playing, and the samples left until it ends
+static uint32_t note_increment = 0;
+static uint32_t note_samples = 0;
+
+// TIM6 is only running while there is something to play. It's stopped when
+// both halves of the DAC buffer are silent.
+static bool dac_running = false;
+static uint8_t silent_blocks = 0;
+
+// The lengths of the notes in songs are in units of 65536 cycles of the AVR
+// audio timer, which runs at 2MHz, so the songs play at the same speed
+#define NOTE_UNIT_SAMPLES (SYNTH_SAMPLE_RATE * 65536.0f / 2000000)
 
 #ifdef VIBRATO_ENABLE
-float vibrato_counter = 0;
 float vibrato_strength = .5;
 float vibrato_rate = 0.125;
 #endif
@@ -69,6 +87,7 @@ static bool audio_initialized = false;
 
 audio_config_t audio_config;
 
+// Only used by the voices of the AVR audio
 uint16_t envelope_index = 0;
 bool glissando = true;
 
@@ -77,43 +96,155 @@ bool glissando = true;
 #endif
 float startup_song[][2] = STARTUP_SONG;
 
-static void gpt_cb6(GPTDriver *gptp);
-static void gpt_cb7(GPTDriver *gptp);
-static void gpt_cb8(GPTDriver *gptp);
+static dacsample_t dac_buffer[2 * SYNTH_BLOCK_SIZE];
+static dacsample_t dac_buffer_inverted[2 * SYNTH_BLOCK_SIZE];
+
+static void dac_end_cb(DACDriver *dacp, const dacsample_t *buffer, size_t n);
 
 /*
- * GPT6 configuration.
+ * GPT6 triggers the DAC conversions, it counts to 2 for each sample.
  */
-GPTConfig gpt6cfg1 = {
-  .frequency    = 440,
-  .callback     = gpt_cb6,
+static const GPTConfig gpt6cfg = {
+  .frequency    = 2 * SYNTH_SAMPLE_RATE,
+  .callback     = NULL,
   .cr2          = TIM_CR2_MMS_1,    /* MMS = 010 = TRGO on Update Event.    */
   .dier         = 0U
 };
 
-GPTConfig gpt7cfg1 = {
-  .frequency    = 440,
-  .callback     = gpt_cb7,
-  .cr2          = TIM_CR2_MMS_1,    /* MMS = 010 = TRGO on Update Event.    */
-  .dier         = 0U
+static const DACConfig dac_config = {
+  .init         = SYNTH_SAMPLE_MAX / 2 + 1,
+  .datamode     = DAC_DHRM_12BIT_RIGHT
 };
 
-GPTConfig gpt8cfg1 = {
-  .frequency    = 10,
-  .callback     = gpt_cb8,
-  .cr2          = TIM_CR2_MMS_1,    /* MMS = 010 = TRGO on Update Event.    */
-  .dier         = 0U
+static const DACConversionGroup dac_group = {
+  .num_channels = 1U,
+  .end_cb       = dac_end_cb,
+  .error_cb     = NULL,
+  .trigger      = DAC_TRG(0)        /* TIM6 TRGO */
+};
+
+static const DACConversionGroup dac_group_inverted = {
+  .num_channels = 1U,
+  .end_cb       = NULL,
+  .error_cb     = NULL,
+  .trigger      = DAC_TRG(0)
 };
 
-static void gpt_cb6(GPTDriver *gptp) {
-    palTogglePad(GPIOA, 4);
+static uint8_t note_volume(int vol) {
+    // The volume is 0-15
+    return vol >= 15 ? 255 : vol * 17;
+}
+
+// Converts the notes of the song until the queue is full, called with the
+// system locked
+static void song_fill_queue(void) {
+    while (playing_notes && !song_queue_done &&
+            (uint8_t)(song_queue_head - song_queue_tail) < SONG_QUEUE_SIZE) {
+        song_note_t* note = &song_queue[song_queue_head % SONG_QUEUE_SIZE];
+        note->increment = synth_increment((*notes_pointer)[current_note][0]);
+        float length = ((*notes_pointer)[current_note][1] / 4) * (((float)note_tempo) / 100);
+        note->samples = length * NOTE_UNIT_SAMPLES;
+        if (note->samples == 0) {
+            note->samples = 1;
+        }
+        song_queue_head++;
+        current_note++;
+        if (current_note >= notes_count) {
+            current_note = 0;
+            song_queue_done = !notes_repeat;
+        }
+    }
 }
 
+static THD_WORKING_AREA(song_thread_area, 256);
+static THD_FUNCTION(song_thread, arg) {
+    (void)arg;
+    chRegSetThreadName("audio song");
+    while (true) {
+        chBSemWait(&song_semaphore);
+        chSysLock();
+        song_fill_queue();
+        chSysUnlock();
+    }
+}
 
-static void gpt_cb7(GPTDriver *gptp) {
-    palTogglePad(GPIOA, 5);
+// Starts the next note in the queue
+static void song_start_note(void) {
+    song_note_t* note = &song_queue[song_queue_tail % SONG_QUEUE_SIZE];
+    note_increment = note->increment;
+    note_samples = note->samples;
+    song_queue_tail++;
+    synth_voice_on(note_increment, 255);
+}
+
+// Moves the song forward by the number of samples that are about to be
+// rendered, the notes change on block boundaries
+static void song_advance(uint32_t samples) {
+    bool started = false;
+    while (playing_notes) {
+        if (samples < note_samples) {
+            note_samples -= samples;
+            break;
+        }
+        samples -= note_samples;
+        synth_voice_off(note_increment);
+        if (song_queue_tail == song_queue_head) {
+            // Either the song has ended, or the next note hasn't been
+            // converted yet, then it's started with the next block
+            note_samples = 0;
+            playing_notes = !song_queue_done;
+            break;
+        }
+        song_start_note();
+        started = true;
+    }
+    if (started) {
+        chSysLockFromISR();
+        chBSemSignalI(&song_semaphore);
+        chSysUnlockFromISR();
+    }
 }
 
+// Starts TIM6 if it was stopped, called with the system locked
+static void dac_resume(void) {
+    silent_blocks = 0;
+    if (!dac_running) {
+        dac_running = true;
+        gptStartContinuousI(&GPTD6, 2U);
+    }
+}
+
+// Called from the DMA interrupt when half of the buffer has been played
+static void dac_end_cb(DACDriver *dacp, const dacsample_t *buffer, size_t n) {
+    (void)dacp;
+    dacsample_t* block = (dacsample_t*)buffer;
+    dacsample_t* inverted = dac_buffer_inverted + (block - dac_buffer);
+
+    song_advance(n);
+    synth_fill(block, n);
+    for (size_t i = 0; i < n; i++) {
+        inverted[i] = SYNTH_SAMPLE_MAX - block[i];
+    }
+
+    if (playing_notes || synth_is_active()) {
+        silent_blocks = 0;
+    } else if (++silent_blocks >= 2) {
+        // The other half, which is playing now, is silent too
+        chSysLockFromISR();
+        gptStopTimerI(&GPTD6);
+        dac_running = false;
+        chSysUnlockFromISR();
+    }
+}
+
+#ifdef VIBRATO_ENABLE
+static void update_vibrato(void) {
+    // The default rate of 0.125 is 5Hz
+    float depth = vibrato_strength * 255;
+    synth_set_vibrato(depth > 255 ? 255 : depth, vibrato_rate * 40000);
+}
+#endif
+
 void audio_init()
 {
 
@@ -128,8 +259,27 @@ void audio_init()
     // audio_config.raw = eeconfig_read_audio();
     audio_config.enable = true;
 
-    palSetPadMode(GPIOA, 4, PAL_MODE_OUTPUT_PUSHPULL);
-    palSetPadMode(GPIOA, 5, PAL_MODE_OUTPUT_PUSHPULL);
+    synth_init();
+    synth_set_duty(note_timbre * 255);
+    #ifdef VIBRATO_ENABLE
+        update_vibrato();
+    #endif
+    synth_fill(dac_buffer, 2 * SYNTH_BLOCK_SIZE);
+    for (uint16_t i = 0; i < 2 * SYNTH_BLOCK_SIZE; i++) {
+        dac_buffer_inverted[i] = SYNTH_SAMPLE_MAX - dac_buffer[i];
+    }
+
+    palSetPadMode(GPIOA, 4, PAL_MODE_INPUT_ANALOG);
+    palSetPadMode(GPIOA, 5, PAL_MODE_INPUT_ANALOG);
+    dacStart(&DACD1, &dac_config);
+    dacStart(&DACD2, &dac_config);
+    dacStartConversion(&DACD1, &dac_group, dac_buffer, 2 * SYNTH_BLOCK_SIZE);
+    dacStartConversion(&DACD2, &dac_group_inverted, dac_buffer_inverted, 2 * SYNTH_BLOCK_SIZE);
+    // The timer is started by the first note
+    gptStart(&GPTD6, &gpt6cfg);
+
+    chBSemObjectInit(&song_semaphore, true);
+    chThdCreateStatic(song_thread_area, sizeof(song_thread_area), NORMALPRIO + 1, song_thread, NULL);
 
     audio_initialized = true;
 
@@ -146,291 +296,24 @@ void stop_all_notes()
     if (!audio_initialized) {
         audio_init();
     }
-    voices = 0;
-
-    gptStopTimer(&GPTD6);
-    gptStopTimer(&GPTD7);
-    gptStopTimer(&GPTD8);
 
+    chSysLock();
     playing_notes = false;
-    playing_note = false;
-    frequency = 0;
-    frequency_alt = 0;
-    volume = 0;
-
-    for (uint8_t i = 0; i < 8; i++)
-    {
-        frequencies[i] = 0;
-        volumes[i] = 0;
-    }
+    synth_all_notes_off();
+    chSysUnlock();
 }
 
 void stop_note(float freq)
 {
     dprintf("audio stop note freq=%d", (int)freq);
 
-    if (playing_note) {
-        if (!audio_initialized) {
-            audio_init();
-        }
-        for (int i = 7; i >= 0; i--) {
-            if (frequencies[i] == freq) {
-                frequencies[i] = 0;
-                volumes[i] = 0;
-                for (int j = i; (j < 7); j++) {
-                    frequencies[j] = frequencies[j+1];
-                    frequencies[j+1] = 0;
-                    volumes[j] = volumes[j+1];
-                    volumes[j+1] = 0;
-                }
-                break;
-            }
-        }
-        voices--;
-        if (voices < 0)
-            voices = 0;
-        if (voice_place >= voices) {
-            voice_place = 0;
-        }
-        if (voices == 0) {
-            gptStopTimer(&GPTD6);
-            gptStopTimer(&GPTD7);
-            gptStopTimer(&GPTD8);
-            frequency = 0;
-            frequency_alt = 0;
-            volume = 0;
-            playing_note = false;
-        }
-    }
-}
-
-#ifdef VIBRATO_ENABLE
-
-float mod(float a, int b)
-{
-    float r = fmod(a, b);
-    return r < 0 ? r + b : r;
-}
-
-float vibrato(float average_freq) {
-    #ifdef VIBRATO_STRENGTH_ENABLE
-        float vibrated_freq = average_freq * pow(vibrato_lut[(int)vibrato_counter], vibrato_strength);
-    #else
-        float vibrated_freq = average_freq * vibrato_lut[(int)vibrato_counter];
-    #endif
-    vibrato_counter = mod((vibrato_counter + vibrato_rate * (1.0 + 440.0/average_freq)), VIBRATO_LUT_LENGTH);
-    return vibrated_freq;
-}
-
-#endif
-
-static void restart_gpt6(void) {
-    // gptStopTimer(&GPTD6);
-
-    gptStart(&GPTD6, &gpt6cfg1);
-    gptStartContinuous(&GPTD6, 2U);
-}
-
-static void restart_gpt7(void) {
-    // gptStopTimer(&GPTD7);
-
-    gptStart(&GPTD7, &gpt7cfg1);
-    gptStartContinuous(&GPTD7, 2U);
-}
-
-static void gpt_cb8(GPTDriver *gptp) {
-    float freq;
-
-    if (playing_note) {
-        if (voices > 0) {
-
-            float freq_alt = 0;
-                if (voices > 1) {
-                    if (polyphony_rate == 0) {
-                        if (glissando) {
-                            if (frequency_alt != 0 && frequency_alt < frequencies[voices - 2] && frequency_alt < frequencies[voices - 2] * pow(2, -440/frequencies[voices - 2]/12/2)) {
-                                frequency_alt = frequency_alt * pow(2, 440/frequency_alt/12/2);
-                            } else if (frequency_alt != 0 && frequency_alt > frequencies[voices - 2] && frequency_alt > frequencies[voices - 2] * pow(2, 440/frequencies[voices - 2]/12/2)) {
-                                frequency_alt = frequency_alt * pow(2, -440/frequency_alt/12/2);
-                            } else {
-                                frequency_alt = frequencies[voices - 2];
-                            }
-                        } else {
-                            frequency_alt = frequencies[voices - 2];
-                        }
-
-                        #ifdef VIBRATO_ENABLE
-                            if (vibrato_strength > 0) {
-                                freq_alt = vibrato(frequency_alt);
-                            } else {
-                                freq_alt = frequency_alt;
-                            }
-                        #else
-                            freq_alt = frequency_alt;
-                        #endif
-                    }
-
-                    if (envelope_index < 65535) {
-                        envelope_index++;
-                    }
-
-                    freq_alt = voice_envelope(freq_alt);
-
-                    if (freq_alt < 30.517578125) {
-                        freq_alt = 30.52;
-                    }
-
-                    if (gpt6cfg1.frequency != (uint16_t)freq_alt) {
-                        gpt6cfg1.frequency = freq_alt;
-                        restart_gpt6();
-                    }
-                    //note_timbre;
-                } else {
-                    // gptStopTimer(&GPTD6);
-                }
-
-            if (polyphony_rate > 0) {
-                if (voices > 1) {
-                    voice_place %= voices;
-                    if (place++ > (frequencies[voice_place] / polyphony_rate)) {
-                        voice_place = (voice_place + 1) % voices;
-                        place = 0.0;
-                    }
-                }
-
-                #ifdef VIBRATO_ENABLE
-                    if (vibrato_strength > 0) {
-                        freq = vibrato(frequencies[voice_place]);
-                    } else {
-                        freq = frequencies[voice_place];
-                    }
-                #else
-                    freq = frequencies[voice_place];
-                #endif
-            } else {
-                if (glissando) {
-                    if (frequency != 0 && frequency < frequencies[voices - 1] && frequency < frequencies[voices - 1] * pow(2, -440/frequencies[voices - 1]/12/2)) {
-                        frequency = frequency * pow(2, 440/frequency/12/2);
-                    } else if (frequency != 0 && frequency > frequencies[voices - 1] && frequency > frequencies[voices - 1] * pow(2, 440/frequencies[voices - 1]/12/2)) {
-                        frequency = frequency * pow(2, -440/frequency/12/2);
-                    } else {
-                        frequency = frequencies[voices - 1];
-                    }
-                } else {
-                    frequency = frequencies[voices - 1];
-                }
-
-                #ifdef VIBRATO_ENABLE
-                    if (vibrato_strength > 0) {
-                        freq = vibrato(frequency);
-                    } else {
-                        freq = frequency;
-                    }
-                #else
-                    freq = frequency;
-                #endif
-            }
-
-            if (envelope_index < 65535) {
-                envelope_index++;
-            }
-
-            freq = voice_envelope(freq);
-
-            if (freq < 30.517578125) {
-                freq = 30.52;
-            }
-
-
-            if (gpt7cfg1.frequency != (uint16_t)freq) {
-                gpt7cfg1.frequency = freq;
-                restart_gpt7();
-            }
-            //note_timbre;
-        } else {
-            // gptStopTimer(&GPTD7);
-        }
-    }
-
-    if (playing_notes) {
-        if (note_frequency > 0) {
-            #ifdef VIBRATO_ENABLE
-                if (vibrato_strength > 0) {
-                    freq = vibrato(note_frequency);
-                } else {
-                    freq = note_frequency;
-                }
-            #else
-                    freq = note_frequency;
-            #endif
-
-            if (envelope_index < 65535) {
-                envelope_index++;
-            }
-            freq = voice_envelope(freq);
-
-
-            if (gpt6cfg1.frequency != (uint16_t)freq) {
-                gpt6cfg1.frequency = freq;
-                restart_gpt6();
-                gpt7cfg1.frequency = freq;
-                restart_gpt7();
-            }
-            //note_timbre;
-        } else {
-            // gptStopTimer(&GPTD6);
-            // gptStopTimer(&GPTD7);
-        }
-
-        note_position++;
-        bool end_of_note = false;
-        if (gpt6cfg1.frequency > 0) {
-            if (!note_resting) 
-                end_of_note = (note_position >= (note_length*16 - 1));
-            else
-                end_of_note = (note_position >= (note_length*16));
-        } else {
-            end_of_note = (note_position >= (note_length*16));
-        }
-
-        if (end_of_note) {
-            current_note++;
-            if (current_note >= notes_count) {
-                if (notes_repeat) {
-                    current_note = 0;
-                } else {
-                    gptStopTimer(&GPTD6);
-                    gptStopTimer(&GPTD7);
-                    // gptStopTimer(&GPTD8);
-                    playing_notes = false;
-                    return;
-                }
-            }
-            if (!note_resting) {
-                note_resting = true;
-                current_note--;
-                if ((*notes_pointer)[current_note][0] == (*notes_pointer)[current_note + 1][0]) {
-                    note_frequency = 0;
-                    note_length = 1;
-                } else {
-                    note_frequency = (*notes_pointer)[current_note][0];
-                    note_length = 1;
-                }
-            } else {
-                note_resting = false;
-                envelope_index = 0;
-                note_frequency = (*notes_pointer)[current_note][0];
-                note_length = ((*notes_pointer)[current_note][1] / 4) * (((float)note_tempo) / 100);
-            }
-
-            note_position = 0;
-        }
+    if (!audio_initialized) {
+        audio_init();
     }
 
-    if (!audio_config.enable) {
-        playing_notes = false;
-        playing_note = false;
-    }
+    chSysLock();
+    synth_note_off(freq);
+    chSysUnlock();
 }
 
 void play_note(float freq, int vol) {
@@ -441,25 +324,16 @@ void play_note(float freq, int vol) {
         audio_init();
     }
 
-    if (audio_config.enable && voices < 8) {
-
+    if (audio_config.enable) {
+        chSysLock();
         // Cancel notes if notes are playing
-        if (playing_notes)
-            stop_all_notes();
-
-        playing_note = true;
-
-        envelope_index = 0;
-
-        if (freq > 0) {
-            frequencies[voices] = freq;
-            volumes[voices] = vol;
-            voices++;
+        if (playing_notes) {
+            playing_notes = false;
+            synth_all_notes_off();
         }
-
-        gptStart(&GPTD8, &gpt8cfg1);
-        gptStartContinuous(&GPTD8, 2U);
-            
+        synth_note_on(freq, note_volume(vol));
+        dac_resume();
+        chSysUnlock();
     }
 
 }
@@ -471,33 +345,32 @@ void play_notes(float (*np)[][2], uint16_t n_count, bool n_repeat)
         audio_init();
     }
 
-    if (audio_config.enable) {
-
-        // Cancel note if a note is playing
-        if (playing_note)
-            stop_all_notes();
-
-        playing_notes = true;
+    if (audio_config.enable && n_count > 0) {
+        chSysLock();
+        // Cancel notes if notes are playing
+        synth_all_notes_off();
 
         notes_pointer = np;
         notes_count = n_count;
         notes_repeat = n_repeat;
 
-        place = 0;
         current_note = 0;
-
-        note_frequency = (*notes_pointer)[current_note][0];
-        note_length = ((*notes_pointer)[current_note][1] / 4) * (((float)note_tempo) / 100);
-        note_position = 0;
-
-        gptStart(&GPTD8, &gpt8cfg1);
-        gptStartContinuous(&GPTD8, 2U);
-        restart_gpt6();
-        restart_gpt7();
+        song_queue_head = 0;
+        song_queue_tail = 0;
+        song_queue_done = false;
+        playing_notes = true;
+        song_fill_queue();
+        song_start_note();
+        dac_resume();
+        chSysUnlock();
     }
 
 }
 
+// The song thread converts the notes
+void audio_task(void) {
+}
+
 bool is_playing_notes(void) {
     return playing_notes;
 }
@@ -511,6 +384,8 @@ void audio_toggle(void) {
     eeconfig_update_audio(audio_config.raw);
     if (audio_config.enable)
         audio_on_user();
+    else
+        stop_all_notes();
 }
 
 void audio_on(void) {
@@ -522,6 +397,7 @@ void audio_on(void) {
 void audio_off(void) {
     audio_config.enable = 0;
     eeconfig_update_audio(audio_config.raw);
+    stop_all_notes();
 }
 
 #ifdef VIBRATO_ENABLE
@@ -530,28 +406,34 @@ void audio_off(void) {
 
 void set_vibrato_rate(float rate) {
     vibrato_rate = rate;
+    update_vibrato();
 }
 
 void increase_vibrato_rate(float change) {
     vibrato_rate *= change;
+    update_vibrato();
 }
 
 void decrease_vibrato_rate(float change) {
     vibrato_rate /= change;
+    update_vibrato();
 }
 
 #ifdef VIBRATO_STRENGTH_ENABLE
 
 void set_vibrato_strength(float strength) {
     vibrato_strength = strength;
+    update_vibrato();
 }
 
 void increase_vibrato_strength(float change) {
     vibrato_strength *= change;
+    update_vibrato();
 }
 
 void decrease_vibrato_strength(float change) {
     vibrato_strength /= change;
+    update_vibrato();
 }
 
 #endif  /* VIBRATO_STRENGTH_ENABLE */
@@ -559,6 +441,7 @@ void decrease_vibrato_strength(float change) {
 #endif /* VIBRATO_ENABLE */
 
 // Polyphony functions
+// The synth mixes the notes, so the rate doesn't change anything here
 
 void set_polyphony_rate(float rate) {
     polyphony_rate = rate;
@@ -584,6 +467,7 @@ void decrease_polyphony_rate(float change) {
 
 void set_timbre(float timbre) {
     note_timbre = timbre;
+    synth_set_duty(timbre * 255);
 }
 
 // Tempo functions
@@ -0,0 +1,77 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "note_periods.h"
+#include "led_table_generator.h"
+
+// The frequencies are generated from C-1, MIDI note 0, one octave at a time
+#define NOTE_SEMITONE(k) ( \
+    (k) == 0 ? 1.0 : (k) == 1 ? 1.0594630943592953 : (k) == 2 ? 1.1224620483093730 : \
+    (k) == 3 ? 1.1892071150027210 : (k) == 4 ? 1.2599210498948732 : (k) == 5 ? 1.3348398541700344 : \
+    (k) == 6 ? 1.4142135623730951 : (k) == 7 ? 1.4983070768766815 : (k) == 8 ? 1.5874010519681994 : \
+    (k) == 9 ? 1.6817928305074290 : (k) == 10 ? 1.7817974362806785 : 1.8877486253633868)
+#define NOTE_FREQUENCY(n) (8.175798915643707 * (double)(1UL << ((n) / 12)) * NOTE_SEMITONE((n) % 12))
+#define NOTE_PERIOD(n) ((uint16_t)(NOTE_PERIOD_CLOCK / NOTE_FREQUENCY(n) >= 65535 ? 65535 : \
+    NOTE_PERIOD_CLOCK / NOTE_FREQUENCY(n) + 0.5))
+
+const uint16_t note_periods[NOTE_PERIODS_LENGTH] PROGMEM = {
+    LED_TABLE_128(NOTE_PERIOD)
+};
+
+const int8_t note_vibrato_lut[NOTE_VIBRATO_LENGTH] PROGMEM = {
+    10, 19, 26, 30, 32, 30, 26, 19, 10, 0,
+    -10, -19, -26, -30, -32, -30, -26, -19, -10, 0,
+};
+
+uint16_t note_pitch(float freq) {
+    if (freq <= 0) {
+        return 0;
+    }
+    float ticks = NOTE_PERIOD_CLOCK / freq;
+    uint16_t period = ticks >= 65535 ? 65535 : (uint16_t)(ticks + 0.5f);
+
+    // Find the notes on both sides, from has a period >= period > to
+    uint8_t from = 0;
+    uint8_t to = NOTE_PERIODS_LENGTH - 1;
+    uint16_t to_period = pgm_read_word(&note_periods[to]);
+    if (period <= to_period) {
+        return NOTE_PITCH_MAX;
+    }
+    while (to - from > 1) {
+        uint8_t middle = (from + to) / 2;
+        if (pgm_read_word(&note_periods[middle]) >= period) {
+            from = middle;
+        } else {
+            to = middle;
+            to_period = pgm_read_word(&note_periods[middle]);
+        }
+    }
+    uint16_t from_period = pgm_read_word(&note_periods[from]);
+    uint16_t range = from_period - to_period;
+    return (from << 8) + ((uint32_t)(from_period - period) * 256 + range / 2) / range;
+}
+
+uint32_t note_duration(float duration, uint8_t tempo) {
+    return (duration / 4) * ((float)tempo / 100) * 0xFFFF;
+}
+
+void note_vibrato_init(note_vibrato_t* vibrato, float rate, float strength) {
+    // The position moves rate * (1 + 440 / frequency) entries every period
+    float per_tick = rate * 440 * 65536 * 1024 / NOTE_PERIOD_CLOCK;
+    vibrato->rate = rate * 65536;
+    vibrato->rate_per_tick = per_tick > 65535 ? 65535 : per_tick;
+    vibrato->strength = strength * 256;
+}
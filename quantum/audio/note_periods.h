@@ -0,0 +1,107 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NOTE_PERIODS_H
+#define NOTE_PERIODS_H
+
+#include <stdint.h>
+#include "progmem.h"
+
+// Timer periods for the notes, so the audio interrupt can play them with
+// integer math. A pitch is in 1/256 semitones above MIDI note 0, so
+// NOTE_PITCH_A4 is 440Hz, and the periods are in ticks of the audio timers,
+// which count at F_CPU / 8. Converting a frequency to a pitch still needs
+// float math, but that's only done once per note.
+
+#define NOTE_PERIOD_CLOCK (F_CPU / 8)
+#define NOTE_PERIODS_LENGTH 128
+#define NOTE_PITCH_MAX ((NOTE_PERIODS_LENGTH - 1) << 8)
+#define NOTE_PITCH_A4 (69 << 8)
+
+// The same curve as vibrato_lut in luts.c, as pitch offsets
+#define NOTE_VIBRATO_LENGTH 20
+
+extern const uint16_t note_periods[NOTE_PERIODS_LENGTH] PROGMEM;
+extern const int8_t note_vibrato_lut[NOTE_VIBRATO_LENGTH] PROGMEM;
+
+// Returns the pitch of a frequency in Hz, frequencies that are too low for
+// the timer get the lowest pitch it can play, and 0 is returned for rests
+uint16_t note_pitch(float freq);
+
+// Returns the number of timer ticks a note lasts, the duration is in the
+// units of musical_notes.h
+uint32_t note_duration(float duration, uint8_t tempo);
+
+// Returns the timer period of a pitch, interpolated between the notes
+static inline uint16_t note_period(uint16_t pitch) {
+    uint8_t note = pitch >> 8;
+    uint16_t from = pgm_read_word(&note_periods[note]);
+    if (note == NOTE_PERIODS_LENGTH - 1) {
+        return from;
+    }
+    uint16_t to = pgm_read_word(&note_periods[note + 1]);
+    return from - (((uint32_t)(from - to) * (pitch & 0xFF) + 0x80) >> 8);
+}
+
+// The glissando slides 220 semitones per second, this is the step for a
+// period of 65536 timer ticks
+#define NOTE_GLIDE_RATE ((uint16_t)(220.0 * 256 * 65536 / NOTE_PERIOD_CLOCK + 0.5))
+
+// Moves the pitch towards the target by one step of the glissando, period
+// is the time since the last step
+static inline uint16_t note_glide(uint16_t pitch, uint16_t target, uint16_t period) {
+    uint16_t step = ((uint32_t)period * NOTE_GLIDE_RATE + 0x8000) >> 16;
+    if ((uint32_t)pitch + step < target) {
+        return pitch + step;
+    }
+    if (pitch > (uint32_t)target + step) {
+        return pitch - step;
+    }
+    return target;
+}
+
+typedef struct {
+    // The position in note_vibrato_lut, in 16.16 fixed point
+    uint32_t position;
+    // Added to the position every period, and for every 1024 timer ticks
+    // of the period, so higher notes move through the vibrato slower
+    uint32_t rate;
+    uint16_t rate_per_tick;
+    // The depth of the vibrato, 256 is the depth of vibrato_lut
+    uint16_t strength;
+} note_vibrato_t;
+
+void note_vibrato_init(note_vibrato_t* vibrato, float rate, float strength);
+
+// Returns the pitch with the vibrato applied, and moves the vibrato forward
+// by one period
+static inline uint16_t note_vibrato(note_vibrato_t* vibrato, uint16_t pitch, uint16_t period) {
+    int8_t offset = pgm_read_byte(&note_vibrato_lut[vibrato->position >> 16]);
+    int32_t vibrated = pitch + (((int32_t)offset * vibrato->strength) >> 8);
+    vibrato->position += vibrato->rate + (((uint32_t)period * vibrato->rate_per_tick) >> 10);
+    while (vibrato->position >= (uint32_t)NOTE_VIBRATO_LENGTH << 16) {
+        vibrato->position -= (uint32_t)NOTE_VIBRATO_LENGTH << 16;
+    }
+    if (vibrated < 0) {
+        return 0;
+    }
+    if (vibrated > NOTE_PITCH_MAX) {
+        return NOTE_PITCH_MAX;
+    }
+    return vibrated;
+}
+
+#endif
@@ -0,0 +1,292 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "synth.h"
+
+enum {
+    STAGE_OFF,
+    STAGE_ATTACK,
+    STAGE_DECAY,
+    STAGE_SUSTAIN,
+    STAGE_RELEASE,
+};
+
+typedef struct {
+    // The position in the waveform, a whole period is 2^32
+    uint32_t phase;
+    uint32_t increment;
+    // The envelope, 0-65535
+    uint16_t level;
+    uint8_t  volume;
+    uint8_t  stage;
+} synth_voice_t;
+
+static const int8_t sine_table[256] = {
+    0, 3, 6, 9, 12, 16, 19, 22, 25, 28, 31, 34, 37, 40, 43, 46,
+    49, 51, 54, 57, 60, 63, 65, 68, 71, 73, 76, 78, 81, 83, 85, 88,
+    90, 92, 94, 96, 98, 100, 102, 104, 106, 107, 109, 111, 112, 113, 115, 116,
+    117, 118, 120, 121, 122, 122, 123, 124, 125, 125, 126, 126, 126, 127, 127, 127,
+    127, 127, 127, 127, 126, 126, 126, 125, 125, 124, 123, 122, 122, 121, 120, 118,
+    117, 116, 115, 113, 112, 111, 109, 107, 106, 104, 102, 100, 98, 96, 94, 92,
+    90, 88, 85, 83, 81, 78, 76, 73, 71, 68, 65, 63, 60, 57, 54, 51,
+    49, 46, 43, 40, 37, 34, 31, 28, 25, 22, 19, 16, 12, 9, 6, 3,
+    0, -3, -6, -9, -12, -16, -19, -22, -25, -28, -31, -34, -37, -40, -43, -46,
+    -49, -51, -54, -57, -60, -63, -65, -68, -71, -73, -76, -78, -81, -83, -85, -88,
+    -90, -92, -94, -96, -98, -100, -102, -104, -106, -107, -109, -111, -112, -113, -115, -116,
+    -117, -118, -120, -121, -122, -122, -123, -124, -125, -125, -126, -126, -126, -127, -127, -127,
+    -127, -127, -127, -127, -126, -126, -126, -125, -125, -124, -123, -122, -122, -121, -120, -118,
+    -117, -116, -115, -113, -112, -111, -109, -107, -106, -104, -102, -100, -98, -96, -94, -92,
+    -90, -88, -85, -83, -81, -78, -76, -73, -71, -68, -65, -63, -60, -57, -54, -51,
+    -49, -46, -43, -40, -37, -34, -31, -28, -25, -22, -19, -16, -12, -9, -6, -3,
+};
+
+static synth_voice_t voices[SYNTH_VOICES];
+static synth_wave_t wave;
+static uint8_t duty;
+
+// The envelope steps per block
+static uint16_t attack_step;
+static uint16_t decay_step;
+static uint16_t sustain_level;
+static uint16_t release_step;
+
+static uint8_t vibrato_depth;
+static uint32_t vibrato_phase;
+static uint32_t vibrato_increment;
+
+void synth_init(void) {
+    static const synth_adsr_t adsr = {
+        .attack = 2,
+        .decay = 0,
+        .sustain = 255,
+        .release = 20,
+    };
+    synth_stop();
+    synth_set_wave(SYNTH_SQUARE);
+    synth_set_duty(128);
+    synth_set_adsr(&adsr);
+    synth_set_vibrato(0, 0);
+}
+
+void synth_set_wave(synth_wave_t w) {
+    wave = w;
+}
+
+void synth_set_duty(uint8_t d) {
+    duty = d;
+}
+
+static uint16_t envelope_step(uint16_t ms, uint16_t range) {
+    uint32_t blocks = (uint32_t)ms * SYNTH_SAMPLE_RATE / (1000UL * SYNTH_BLOCK_SIZE);
+    if (blocks == 0) {
+        return 65535;
+    }
+    uint32_t step = range / blocks;
+    return step > 0 ? step : 1;
+}
+
+void synth_set_adsr(const synth_adsr_t* adsr) {
+    sustain_level = adsr->sustain * 257;
+    attack_step = envelope_step(adsr->attack, 65535);
+    decay_step = envelope_step(adsr->decay, 65535 - sustain_level);
+    release_step = envelope_step(adsr->release, 65535);
+}
+
+void synth_set_vibrato(uint8_t depth, uint16_t rate) {
+    vibrato_depth = depth;
+    vibrato_increment = (uint64_t)rate * SYNTH_BLOCK_SIZE * 4294967296ULL / (1000ULL * SYNTH_SAMPLE_RATE);
+}
+
+uint32_t synth_increment(float freq) {
+    if (freq <= 0) {
+        return 0;
+    }
+    return freq * (4294967296.0f / SYNTH_SAMPLE_RATE);
+}
+
+void synth_note_on(float freq, uint8_t volume) {
+    synth_voice_on(synth_increment(freq), volume);
+}
+
+void synth_note_off(float freq) {
+    synth_voice_off(synth_increment(freq));
+}
+
+void synth_voice_on(uint32_t inc, uint8_t volume) {
+    if (inc == 0) {
+        return;
+    }
+    // Restart the same note if it's still playing, otherwise take a free
+    // voice, or the quietest one
+    synth_voice_t* voice = &voices[0];
+    for (uint8_t i = 0; i < SYNTH_VOICES; i++) {
+        synth_voice_t* v = &voices[i];
+        if (v->stage != STAGE_OFF && v->increment == inc) {
+            voice = v;
+            break;
+        }
+        if (v->level < voice->level || v->stage == STAGE_OFF) {
+            voice = v;
+        }
+    }
+    // A voice that is still held keeps its phase and level, so it doesn't
+    // click, a released one starts over, so repeated notes can be heard
+    if (voice->stage == STAGE_OFF) {
+        voice->phase = 0;
+        voice->level = 0;
+    } else if (voice->stage == STAGE_RELEASE) {
+        voice->level = 0;
+    }
+    voice->increment = inc;
+    voice->volume = volume;
+    voice->stage = STAGE_ATTACK;
+}
+
+void synth_voice_off(uint32_t inc) {
+    if (inc == 0) {
+        return;
+    }
+    for (uint8_t i = 0; i < SYNTH_VOICES; i++) {
+        if (voices[i].increment == inc && voices[i].stage != STAGE_OFF) {
+            voices[i].stage = STAGE_RELEASE;
+        }
+    }
+}
+
+void synth_all_notes_off(void) {
+    for (uint8_t i = 0; i < SYNTH_VOICES; i++) {
+        if (voices[i].stage != STAGE_OFF) {
+            voices[i].stage = STAGE_RELEASE;
+        }
+    }
+}
+
+void synth_stop(void) {
+    for (uint8_t i = 0; i < SYNTH_VOICES; i++) {
+        voices[i].stage = STAGE_OFF;
+        voices[i].level = 0;
+    }
+}
+
+bool synth_is_active(void) {
+    for (uint8_t i = 0; i < SYNTH_VOICES; i++) {
+        if (voices[i].stage != STAGE_OFF) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void envelope_advance(synth_voice_t* v) {
+    int32_t level = v->level;
+    switch (v->stage) {
+        case STAGE_ATTACK:
+            level += attack_step;
+            if (level >= 65535) {
+                level = 65535;
+                v->stage = STAGE_DECAY;
+            }
+            break;
+        case STAGE_DECAY:
+            level -= decay_step;
+            if (level <= sustain_level) {
+                level = sustain_level;
+                v->stage = sustain_level > 0 ? STAGE_SUSTAIN : STAGE_OFF;
+            }
+            break;
+        case STAGE_RELEASE:
+            level -= release_step;
+            if (level <= 0) {
+                level = 0;
+                v->stage = STAGE_OFF;
+            }
+            break;
+    }
+    v->level = level;
+}
+
+// Adds one voice to the mix, the gain is interpolated from the level at the
+// start of the block to the level at the end
+#define RENDER_VOICE(sample) \
+    for (uint16_t i = 0; i < length; i++) { \
+        phase += inc; \
+        mix[i] += (int8_t)(sample) * (gain >> 16); \
+        gain += gain_step; \
+    }
+
+static void render_block(uint16_t* buffer, uint16_t length) {
+    int32_t mix[SYNTH_BLOCK_SIZE] = {0};
+
+    int8_t vibrato = 0;
+    if (vibrato_depth) {
+        vibrato_phase += vibrato_increment;
+        vibrato = sine_table[vibrato_phase >> 24];
+    }
+
+    for (uint8_t v = 0; v < SYNTH_VOICES; v++) {
+        synth_voice_t* voice = &voices[v];
+        if (voice->stage == STAGE_OFF) {
+            continue;
+        }
+        // The gain is 0-255 in 16.16 fixed point
+        int32_t gain = (uint32_t)voice->level * voice->volume >> 8;
+        envelope_advance(voice);
+        int32_t gain_end = (uint32_t)voice->level * voice->volume >> 8;
+        int32_t gain_step = ((gain_end - gain) << 8) / length;
+        gain <<= 8;
+
+        uint32_t phase = voice->phase;
+        uint32_t inc = voice->increment;
+        // A full swing of the vibrato changes the frequency by about 6%
+        inc += ((int32_t)(inc >> 16) * vibrato * vibrato_depth) >> 3;
+        switch (wave) {
+            case SYNTH_SQUARE:
+                RENDER_VOICE((phase >> 24) < duty ? 127 : -128);
+                break;
+            case SYNTH_TRIANGLE:
+                RENDER_VOICE((phase >> 23) < 256 ? (int16_t)(phase >> 23) - 128 : 383 - (int16_t)(phase >> 23));
+                break;
+            case SYNTH_SAW:
+                RENDER_VOICE((int16_t)(phase >> 24) - 128);
+                break;
+            case SYNTH_SINE:
+                RENDER_VOICE(sine_table[phase >> 24]);
+                break;
+        }
+        voice->phase = phase;
+    }
+
+    // A single voice at full volume uses half of the range, so two can play
+    // without clipping
+    for (uint16_t i = 0; i < length; i++) {
+        int32_t sample = SYNTH_SAMPLE_MAX / 2 + 1 + (mix[i] >> 5);
+        if (sample < 0) {
+            sample = 0;
+        } else if (sample > SYNTH_SAMPLE_MAX) {
+            sample = SYNTH_SAMPLE_MAX;
+        }
+        buffer[i] = sample;
+    }
+}
+
+void synth_fill(uint16_t* buffer, uint16_t length) {
+    while (length > 0) {
+        uint16_t block = length < SYNTH_BLOCK_SIZE ? length : SYNTH_BLOCK_SIZE;
+        render_block(buffer, block);
+        buffer += block;
+        length -= block;
+    }
+}
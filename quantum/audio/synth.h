@@ -0,0 +1,92 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// A wavetable synthesizer in fixed point, which renders blocks of samples
+// for a DAC. Each voice has a phase accumulator, which steps through the
+// waveform at the frequency of the note, and an ADSR envelope, which is only
+// updated once per block and interpolated over the samples. The voices are
+// mixed into unsigned samples centered on SYNTH_SAMPLE_MAX / 2.
+
+// The number of samples per second, and the size of the blocks that are
+// rendered at once. The envelopes and the vibrato are updated once per block.
+#ifndef SYNTH_SAMPLE_RATE
+#define SYNTH_SAMPLE_RATE 16000
+#endif
+#ifndef SYNTH_BLOCK_SIZE
+#define SYNTH_BLOCK_SIZE 64
+#endif
+
+// The number of notes that can play at the same time, when more notes are
+// started, the quietest voice is reused
+#ifndef SYNTH_VOICES
+#define SYNTH_VOICES 4
+#endif
+
+// The output is 12 bits, for the STM32 DAC
+#define SYNTH_SAMPLE_MAX 4095
+
+typedef enum {
+    SYNTH_SQUARE,
+    SYNTH_TRIANGLE,
+    SYNTH_SAW,
+    SYNTH_SINE,
+} synth_wave_t;
+
+// The attack, decay and release times are in milliseconds, the sustain
+// level is 0-255
+typedef struct {
+    uint16_t attack;
+    uint16_t decay;
+    uint8_t  sustain;
+    uint16_t release;
+} synth_adsr_t;
+
+void synth_init(void);
+void synth_set_wave(synth_wave_t wave);
+// The part of the period the square wave is high, 0-255
+void synth_set_duty(uint8_t duty);
+void synth_set_adsr(const synth_adsr_t* adsr);
+// depth is 0-255, where 255 bends the pitch by about a semitone each way,
+// and rate is in millihertz. A depth of 0 turns the vibrato off.
+void synth_set_vibrato(uint8_t depth, uint16_t rate);
+
+// Starts a note with the volume 0-255, the note keeps playing until it's
+// stopped
+void synth_note_on(float freq, uint8_t volume);
+// Releases the note, it fades out according to the envelope
+void synth_note_off(float freq);
+
+// The phase increment of a frequency. The notes can be converted once, and
+// then started and stopped by their increment with integer math only, for
+// example from an interrupt. A frequency of 0 is a rest.
+uint32_t synth_increment(float freq);
+void synth_voice_on(uint32_t increment, uint8_t volume);
+void synth_voice_off(uint32_t increment);
+void synth_all_notes_off(void);
+// Silences all the voices immediately
+void synth_stop(void);
+bool synth_is_active(void);
+
+// Renders the next length samples, this is called from the DAC interrupt
+void synth_fill(uint16_t* buffer, uint16_t length);
+
+#endif
@@ -0,0 +1,166 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <cmath>
+extern "C" {
+#include "audio/note_periods.h"
+}
+
+// The float math that audio.c used to do in the audio interrupt
+static const float cpu_prescaler = 8;
+
+static float float_period(float freq) {
+    if (freq < 30.517578125) {
+        freq = 30.52;
+    }
+    return (uint16_t)(((float)F_CPU) / (freq * cpu_prescaler));
+}
+
+static float float_glide(float frequency, float target) {
+    if (frequency < target && frequency < target * pow(2, -440/target/12/2)) {
+        return frequency * pow(2, 440/frequency/12/2);
+    } else if (frequency > target && frequency > target * pow(2, 440/target/12/2)) {
+        return frequency * pow(2, -440/frequency/12/2);
+    }
+    return target;
+}
+
+static const float float_vibrato_lut[NOTE_VIBRATO_LENGTH] = {
+    1.0022336811487, 1.0042529943610, 1.0058584256028, 1.0068905285205, 1.0072464122237,
+    1.0068905285205, 1.0058584256028, 1.0042529943610, 1.0022336811487, 1.0000000000000,
+    0.9977712970630, 0.9957650169978, 0.9941756956510, 0.9931566259436, 0.9928057204913,
+    0.9931566259436, 0.9941756956510, 0.9957650169978, 0.9977712970630, 1.0000000000000,
+};
+
+static float float_vibrato(float average_freq, float& counter, float rate, float strength) {
+    float vibrated_freq = average_freq * pow(float_vibrato_lut[(int)counter], strength);
+    counter = fmod(counter + rate * (1.0 + 440.0/average_freq), NOTE_VIBRATO_LENGTH);
+    return vibrated_freq;
+}
+
+TEST(NotePeriods, the_table_matches_the_float_periods) {
+    for (int note = 24; note < NOTE_PERIODS_LENGTH; note++) {
+        float freq = 440 * pow(2, (note - 69) / 12.0);
+        EXPECT_NEAR(note_periods[note], float_period(freq), 1) << "note " << note;
+    }
+}
+
+TEST(NotePeriods, a4_is_440hz) {
+    EXPECT_EQ(note_pitch(440.0f), NOTE_PITCH_A4);
+    EXPECT_EQ(note_period(NOTE_PITCH_A4), 4545);
+}
+
+TEST(NotePeriods, frequencies_between_the_notes_match_the_float_periods) {
+    for (float freq = 31; freq < 12000; freq *= 1.003) {
+        float expected = float_period(freq);
+        EXPECT_NEAR(note_period(note_pitch(freq)), expected, std::max(1.0f, expected * 0.0005f)) << "freq " << freq;
+    }
+}
+
+TEST(NotePeriods, low_frequencies_are_clamped_like_before) {
+    EXPECT_NEAR(note_period(note_pitch(20.0f)), float_period(20.0f), 10);
+    EXPECT_NEAR(note_period(note_pitch(1.0f)), float_period(1.0f), 10);
+}
+
+TEST(NotePeriods, high_frequencies_are_clamped_to_the_last_note) {
+    EXPECT_EQ(note_pitch(20000.0f), NOTE_PITCH_MAX);
+    EXPECT_EQ(note_period(NOTE_PITCH_MAX), note_periods[NOTE_PERIODS_LENGTH - 1]);
+}
+
+TEST(NotePeriods, rests_have_no_pitch) {
+    EXPECT_EQ(note_pitch(0.0f), 0);
+}
+
+static void expect_same_glide(float from, float to) {
+    // Measure how long the glide takes in timer ticks
+    float freq = from;
+    uint32_t float_ticks = 0;
+    while (freq != to) {
+        freq = float_glide(freq, to);
+        float_ticks += float_period(freq);
+    }
+
+    uint16_t pitch = note_pitch(from);
+    uint16_t target = note_pitch(to);
+    uint16_t period = note_period(pitch);
+    uint32_t ticks = 0;
+    while (pitch != target) {
+        pitch = note_glide(pitch, target, period);
+        period = note_period(pitch);
+        ticks += period;
+    }
+    EXPECT_NEAR(ticks, float_ticks, float_ticks * 0.05) << from << " to " << to;
+}
+
+TEST(NotePeriods, the_glissando_matches_the_float_glissando) {
+    expect_same_glide(440.0f, 880.0f);
+    expect_same_glide(880.0f, 440.0f);
+    expect_same_glide(130.81f, 1046.5f);
+    expect_same_glide(2093.0f, 261.63f);
+}
+
+static void expect_same_vibrato(float freq, float rate, float strength) {
+    float counter = 0;
+    note_vibrato_t vibrato = {};
+    note_vibrato_init(&vibrato, rate, strength);
+    uint16_t pitch = note_pitch(freq);
+    uint16_t period = note_period(pitch);
+    for (int i = 0; i < 2000; i++) {
+        // Rounding can put the positions on different sides of an entry, so
+        // the period can also match the entries next to it
+        int index = counter;
+        float_vibrato(freq, counter, rate, strength);
+        period = note_period(note_vibrato(&vibrato, pitch, period));
+        bool matches = false;
+        for (int j = index + NOTE_VIBRATO_LENGTH - 1; j <= index + NOTE_VIBRATO_LENGTH + 1; j++) {
+            float expected = float_period(freq * pow(float_vibrato_lut[j % NOTE_VIBRATO_LENGTH], strength));
+            matches |= std::abs(period - expected) <= expected * 0.001;
+        }
+        ASSERT_TRUE(matches) << "step " << i << " period " << period;
+    }
+}
+
+TEST(NotePeriods, the_vibrato_matches_the_float_vibrato) {
+    expect_same_vibrato(440.0f, 0.125f, 1.0f);
+    expect_same_vibrato(261.63f, 0.125f, 0.5f);
+    expect_same_vibrato(1046.5f, 0.25f, 2.0f);
+}
+
+TEST(NotePeriods, notes_last_as_long_as_before) {
+    for (float duration : {1.0f, 4.0f, 16.0f, 64.0f}) {
+        for (uint8_t tempo : {50, 100, 120}) {
+            for (float freq : {130.81f, 440.0f, 2093.0f}) {
+                // The interrupt runs once per period
+                uint16_t period = float_period(freq);
+                float length = (duration / 4) * ((float)tempo / 100);
+                uint32_t position = 0;
+                do {
+                    position++;
+                } while (!(position >= (length / period * 0xFFFF - 1)));
+
+                uint32_t ticks = note_duration(duration, tempo);
+                uint32_t elapsed = 0;
+                uint32_t count = 0;
+                do {
+                    elapsed += period;
+                    count++;
+                } while (!(elapsed + period >= ticks));
+                EXPECT_NEAR(count, position, 1) << duration << " " << (int)tempo << " " << freq;
+            }
+        }
+    }
+}
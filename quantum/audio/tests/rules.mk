@@ -0,0 +1,9 @@
+audio_synth_SRC :=\
+	$(QUANTUM_PATH)/audio/tests/synth_tests.cpp \
+	$(QUANTUM_PATH)/audio/synth.c
+
+audio_note_periods_SRC :=\
+	$(QUANTUM_PATH)/audio/tests/note_periods_tests.cpp \
+	$(QUANTUM_PATH)/audio/note_periods.c
+
+audio_note_periods_DEFS := -DF_CPU=16000000UL
\ No newline at end of file
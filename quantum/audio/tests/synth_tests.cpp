@@ -0,0 +1,187 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <vector>
+#include <algorithm>
+extern "C" {
+#include "audio/synth.h"
+}
+
+static const uint16_t center = SYNTH_SAMPLE_MAX / 2 + 1;
+
+class Synth : public testing::Test {
+public:
+    Synth() {
+        synth_init();
+    }
+
+    std::vector<uint16_t> render(uint32_t ms) {
+        std::vector<uint16_t> samples(ms * SYNTH_SAMPLE_RATE / 1000);
+        synth_fill(samples.data(), samples.size());
+        return samples;
+    }
+
+    static int periods(const std::vector<uint16_t>& samples) {
+        int count = 0;
+        for (size_t i = 1; i < samples.size(); i++) {
+            if (samples[i - 1] < center && samples[i] >= center) {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    static int amplitude(const std::vector<uint16_t>& samples) {
+        auto minmax = std::minmax_element(samples.begin(), samples.end());
+        return *minmax.second - *minmax.first;
+    }
+};
+
+TEST_F(Synth, is_silent_without_notes) {
+    EXPECT_FALSE(synth_is_active());
+    auto samples = render(10);
+    EXPECT_EQ(samples, std::vector<uint16_t>(samples.size(), center));
+}
+
+TEST_F(Synth, plays_the_frequency_of_the_note) {
+    for (auto wave : {SYNTH_SQUARE, SYNTH_TRIANGLE, SYNTH_SAW, SYNTH_SINE}) {
+        synth_init();
+        synth_set_wave(wave);
+        synth_note_on(440.0f, 255);
+        EXPECT_NEAR(periods(render(1000)), 440, 1) << "wave " << wave;
+    }
+}
+
+TEST_F(Synth, plays_notes_started_by_their_increment) {
+    uint32_t increment = synth_increment(440.0f);
+    synth_voice_on(increment, 255);
+    EXPECT_NEAR(periods(render(1000)), 440, 1);
+    // The same note can be stopped by its frequency or its increment
+    synth_note_off(440.0f);
+    render(100);
+    EXPECT_FALSE(synth_is_active());
+    synth_note_on(440.0f, 255);
+    synth_voice_off(increment);
+    render(100);
+    EXPECT_FALSE(synth_is_active());
+}
+
+TEST_F(Synth, a_rest_has_no_increment_and_plays_nothing) {
+    EXPECT_EQ(synth_increment(0.0f), 0u);
+    synth_voice_on(0, 255);
+    EXPECT_FALSE(synth_is_active());
+}
+
+TEST_F(Synth, a_full_volume_note_uses_half_of_the_range) {
+    synth_note_on(440.0f, 255);
+    auto samples = render(100);
+    EXPECT_NEAR(amplitude(samples), SYNTH_SAMPLE_MAX / 2, 30);
+}
+
+TEST_F(Synth, the_volume_scales_the_amplitude) {
+    synth_note_on(440.0f, 64);
+    auto samples = render(100);
+    EXPECT_NEAR(amplitude(samples), SYNTH_SAMPLE_MAX / 8, 20);
+}
+
+TEST_F(Synth, the_square_wave_follows_the_duty_cycle) {
+    synth_set_duty(64);
+    synth_note_on(500.0f, 255);
+    auto samples = render(100);
+    auto high = std::count_if(samples.begin(), samples.end(), [](uint16_t s) { return s > center; });
+    EXPECT_NEAR((double)high / samples.size(), 0.25, 0.02);
+}
+
+TEST_F(Synth, attacks_and_releases_according_to_the_envelope) {
+    synth_adsr_t adsr = {
+        .attack = 100,
+        .decay = 100,
+        .sustain = 128,
+        .release = 200,
+    };
+    synth_set_adsr(&adsr);
+    synth_note_on(1000.0f, 255);
+    int start = amplitude(render(10));
+    int attacked = amplitude(render(90));
+    render(150);
+    int sustained = amplitude(render(50));
+    EXPECT_LT(start, attacked / 4);
+    EXPECT_NEAR(attacked, SYNTH_SAMPLE_MAX / 2, 50);
+    EXPECT_NEAR(sustained, SYNTH_SAMPLE_MAX / 4, 50);
+
+    synth_note_off(1000.0f);
+    EXPECT_TRUE(synth_is_active());
+    render(40);
+    int releasing = amplitude(render(10));
+    EXPECT_LT(releasing, sustained);
+    EXPECT_GT(releasing, 0);
+    render(100);
+    EXPECT_FALSE(synth_is_active());
+    auto samples = render(10);
+    EXPECT_EQ(samples, std::vector<uint16_t>(samples.size(), center));
+}
+
+TEST_F(Synth, mixes_the_voices_without_going_out_of_range) {
+    synth_note_on(440.0f, 255);
+    synth_note_on(660.0f, 255);
+    synth_note_on(880.0f, 255);
+    auto samples = render(100);
+    EXPECT_EQ(amplitude(samples), SYNTH_SAMPLE_MAX);
+    synth_note_off(660.0f);
+    synth_note_off(880.0f);
+    render(100);
+    EXPECT_NEAR(periods(render(1000)), 440, 1);
+}
+
+TEST_F(Synth, reuses_the_quietest_voice_when_all_are_playing) {
+    synth_note_on(100.0f, 10);
+    for (int i = 1; i < SYNTH_VOICES; i++) {
+        synth_note_on(200.0f * i, 255);
+    }
+    render(10);
+    synth_note_on(3000.0f, 255);
+    for (int i = 1; i < SYNTH_VOICES; i++) {
+        synth_note_off(200.0f * i);
+    }
+    render(100);
+    EXPECT_TRUE(synth_is_active());
+    EXPECT_NEAR(periods(render(1000)), 3000, 1);
+}
+
+TEST_F(Synth, stop_silences_immediately) {
+    synth_note_on(440.0f, 255);
+    render(10);
+    synth_stop();
+    EXPECT_FALSE(synth_is_active());
+    auto samples = render(10);
+    EXPECT_EQ(samples, std::vector<uint16_t>(samples.size(), center));
+}
+
+TEST_F(Synth, vibrato_bends_the_pitch) {
+    synth_set_vibrato(255, 4000);
+    synth_note_on(1000.0f, 255);
+    // Count the periods over each quarter of a vibrato cycle
+    int lowest = 1000;
+    int highest = 0;
+    for (int i = 0; i < 16; i++) {
+        int count = periods(render(62));
+        lowest = std::min(lowest, count);
+        highest = std::max(highest, count);
+    }
+    EXPECT_GT(highest - lowest, 3);
+    EXPECT_NEAR(periods(render(1000)), 1000, 5);
+}
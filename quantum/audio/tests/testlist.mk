@@ -0,0 +1,3 @@
+TEST_LIST +=\
+	audio_synth \
+	audio_note_periods
\ No newline at end of file
@@ -0,0 +1,83 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "color.h"
+
+// x / 60 for x <= 255 * 59, as a multiplication and a shift
+#define DIV60(x) ((uint8_t)(((uint32_t)(x) * 17477) >> 20))
+
+RGB hsv_to_rgb(uint16_t hue, uint8_t sat, uint8_t val) {
+  RGB rgb;
+  if (sat == 0) { // Acromatic color (gray). Hue doesn't mind.
+    rgb.r = val;
+    rgb.g = val;
+    rgb.b = val;
+    return rgb;
+  }
+
+  rgb.r = 0;
+  rgb.g = 0;
+  rgb.b = 0;
+  if (hue >= 360) {
+    return rgb;
+  }
+
+  // At most five subtractions find the 60 degree sector
+  uint8_t sector = 0;
+  uint8_t offset;
+  while (hue >= 60) {
+    hue -= 60;
+    sector++;
+  }
+  offset = hue;
+
+  uint8_t base = ((255 - sat) * val) >> 8;
+  uint8_t color = DIV60((uint16_t)(val - base) * offset);
+
+  switch (sector) {
+    case 0:
+      rgb.r = val;
+      rgb.g = base + color;
+      rgb.b = base;
+      break;
+    case 1:
+      rgb.r = val - color;
+      rgb.g = val;
+      rgb.b = base;
+      break;
+    case 2:
+      rgb.r = base;
+      rgb.g = val;
+      rgb.b = base + color;
+      break;
+    case 3:
+      rgb.r = base;
+      rgb.g = val - color;
+      rgb.b = val;
+      break;
+    case 4:
+      rgb.r = base + color;
+      rgb.g = base;
+      rgb.b = val;
+      break;
+    default:
+      rgb.r = val;
+      rgb.g = base;
+      rgb.b = val - color;
+      break;
+  }
+  return rgb;
+}
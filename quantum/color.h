@@ -0,0 +1,39 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COLOR_H
+#define COLOR_H
+
+#include <stdint.h>
+
+typedef struct {
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+} RGB;
+
+// Converts a hue in degrees (0-359), saturation and value to rgb, without
+// any divisions, which are slow on the AVR. Hues outside of the range give
+// black, unless the saturation is 0.
+RGB hsv_to_rgb(uint16_t hue, uint8_t sat, uint8_t val);
+
+// Steps a hue by less than a full turn, wrapping around at 360
+static inline uint16_t hue_add(uint16_t hue, uint16_t step) {
+  hue += step;
+  return hue >= 360 ? hue - 360 : hue;
+}
+
+#endif
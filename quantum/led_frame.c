@@ -0,0 +1,28 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "led_frame.h"
+
+uint16_t led_frame_changed_length(const uint8_t* frame, uint8_t* sent, uint16_t length) {
+  uint16_t changed = 0;
+  for (uint16_t i = 0; i < length; i++) {
+    if (frame[i] != sent[i]) {
+      sent[i] = frame[i];
+      changed = i + 1;
+    }
+  }
+  return changed;
+}
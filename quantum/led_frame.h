@@ -0,0 +1,30 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LED_FRAME_H
+#define LED_FRAME_H
+
+#include <stdint.h>
+
+// Compares a frame of LED data with a copy of the last frame that was sent,
+// and updates the copy. Returns the number of bytes from the start of the
+// frame that have to be sent to include every change, or 0 if nothing has
+// changed. LED chains like the WS2812 keep the old colors of the LEDs that
+// are past the end of a shorter transfer, so sending that many bytes is
+// enough.
+uint16_t led_frame_changed_length(const uint8_t* frame, uint8_t* sent, uint16_t length);
+
+#endif
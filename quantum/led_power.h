@@ -0,0 +1,60 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LED_POWER_H
+#define LED_POWER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Keeps the current drawn by a frame of LEDs under a budget, so a keyboard
+// with a lot of LEDs doesn't brown out the USB supply when they are all on.
+// The frame is an array of channel values (0-255), each of which draws
+// channel_ma milliamps at 255 and proportionally less below that, so it has
+// to be applied after any lightness curve. When the frame would draw more
+// than budget_ma, every value is scaled down by the same amount, which keeps
+// the colors. It's one pass to sum the frame, and another to scale it only
+// when it's over the budget.
+
+// Returns the scale (0-255) that brings the frame within the budget, 255 when
+// it already is
+static inline uint8_t led_power_scale(const uint8_t* values, uint16_t length, uint8_t channel_ma, uint16_t budget_ma) {
+  uint32_t sum = 0;
+  for (uint16_t i = 0; i < length; i++) {
+    sum += values[i];
+  }
+  // Both in 1/255 mA
+  uint32_t drawn = sum * channel_ma;
+  uint32_t allowed = (uint32_t)budget_ma * 255;
+  if (drawn <= allowed) {
+    return 255;
+  }
+  return allowed * 255 / drawn;
+}
+
+// Scales the frame down to stay within the budget, returns true if it had to
+static inline bool led_power_limit(uint8_t* values, uint16_t length, uint8_t channel_ma, uint16_t budget_ma) {
+  uint8_t scale = led_power_scale(values, length, channel_ma, budget_ma);
+  if (scale == 255) {
+    return false;
+  }
+  for (uint16_t i = 0; i < length; i++) {
+    values[i] = ((uint16_t)values[i] * scale) >> 8;
+  }
+  return true;
+}
+
+#endif
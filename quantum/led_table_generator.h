@@ -0,0 +1,89 @@
+/*
+Copyright 2018 Fred Sundvik
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LED_TABLE_GENERATOR_H
+#define LED_TABLE_GENERATOR_H
+
+#include "progmem.h"
+#include <stdint.h>
+
+// Macros for generating lookup tables with the compiler. The math is done
+// in constant expressions, so a table like
+//
+//   #define MY_ENTRY(i) ((uint8_t)(255.0 * LED_TABLE_SIN((i) * LED_TABLE_PI / 255.0)))
+//   const uint8_t MY_TABLE[] PROGMEM = { LED_TABLE_256(MY_ENTRY) };
+//
+// ends up in flash without any floating point code or libm in the firmware,
+// and it still follows the options set in config.h.
+
+#define LED_TABLE_PI 3.14159265358979323846
+#define LED_TABLE_E 2.71828182845904523536
+
+// sin(x) for x in [-pi, pi], as a Taylor series in Horner form
+#define LED_TABLE_SIN(x) ((x) * (1.0 - (x) * (x) / 6.0 * (1.0 - (x) * (x) / 20.0 * \
+    (1.0 - (x) * (x) / 42.0 * (1.0 - (x) * (x) / 72.0 * (1.0 - (x) * (x) / 110.0 * \
+    (1.0 - (x) * (x) / 156.0 * (1.0 - (x) * (x) / 210.0))))))))
+
+// exp(x) for x in [-1, 1]
+#define LED_TABLE_EXP(x) (1.0 + (x) * (1.0 + (x) / 2.0 * (1.0 + (x) / 3.0 * (1.0 + (x) / 4.0 * \
+    (1.0 + (x) / 5.0 * (1.0 + (x) / 6.0 * (1.0 + (x) / 7.0 * (1.0 + (x) / 8.0))))))))
+
+// The CIE 1931 lightness formula, which turns a perceived brightness (0-255)
+// into the fraction of full power (0-1) to drive the LED with. This is how
+// CIE1931_CURVE in led_tables.c was generated.
+#define LED_TABLE_CIE1931_L(v) ((v) * 100.0 / 255)
+#define LED_TABLE_CIE1931(v) (LED_TABLE_CIE1931_L(v) <= 8 ? LED_TABLE_CIE1931_L(v) / 902.3 : \
+    ((LED_TABLE_CIE1931_L(v) + 16) / 116) * ((LED_TABLE_CIE1931_L(v) + 16) / 116) * ((LED_TABLE_CIE1931_L(v) + 16) / 116))
+
+// Expands F(0), F(1), ... F(n - 1)
+#define LED_TABLE_16(F, n) \
+    F((n) * 16 + 0), F((n) * 16 + 1), F((n) * 16 + 2), F((n) * 16 + 3), \
+    F((n) * 16 + 4), F((n) * 16 + 5), F((n) * 16 + 6), F((n) * 16 + 7), \
+    F((n) * 16 + 8), F((n) * 16 + 9), F((n) * 16 + 10), F((n) * 16 + 11), \
+    F((n) * 16 + 12), F((n) * 16 + 13), F((n) * 16 + 14), F((n) * 16 + 15)
+#define LED_TABLE_64(F) \
+    LED_TABLE_16(F, 0), LED_TABLE_16(F, 1), LED_TABLE_16(F, 2), LED_TABLE_16(F, 3)
+#define LED_TABLE_128(F) \
+    LED_TABLE_64(F), \
+    LED_TABLE_16(F, 4), LED_TABLE_16(F, 5), LED_TABLE_16(F, 6), LED_TABLE_16(F, 7)
+#define LED_TABLE_256(F) \
+    LED_TABLE_128(F), \
+    LED_TABLE_16(F, 8), LED_TABLE_16(F, 9), LED_TABLE_16(F, 10), LED_TABLE_16(F, 11), \
+    LED_TABLE_16(F, 12), LED_TABLE_16(F, 13), LED_TABLE_16(F, 14), LED_TABLE_16(F, 15)
+
+// Entry i of a breathing curve with size entries covering a whole breath.
+// http://sean.voisen.org/blog/2011/10/breathing-led-with-arduino/
+// center is between 1 and 2.7, and sets how long the led stays dim.
+#define LED_TABLE_BREATHE(i, size, center, max) ((uint8_t)( \
+    (LED_TABLE_EXP(LED_TABLE_SIN((i) * (256.0 / (size)) / 255.0 * LED_TABLE_PI)) - (center) / LED_TABLE_E) * \
+    ((max) / (LED_TABLE_E - 1 / LED_TABLE_E))))
+
+// Reads position pos (0-255) from a PROGMEM table with 2^bits entries,
+// interpolating linearly between them. The end of the table wraps around
+// to the beginning.
+static inline uint8_t led_table_read(const uint8_t* table, uint8_t bits, uint8_t pos) {
+    uint8_t shift = 8 - bits;
+    uint8_t index = pos >> shift;
+    uint8_t from = pgm_read_byte(&table[index]);
+    if (shift == 0) {
+        return from;
+    }
+    uint8_t next = (index + 1) & ((1 << bits) - 1);
+    int16_t to = pgm_read_byte(&table[next]);
+    uint8_t fraction = pos & ((1 << shift) - 1);
+    return from + (((to - from) * fraction) >> shift);
+}
+
+#endif
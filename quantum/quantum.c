@@ -201,6 +201,10 @@ bool process_record_quantum(keyrecord_t *record) {
   #endif
     keycode = keymap_key_to_keycode(layer_switch_get_layer(key), key);
 
+  #ifdef RGB_MATRIX_ENABLE
+    rgb_matrix_record_key(key.row, key.col, record->event.pressed, record->event.time);
+  #endif
+
     // This is how you use actions here
     // if (keycode == KC_LEAD) {
     //   action_t action;
@@ -818,11 +822,15 @@ void matrix_init_quantum() {
   #ifdef AUDIO_ENABLE
     audio_init();
   #endif
+  #ifdef RGB_MATRIX_ENABLE
+    rgb_matrix_init();
+  #endif
   matrix_init_kb();
 }
 
 void matrix_scan_quantum() {
   #ifdef AUDIO_ENABLE
+    audio_task();
     matrix_scan_music();
   #endif
 
@@ -838,6 +846,10 @@ void matrix_scan_quantum() {
     backlight_task();
   #endif
 
+  #ifdef RGB_MATRIX_ENABLE
+    rgb_matrix_task();
+  #endif
+
   matrix_scan_kb();
 }
 
@@ -0,0 +1,270 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rgb_matrix.h"
+#include "timer.h"
+#include "led_power.h"
+
+#if RGB_MATRIX_LED_COUNT >= RGB_MATRIX_NO_KEY
+#error "RGB_MATRIX_LED_COUNT has to be less than 255"
+#endif
+
+RGB rgb_matrix_frame[RGB_MATRIX_LED_COUNT];
+
+static struct {
+  uint8_t mode;
+  uint16_t hue;
+  uint8_t sat;
+  uint8_t val;
+} config = {
+  .mode = RGB_MATRIX_SOLID,
+  .hue = 0,
+  .sat = 255,
+  .val = 255,
+};
+
+// The latest key presses, in a ring buffer, so the cost of drawing a frame
+// doesn't depend on how fast the keys are pressed
+typedef struct {
+  uint8_t led;
+  uint16_t time;
+} hit_t;
+
+static hit_t hits[RGB_MATRIX_HITS];
+static uint8_t next_hit = 0;
+
+static uint8_t heat[RGB_MATRIX_LED_COUNT];
+static uint16_t heat_timer = 0;
+
+static uint16_t frame_timer = 0;
+// Set when the static effects have to be drawn again
+static bool redraw = true;
+
+static void clear_hits(void) {
+  for (uint8_t i = 0; i < RGB_MATRIX_HITS; i++) {
+    hits[i].led = RGB_MATRIX_NO_KEY;
+  }
+}
+
+void rgb_matrix_init(void) {
+  clear_hits();
+  for (uint8_t i = 0; i < RGB_MATRIX_LED_COUNT; i++) {
+    heat[i] = 0;
+  }
+  frame_timer = timer_read();
+  heat_timer = frame_timer;
+  redraw = true;
+}
+
+void rgb_matrix_mode(uint8_t mode) {
+  config.mode = mode < RGB_MATRIX_EFFECT_MAX ? mode : RGB_MATRIX_SOLID;
+  clear_hits();
+  heat_timer = timer_read();
+  redraw = true;
+}
+
+uint8_t rgb_matrix_get_mode(void) {
+  return config.mode;
+}
+
+void rgb_matrix_sethsv(uint16_t hue, uint8_t sat, uint8_t val) {
+  config.hue = hue;
+  config.sat = sat;
+  config.val = val;
+  redraw = true;
+}
+
+static uint8_t find_led(uint8_t row, uint8_t col) {
+  for (uint8_t i = 0; i < RGB_MATRIX_LED_COUNT; i++) {
+    if (pgm_read_byte(&rgb_matrix_leds[i].row) == row &&
+        pgm_read_byte(&rgb_matrix_leds[i].col) == col) {
+      return i;
+    }
+  }
+  return RGB_MATRIX_NO_KEY;
+}
+
+void rgb_matrix_record_key(uint8_t row, uint8_t col, bool pressed, uint16_t time) {
+  if (!pressed) {
+    return;
+  }
+  if (config.mode == RGB_MATRIX_RIPPLE || config.mode == RGB_MATRIX_SPLASH) {
+    uint8_t led = find_led(row, col);
+    if (led != RGB_MATRIX_NO_KEY) {
+      hits[next_hit].led = led;
+      hits[next_hit].time = time;
+      next_hit = (next_hit + 1) % RGB_MATRIX_HITS;
+    }
+  } else if (config.mode == RGB_MATRIX_HEATMAP) {
+    uint8_t led = find_led(row, col);
+    if (led != RGB_MATRIX_NO_KEY) {
+      heat[led] = heat[led] > 255 - RGB_MATRIX_HEAT_PER_PRESS ? 255 : heat[led] + RGB_MATRIX_HEAT_PER_PRESS;
+    }
+  }
+}
+
+// Approximates the distance with the longer side plus half of the shorter
+// one, which is at most 12% too long, but doesn't need a square root
+static uint8_t distance(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2) {
+  uint8_t dx = x1 > x2 ? x1 - x2 : x2 - x1;
+  uint8_t dy = y1 > y2 ? y1 - y2 : y2 - y1;
+  uint16_t d = dx > dy ? dx + dy / 2 : dy + dx / 2;
+  return d > 255 ? 255 : d;
+}
+
+static uint8_t scale(uint8_t value, uint8_t amount) {
+  return ((uint16_t)value * amount + 255) >> 8;
+}
+
+static void render_solid(void) {
+  RGB rgb = hsv_to_rgb(config.hue, config.sat, config.val);
+  for (uint8_t i = 0; i < RGB_MATRIX_LED_COUNT; i++) {
+    rgb_matrix_frame[i] = rgb;
+  }
+}
+
+static void render_gradient(void) {
+  for (uint8_t i = 0; i < RGB_MATRIX_LED_COUNT; i++) {
+    // 360 degrees over the 256 possible x positions
+    uint16_t step = ((uint16_t)pgm_read_byte(&rgb_matrix_leds[i].x) * 45) >> 5;
+    rgb_matrix_frame[i] = hsv_to_rgb(hue_add(config.hue, step), config.sat, config.val);
+  }
+}
+
+// The hits that are still visible, with everything that doesn't depend on
+// the LED calculated once per frame
+typedef struct {
+  uint8_t x;
+  uint8_t y;
+  uint8_t radius;
+  uint8_t fade;
+} active_hit_t;
+
+static void render_hits(uint16_t time, bool splash) {
+  active_hit_t active[RGB_MATRIX_HITS];
+  uint8_t active_count = 0;
+  for (uint8_t i = 0; i < RGB_MATRIX_HITS; i++) {
+    if (hits[i].led == RGB_MATRIX_NO_KEY) {
+      continue;
+    }
+    uint16_t age = time - hits[i].time;
+    if (age >= RGB_MATRIX_HIT_TIME) {
+      hits[i].led = RGB_MATRIX_NO_KEY;
+      continue;
+    }
+    active_hit_t* hit = &active[active_count++];
+    hit->x = pgm_read_byte(&rgb_matrix_leds[hits[i].led].x);
+    hit->y = pgm_read_byte(&rgb_matrix_leds[hits[i].led].y);
+    // Spreads by a key every 64ms
+    uint32_t radius = (uint32_t)age * RGB_MATRIX_KEY_SIZE / 64;
+    hit->radius = radius > 255 ? 255 : radius;
+    hit->fade = 255 - (uint32_t)age * 255 / RGB_MATRIX_HIT_TIME;
+  }
+
+  for (uint8_t i = 0; i < RGB_MATRIX_LED_COUNT; i++) {
+    uint8_t x = pgm_read_byte(&rgb_matrix_leds[i].x);
+    uint8_t y = pgm_read_byte(&rgb_matrix_leds[i].y);
+    uint8_t brightness = 0;
+    uint16_t hue = config.hue;
+    for (uint8_t j = 0; j < active_count; j++) {
+      uint8_t d = distance(x, y, active[j].x, active[j].y);
+      uint8_t b = 0;
+      if (splash) {
+        if (d <= active[j].radius) {
+          b = active[j].fade;
+        }
+      } else {
+        uint8_t from_ring = d > active[j].radius ? d - active[j].radius : active[j].radius - d;
+        if (from_ring < RGB_MATRIX_KEY_SIZE) {
+          b = (uint16_t)active[j].fade * (RGB_MATRIX_KEY_SIZE - from_ring) / RGB_MATRIX_KEY_SIZE;
+        }
+      }
+      if (b > brightness) {
+        brightness = b;
+        // The splash changes color by 45 degrees a key from the pressed one
+        hue = splash ? hue_add(config.hue, ((uint16_t)d * 45 / RGB_MATRIX_KEY_SIZE) % 360) : config.hue;
+      }
+    }
+    rgb_matrix_frame[i] = hsv_to_rgb(hue, config.sat, scale(config.val, brightness));
+  }
+}
+
+static void render_heatmap(uint16_t time) {
+  uint16_t steps = (uint16_t)(time - heat_timer) / RGB_MATRIX_HEAT_DECAY_INTERVAL;
+  heat_timer += steps * RGB_MATRIX_HEAT_DECAY_INTERVAL;
+  uint8_t cool = steps > 255 ? 255 : steps;
+
+  for (uint8_t i = 0; i < RGB_MATRIX_LED_COUNT; i++) {
+    heat[i] = heat[i] > cool ? heat[i] - cool : 0;
+    // From blue (240) when cold to red (0) when hot
+    uint16_t hue = 240 - ((heat[i] * 15) >> 4);
+    rgb_matrix_frame[i] = hsv_to_rgb(hue, config.sat, config.val);
+  }
+}
+
+void rgb_matrix_render(uint16_t time) {
+  switch (config.mode) {
+    case RGB_MATRIX_OFF: {
+      RGB black = {0, 0, 0};
+      for (uint8_t i = 0; i < RGB_MATRIX_LED_COUNT; i++) {
+        rgb_matrix_frame[i] = black;
+      }
+      break;
+    }
+    case RGB_MATRIX_SOLID:
+      render_solid();
+      break;
+    case RGB_MATRIX_GRADIENT:
+      render_gradient();
+      break;
+    case RGB_MATRIX_RIPPLE:
+      render_hits(time, false);
+      break;
+    case RGB_MATRIX_SPLASH:
+      render_hits(time, true);
+      break;
+    case RGB_MATRIX_HEATMAP:
+      render_heatmap(time);
+      break;
+  }
+}
+
+static bool is_static(uint8_t mode) {
+  return mode == RGB_MATRIX_OFF || mode == RGB_MATRIX_SOLID || mode == RGB_MATRIX_GRADIENT;
+}
+
+void rgb_matrix_task(void) {
+  if (timer_elapsed(frame_timer) < RGB_MATRIX_FRAME_INTERVAL) {
+    return;
+  }
+  frame_timer = timer_read();
+  if (is_static(config.mode) && !redraw) {
+    return;
+  }
+  redraw = false;
+  rgb_matrix_render(frame_timer);
+  rgb_matrix_driver_flush(rgb_matrix_frame, RGB_MATRIX_LED_COUNT);
+}
+
+bool rgb_matrix_limit_power(RGB* out, uint8_t count) {
+#ifdef RGB_MATRIX_MAX_CURRENT
+  return led_power_limit((uint8_t*)out, count * sizeof(RGB), RGB_MATRIX_LED_CURRENT, RGB_MATRIX_MAX_CURRENT);
+#else
+  (void)out;
+  (void)count;
+  return false;
+#endif
+}
@@ -0,0 +1,130 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RGB_MATRIX_H
+#define RGB_MATRIX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "progmem.h"
+#include "color.h"
+
+// Per key RGB lighting. Unlike rgblight, which treats the LEDs as a strip,
+// the effects know where each LED is, and which key it's under, so they
+// can react to the keys being pressed.
+//
+// The keyboard has to define RGB_MATRIX_LED_COUNT in config.h, provide the
+// position of every LED in rgb_matrix_leds, and send the frames to the LEDs
+// in rgb_matrix_driver_flush.
+
+#ifndef RGB_MATRIX_LED_COUNT
+#error "RGB_MATRIX_LED_COUNT has to be defined"
+#endif
+
+// The minimum time in milliseconds between two frames
+#ifndef RGB_MATRIX_FRAME_INTERVAL
+#define RGB_MATRIX_FRAME_INTERVAL 16
+#endif
+
+// How many of the latest key presses the ripple and splash effects draw,
+// an older press is dropped when a new one arrives
+#ifndef RGB_MATRIX_HITS
+#define RGB_MATRIX_HITS 8
+#endif
+
+// How long a ripple or splash lasts in milliseconds
+#ifndef RGB_MATRIX_HIT_TIME
+#define RGB_MATRIX_HIT_TIME 1000
+#endif
+
+// How much each press heats up a key in the heatmap, and how often, in
+// milliseconds, all the keys cool down by one step
+#ifndef RGB_MATRIX_HEAT_PER_PRESS
+#define RGB_MATRIX_HEAT_PER_PRESS 32
+#endif
+#ifndef RGB_MATRIX_HEAT_DECAY_INTERVAL
+#define RGB_MATRIX_HEAT_DECAY_INTERVAL 50
+#endif
+
+// Define RGB_MATRIX_MAX_CURRENT to limit the current in mA all the LEDs draw
+// together, RGB_MATRIX_LED_CURRENT is what one color channel draws at full
+// brightness. The driver dims its own copy of the frame with
+// rgb_matrix_limit_power, after any lightness curve.
+#ifndef RGB_MATRIX_LED_CURRENT
+#define RGB_MATRIX_LED_CURRENT 20
+#endif
+
+#define RGB_MATRIX_NO_KEY 255
+
+// The size of a key in the units of the LED positions below, the effects
+// are scaled by it
+#ifndef RGB_MATRIX_KEY_SIZE
+#define RGB_MATRIX_KEY_SIZE 16
+#endif
+
+// x and y are the physical position of the LED, measured from the top left
+// corner, in units of 1/RGB_MATRIX_KEY_SIZE of a key. Row and col are the
+// matrix position of the key above the LED, or RGB_MATRIX_NO_KEY for the
+// LEDs that are not under a key.
+typedef struct {
+  uint8_t row;
+  uint8_t col;
+  uint8_t x;
+  uint8_t y;
+} rgb_led_t;
+
+// In the order the LEDs are connected
+extern const rgb_led_t rgb_matrix_leds[RGB_MATRIX_LED_COUNT] PROGMEM;
+
+enum rgb_matrix_effects {
+  RGB_MATRIX_OFF = 0,
+  // All the LEDs in the same color
+  RGB_MATRIX_SOLID,
+  // The hue changes from left to right
+  RGB_MATRIX_GRADIENT,
+  // A ring that spreads out from each pressed key
+  RGB_MATRIX_RIPPLE,
+  // A circle that spreads out from each pressed key, changing color
+  // further away from it
+  RGB_MATRIX_SPLASH,
+  // The keys that have been pressed a lot lately glow red, the rest blue
+  RGB_MATRIX_HEATMAP,
+  RGB_MATRIX_EFFECT_MAX
+};
+
+// The last frame that was drawn
+extern RGB rgb_matrix_frame[RGB_MATRIX_LED_COUNT];
+
+void rgb_matrix_init(void);
+// Draws and sends a frame when RGB_MATRIX_FRAME_INTERVAL has passed
+void rgb_matrix_task(void);
+// Called for every key event, time is the time of the event
+void rgb_matrix_record_key(uint8_t row, uint8_t col, bool pressed, uint16_t time);
+// Draws the frame for the given time into rgb_matrix_frame
+void rgb_matrix_render(uint16_t time);
+
+void rgb_matrix_mode(uint8_t mode);
+uint8_t rgb_matrix_get_mode(void);
+void rgb_matrix_sethsv(uint16_t hue, uint8_t sat, uint8_t val);
+
+// Implemented by the keyboard
+void rgb_matrix_driver_flush(const RGB* frame, uint8_t count);
+// Called by the driver with the values it's about to send to the LEDs, which
+// have to be proportional to the current. Dims them when they would draw
+// more than RGB_MATRIX_MAX_CURRENT, returns true if it had to.
+bool rgb_matrix_limit_power(RGB* out, uint8_t count);
+
+#endif
@@ -13,15 +13,17 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
-#include <math.h>
-#include <avr/eeprom.h>
-#include <avr/interrupt.h>
-#include <util/delay.h>
+#include "eeprom.h"
+#include "wait.h"
 #include "progmem.h"
 #include "timer.h"
 #include "rgblight.h"
 #include "debug.h"
-#include "led_tables.h"
+#include "color.h"
+#include "led_table_generator.h"
+#include "led_frame.h"
+#include "rgblight_output.h"
+#include "led_power.h"
 
 __attribute__ ((weak))
 const uint8_t RGBLED_BREATHING_INTERVALS[] PROGMEM = {30, 20, 10, 5};
@@ -43,67 +45,64 @@ LED_TYPE led[RGBLED_NUM];
 uint8_t rgblight_inited = 0;
 bool rgblight_timer_enabled = false;
 
-void sethsv(uint16_t hue, uint8_t sat, uint8_t val, LED_TYPE *led1) {
-  uint8_t r = 0, g = 0, b = 0, base, color;
-
-  #ifdef RGBLIGHT_LIMIT_VAL
-    if (val > RGBLIGHT_LIMIT_VAL) {
-      val=RGBLIGHT_LIMIT_VAL; // limit the val
-    }
-  #endif
+#if !defined(RGBLIGHT_CUSTOM_DRIVER) && !defined(RGBLIGHT_CORRECT_RGB)
+// The LEDs that were last set from HSV, rgblight_set only corrects their
+// colors. The colors set as RGB, and written to led directly, are sent as
+// they are, unless RGBLIGHT_CORRECT_RGB is defined.
+static uint8_t led_from_hsv[(RGBLED_NUM + 7) / 8];
+#define LED_FROM_HSV led_from_hsv
 
-  if (sat == 0) { // Acromatic color (gray). Hue doesn't mind.
-    r = val;
-    g = val;
-    b = val;
+static void mark_led(const LED_TYPE *led1, bool from_hsv) {
+  if (led1 < led || led1 >= led + RGBLED_NUM) {
+    return;
+  }
+  uint8_t index = led1 - led;
+  if (from_hsv) {
+    led_from_hsv[index / 8] |= 1 << (index % 8);
   } else {
-    base = ((255 - sat) * val) >> 8;
-    color = (val - base) * (hue % 60) / 60;
-
-    switch (hue / 60) {
-      case 0:
-        r = val;
-        g = base + color;
-        b = base;
-        break;
-      case 1:
-        r = val - color;
-        g = val;
-        b = base;
-        break;
-      case 2:
-        r = base;
-        g = val;
-        b = base + color;
-        break;
-      case 3:
-        r = base;
-        g = val - color;
-        b = val;
-        break;
-      case 4:
-        r = base + color;
-        g = base;
-        b = val;
-        break;
-      case 5:
-        r = val;
-        g = base;
-        b = val - color;
-        break;
-    }
+    led_from_hsv[index / 8] &= ~(1 << (index % 8));
   }
-  r = pgm_read_byte(&CIE1931_CURVE[r]);
-  g = pgm_read_byte(&CIE1931_CURVE[g]);
-  b = pgm_read_byte(&CIE1931_CURVE[b]);
+}
+#else
+#define LED_FROM_HSV NULL
+#define mark_led(led1, from_hsv)
+#endif
 
-  setrgb(r, g, b, led1);
+void sethsv(uint16_t hue, uint8_t sat, uint8_t val, LED_TYPE *led1) {
+  RGB rgb = hsv_to_rgb(hue, sat, val);
+  led1->r = rgb.r;
+  led1->g = rgb.g;
+  led1->b = rgb.b;
+  mark_led(led1, true);
+  #ifdef RGBLIGHT_CUSTOM_DRIVER
+    // The custom drivers send led as it is, so the colors are corrected as
+    // they are set, otherwise rgblight_set corrects the whole frame
+    rgblight_output(led1, led1, 1, NULL);
+  #endif
+}
+
+void sethsv_range(uint16_t hue, uint16_t hue_step, uint8_t sat, uint8_t val, LED_TYPE *leds, uint8_t count) {
+  for (uint8_t i = 0; i < count; i++) {
+    sethsv(hue, sat, val, &leds[i]);
+    hue = hue_add(hue, hue_step);
+  }
 }
 
 void setrgb(uint8_t r, uint8_t g, uint8_t b, LED_TYPE *led1) {
   (*led1).r = r;
   (*led1).g = g;
   (*led1).b = b;
+  mark_led(led1, false);
+}
+
+// Sets all the LEDs to a color converted by sethsv
+static void fill_leds_hsv(const LED_TYPE *color) {
+  for (uint8_t i = 0; i < RGBLED_NUM; i++) {
+    led[i].r = color->r;
+    led[i].g = color->g;
+    led[i].b = color->b;
+    mark_led(&led[i], true);
+  }
 }
 
 
@@ -274,7 +273,7 @@ void rgblight_disable(void) {
   #ifdef RGBLIGHT_ANIMATIONS
     rgblight_timer_disable();
   #endif
-  _delay_ms(50);
+  wait_ms(50);
   rgblight_set();
 }
 
@@ -339,7 +338,8 @@ void rgblight_sethsv_noeeprom(uint16_t hue, uint8_t sat, uint8_t val) {
     inmem_config.sat = sat;
     inmem_config.val = val;
     // dprintf("rgblight set hue [MEMORY]: %u,%u,%u\n", inmem_config.hue, inmem_config.sat, inmem_config.val);
-    rgblight_setrgb(tmp_led.r, tmp_led.g, tmp_led.b);
+    fill_leds_hsv(&tmp_led);
+    rgblight_set();
   }
 }
 void rgblight_sethsv(uint16_t hue, uint8_t sat, uint8_t val) {
@@ -392,9 +392,7 @@ void rgblight_setrgb(uint8_t r, uint8_t g, uint8_t b) {
   if (!rgblight_config.enable) { return; }
 
   for (uint8_t i = 0; i < RGBLED_NUM; i++) {
-    led[i].r = r;
-    led[i].g = g;
-    led[i].b = b;
+    setrgb(r, g, b, &led[i]);
   }
   rgblight_set();
 }
@@ -402,45 +400,67 @@ void rgblight_setrgb(uint8_t r, uint8_t g, uint8_t b) {
 void rgblight_setrgb_at(uint8_t r, uint8_t g, uint8_t b, uint8_t index) {
   if (!rgblight_config.enable || index >= RGBLED_NUM) { return; }
 
-  led[index].r = r;
-  led[index].g = g;
-  led[index].b = b;
+  setrgb(r, g, b, &led[index]);
   rgblight_set();
 }
 
 void rgblight_sethsv_at(uint16_t hue, uint8_t sat, uint8_t val, uint8_t index) {
-  if (!rgblight_config.enable) { return; }
+  if (!rgblight_config.enable || index >= RGBLED_NUM) { return; }
 
-  LED_TYPE tmp_led;
-  sethsv(hue, sat, val, &tmp_led);
-  rgblight_setrgb_at(tmp_led.r, tmp_led.g, tmp_led.b, index);
+  sethsv(hue, sat, val, &led[index]);
+  rgblight_set();
 }
 
 #ifndef RGBLIGHT_CUSTOM_DRIVER
+// led is corrected into out_led, see rgblight_output.h
+static LED_TYPE out_led[RGBLED_NUM];
+// The colors last sent to the LEDs, nothing is sent when they haven't
+// changed. The first frame is always sent in full.
+static LED_TYPE sent_led[RGBLED_NUM];
+static bool sent_led_valid = false;
+
 void rgblight_set(void) {
-  if (rgblight_config.enable) {
-    #ifdef RGBW
-      ws2812_setleds_rgbw(led, RGBLED_NUM);
-    #else
-      ws2812_setleds(led, RGBLED_NUM);
-    #endif
-  } else {
+  if (!rgblight_config.enable) {
     for (uint8_t i = 0; i < RGBLED_NUM; i++) {
       led[i].r = 0;
       led[i].g = 0;
       led[i].b = 0;
     }
-    #ifdef RGBW
-      ws2812_setleds_rgbw(led, RGBLED_NUM);
-    #else
-      ws2812_setleds(led, RGBLED_NUM);
-    #endif
   }
+
+  rgblight_output(led, out_led, RGBLED_NUM, LED_FROM_HSV);
+  #ifdef RGBLIGHT_MAX_CURRENT
+    led_power_limit((uint8_t*)out_led, sizeof(out_led), RGBLIGHT_LED_CURRENT, RGBLIGHT_MAX_CURRENT);
+  #endif
+  uint16_t length = led_frame_changed_length((uint8_t*)out_led, (uint8_t*)sent_led, sizeof(out_led));
+  if (!sent_led_valid) {
+    length = sizeof(out_led);
+    sent_led_valid = true;
+  }
+  if (length == 0) {
+    return;
+  }
+  #ifdef RGBLIGHT_SEND_CHANGED_LEDS_ONLY
+    uint16_t count = (length + sizeof(LED_TYPE) - 1) / sizeof(LED_TYPE);
+  #else
+    uint16_t count = RGBLED_NUM;
+  #endif
+
+  #ifdef RGBW
+    ws2812_setleds_rgbw(out_led, count);
+  #else
+    ws2812_setleds(out_led, count);
+  #endif
 }
 #endif
 
 #ifdef RGBLIGHT_ANIMATIONS
 
+static uint16_t frame_timer = 0;
+// Set when the effects have to draw the next frame, even if it looks the
+// same as the last one they drew
+static bool effect_redraw = true;
+
 // Animation timer -- AVR Timer3
 void rgblight_timer_init(void) {
   // static uint8_t rgblight_timer_is_init = 0;
@@ -462,6 +482,7 @@ void rgblight_timer_init(void) {
 }
 void rgblight_timer_enable(void) {
   rgblight_timer_enabled = true;
+  effect_redraw = true;
   dprintf("TIMER3 enabled.\n");
 }
 void rgblight_timer_disable(void) {
@@ -479,8 +500,31 @@ void rgblight_show_solid_color(uint8_t r, uint8_t g, uint8_t b) {
   rgblight_setrgb(r, g, b);
 }
 
+// The effects can fall behind by this many steps, before they give up
+// catching up, for example after the animations have been paused
+#define EFFECT_MAX_STEPS 32
+
+// Returns the number of intervals that have passed since last_timer, and
+// moves it forward by the same amount. The effects advance that many steps
+// each frame, so they keep their speed whatever the frame rate is.
+static uint8_t effect_steps(uint16_t *last_timer, uint16_t interval) {
+  uint16_t steps = timer_elapsed(*last_timer) / interval;
+  if (steps > EFFECT_MAX_STEPS) {
+    *last_timer = timer_read();
+    return 1;
+  }
+  *last_timer += steps * interval;
+  return steps;
+}
+
+// Draws at most one frame each call, and only when RGBLIGHT_FRAME_INTERVAL
+// has passed. Frames that were missed are dropped rather than drawn late, so
+// a call never takes longer than drawing and sending a single frame. The
+// LEDs are only updated from here, so call it from the main loop, after the
+// matrix has been scanned.
 void rgblight_task(void) {
-  if (rgblight_timer_enabled) {
+  if (rgblight_timer_enabled && timer_elapsed(frame_timer) >= RGBLIGHT_FRAME_INTERVAL) {
+    frame_timer = timer_read();
     // mode = 1, static light, do nothing here
     if (rgblight_config.mode >= 2 && rgblight_config.mode <= 5) {
       // mode = 2 to 5, breathing mode
@@ -505,56 +549,75 @@ void rgblight_task(void) {
 }
 
 // Effects
+#define BREATHE_ENTRY(i) LED_TABLE_BREATHE(i, RGBLIGHT_EFFECT_BREATHE_TABLE_SIZE, \
+    RGBLIGHT_EFFECT_BREATHE_CENTER, RGBLIGHT_EFFECT_BREATHE_MAX)
+
+#if RGBLIGHT_EFFECT_BREATHE_TABLE_SIZE == 64
+  #define BREATHE_TABLE_BITS 6
+  #define BREATHE_TABLE LED_TABLE_64
+#elif RGBLIGHT_EFFECT_BREATHE_TABLE_SIZE == 128
+  #define BREATHE_TABLE_BITS 7
+  #define BREATHE_TABLE LED_TABLE_128
+#elif RGBLIGHT_EFFECT_BREATHE_TABLE_SIZE == 256
+  #define BREATHE_TABLE_BITS 8
+  #define BREATHE_TABLE LED_TABLE_256
+#else
+  #error "RGBLIGHT_EFFECT_BREATHE_TABLE_SIZE has to be 64, 128 or 256"
+#endif
+
+// Generated by the compiler, see led_table_generator.h
+static const uint8_t breathe_table[] PROGMEM = { BREATHE_TABLE(BREATHE_ENTRY) };
+
 void rgblight_effect_breathing(uint8_t interval) {
   static uint8_t pos = 0;
   static uint16_t last_timer = 0;
-  float val;
+  static uint16_t last_hue = 0;
+  static uint8_t last_sat = 0;
+  static uint8_t last_val = 0;
 
-  if (timer_elapsed(last_timer) < pgm_read_byte(&RGBLED_BREATHING_INTERVALS[interval])) {
+  uint8_t steps = effect_steps(&last_timer, pgm_read_byte(&RGBLED_BREATHING_INTERVALS[interval]));
+  if (!steps) {
     return;
   }
-  last_timer = timer_read();
-
 
-  // http://sean.voisen.org/blog/2011/10/breathing-led-with-arduino/
-  val = (exp(sin((pos/255.0)*M_PI)) - RGBLIGHT_EFFECT_BREATHE_CENTER/M_E)*(RGBLIGHT_EFFECT_BREATHE_MAX/(M_E-1/M_E));
+  uint8_t val = led_table_read(breathe_table, BREATHE_TABLE_BITS, pos);
+  pos += steps;
+  // The curve stays flat for a while at the bottom, don't send the same
+  // frame again
+  if (!effect_redraw && val == last_val && rgblight_config.hue == last_hue && rgblight_config.sat == last_sat) {
+    return;
+  }
+  effect_redraw = false;
+  last_hue = rgblight_config.hue;
+  last_sat = rgblight_config.sat;
+  last_val = val;
   rgblight_sethsv_noeeprom(rgblight_config.hue, rgblight_config.sat, val);
-  pos = (pos + 1) % 256;
 }
 void rgblight_effect_rainbow_mood(uint8_t interval) {
   static uint16_t current_hue = 0;
   static uint16_t last_timer = 0;
 
-  if (timer_elapsed(last_timer) < pgm_read_byte(&RGBLED_RAINBOW_MOOD_INTERVALS[interval])) {
+  uint8_t steps = effect_steps(&last_timer, pgm_read_byte(&RGBLED_RAINBOW_MOOD_INTERVALS[interval]));
+  if (!steps) {
     return;
   }
-  last_timer = timer_read();
   rgblight_sethsv_noeeprom(current_hue, rgblight_config.sat, rgblight_config.val);
-  current_hue = (current_hue + 1) % 360;
+  current_hue = (current_hue + steps) % 360;
 }
 void rgblight_effect_rainbow_swirl(uint8_t interval) {
   static uint16_t current_hue = 0;
   static uint16_t last_timer = 0;
-  uint16_t hue;
-  uint8_t i;
-  if (timer_elapsed(last_timer) < pgm_read_byte(&RGBLED_RAINBOW_SWIRL_INTERVALS[interval / 2])) {
+  uint8_t steps = effect_steps(&last_timer, pgm_read_byte(&RGBLED_RAINBOW_SWIRL_INTERVALS[interval / 2]));
+  if (!steps) {
     return;
   }
-  last_timer = timer_read();
-  for (i = 0; i < RGBLED_NUM; i++) {
-    hue = (360 / RGBLED_NUM * i + current_hue) % 360;
-    sethsv(hue, rgblight_config.sat, rgblight_config.val, (LED_TYPE *)&led[i]);
-  }
+  sethsv_range(current_hue, 360 / RGBLED_NUM, rgblight_config.sat, rgblight_config.val, led, RGBLED_NUM);
   rgblight_set();
 
   if (interval % 2) {
-    current_hue = (current_hue + 1) % 360;
+    current_hue = (current_hue + steps) % 360;
   } else {
-    if (current_hue - 1 < 0) {
-      current_hue = 359;
-    } else {
-      current_hue = current_hue - 1;
-    }
+    current_hue = (current_hue + 360 - steps) % 360;
   }
 }
 void rgblight_effect_snake(uint8_t interval) {
@@ -566,10 +629,10 @@ void rgblight_effect_snake(uint8_t interval) {
   if (interval % 2) {
     increment = -1;
   }
-  if (timer_elapsed(last_timer) < pgm_read_byte(&RGBLED_SNAKE_INTERVALS[interval / 2])) {
+  uint8_t steps = effect_steps(&last_timer, pgm_read_byte(&RGBLED_SNAKE_INTERVALS[interval / 2]));
+  if (!steps) {
     return;
   }
-  last_timer = timer_read();
   for (i = 0; i < RGBLED_NUM; i++) {
     led[i].r = 0;
     led[i].g = 0;
@@ -585,22 +648,19 @@ void rgblight_effect_snake(uint8_t interval) {
     }
   }
   rgblight_set();
+  steps %= RGBLED_NUM;
   if (increment == 1) {
-    if (pos - 1 < 0) {
-      pos = RGBLED_NUM - 1;
-    } else {
-      pos -= 1;
-    }
+    pos = (pos + RGBLED_NUM - steps) % RGBLED_NUM;
   } else {
-    pos = (pos + 1) % RGBLED_NUM;
+    pos = (pos + steps) % RGBLED_NUM;
   }
 }
 void rgblight_effect_knight(uint8_t interval) {
   static uint16_t last_timer = 0;
-  if (timer_elapsed(last_timer) < pgm_read_byte(&RGBLED_KNIGHT_INTERVALS[interval])) {
+  uint8_t steps = effect_steps(&last_timer, pgm_read_byte(&RGBLED_KNIGHT_INTERVALS[interval]));
+  if (!steps) {
     return;
   }
-  last_timer = timer_read();
 
   static int8_t low_bound = 0;
   static int8_t high_bound = RGBLIGHT_EFFECT_KNIGHT_LENGTH - 1;
@@ -629,11 +689,13 @@ void rgblight_effect_knight(uint8_t interval) {
 
   // Move from low_bound to high_bound changing the direction we increment each
   // time a boundary is hit.
-  low_bound += increment;
-  high_bound += increment;
+  while (steps--) {
+    low_bound += increment;
+    high_bound += increment;
 
-  if (high_bound <= 0 || low_bound >= RGBLIGHT_EFFECT_KNIGHT_LED_NUM - 1) {
-    increment = -increment;
+    if (high_bound <= 0 || low_bound >= RGBLIGHT_EFFECT_KNIGHT_LED_NUM - 1) {
+      increment = -increment;
+    }
   }
 }
 
@@ -643,11 +705,11 @@ void rgblight_effect_christmas(void) {
   static uint16_t last_timer = 0;
   uint16_t hue;
   uint8_t i;
-  if (timer_elapsed(last_timer) < RGBLIGHT_EFFECT_CHRISTMAS_INTERVAL) {
+  uint8_t steps = effect_steps(&last_timer, RGBLIGHT_EFFECT_CHRISTMAS_INTERVAL);
+  if (!steps) {
     return;
   }
-  last_timer = timer_read();
-  current_offset = (current_offset + 1) % 2;
+  current_offset = (current_offset + steps) % 2;
   for (i = 0; i < RGBLED_NUM; i++) {
     hue = 0 + ((i/RGBLIGHT_EFFECT_CHRISTMAS_STEP + current_offset) % 2) * 120;
     sethsv(hue, rgblight_config.sat, rgblight_config.val, (LED_TYPE *)&led[i]);
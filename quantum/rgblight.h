@@ -30,6 +30,12 @@
 #define RGBLIGHT_EFFECT_BREATHE_MAX 255   // 0-255
 #endif
 
+// The number of entries in the breathing curve, 64, 128 or 256. The smaller
+// tables save flash, and are interpolated.
+#ifndef RGBLIGHT_EFFECT_BREATHE_TABLE_SIZE
+#define RGBLIGHT_EFFECT_BREATHE_TABLE_SIZE 256
+#endif
+
 #ifndef RGBLIGHT_EFFECT_SNAKE_LENGTH
 #define RGBLIGHT_EFFECT_SNAKE_LENGTH 4
 #endif
@@ -54,6 +60,22 @@
 #define RGBLIGHT_EFFECT_CHRISTMAS_STEP 2
 #endif
 
+// The animations are drawn and sent to the LEDs at most once every
+// RGBLIGHT_FRAME_INTERVAL milliseconds. Sending a frame blocks the keyboard
+// for about 30us per LED, the effects still run at the same speed with a
+// longer interval, only with bigger steps.
+#ifndef RGBLIGHT_FRAME_INTERVAL
+#define RGBLIGHT_FRAME_INTERVAL 16
+#endif
+
+// Define RGBLIGHT_MAX_CURRENT to the total current in mA the LEDs are allowed
+// to draw, the whole strip is dimmed when a frame would draw more.
+// RGBLIGHT_LED_CURRENT is the current of a single color channel at full
+// brightness.
+#ifndef RGBLIGHT_LED_CURRENT
+#define RGBLIGHT_LED_CURRENT 20
+#endif
+
 #ifndef RGBLIGHT_HUE_STEP
 #define RGBLIGHT_HUE_STEP 10
 #endif
@@ -126,6 +148,8 @@ void eeconfig_update_rgblight_default(void);
 void eeconfig_debug_rgblight(void);
 
 void sethsv(uint16_t hue, uint8_t sat, uint8_t val, LED_TYPE *led1);
+// Sets count leds, stepping the hue by hue_step (less than 360) for each
+void sethsv_range(uint16_t hue, uint16_t hue_step, uint8_t sat, uint8_t val, LED_TYPE *leds, uint8_t count);
 void setrgb(uint8_t r, uint8_t g, uint8_t b, LED_TYPE *led1);
 void rgblight_sethsv_noeeprom(uint16_t hue, uint8_t sat, uint8_t val);
 
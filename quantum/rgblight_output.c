@@ -0,0 +1,80 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rgblight_output.h"
+#include "led_tables.h"
+#include "led_table_generator.h"
+
+#ifndef RGBLIGHT_LIMIT_VAL
+#define RGBLIGHT_LIMIT_VAL 255
+#endif
+
+#ifndef RGBLIGHT_WHITE_BALANCE_R
+#define RGBLIGHT_WHITE_BALANCE_R 255
+#endif
+#ifndef RGBLIGHT_WHITE_BALANCE_G
+#define RGBLIGHT_WHITE_BALANCE_G 255
+#endif
+#ifndef RGBLIGHT_WHITE_BALANCE_B
+#define RGBLIGHT_WHITE_BALANCE_B 255
+#endif
+
+#define OUTPUT_SCALED (RGBLIGHT_LIMIT_VAL < 255 || RGBLIGHT_WHITE_BALANCE_R < 255 || \
+    RGBLIGHT_WHITE_BALANCE_G < 255 || RGBLIGHT_WHITE_BALANCE_B < 255)
+
+#if OUTPUT_SCALED
+// The limit is a value like the ones the effects use, so it goes through the
+// same curve, evaluated by the compiler
+#define CHANNEL_SCALE(balance) ((uint8_t)(LED_TABLE_CIE1931(RGBLIGHT_LIMIT_VAL) * (balance) + 0.5))
+
+static const uint8_t scale_r = CHANNEL_SCALE(RGBLIGHT_WHITE_BALANCE_R);
+static const uint8_t scale_g = CHANNEL_SCALE(RGBLIGHT_WHITE_BALANCE_G);
+static const uint8_t scale_b = CHANNEL_SCALE(RGBLIGHT_WHITE_BALANCE_B);
+
+// Multiplies by scale / 255, 255 keeps the value as it is
+static inline uint8_t scale(uint8_t value, uint8_t amount) {
+  return ((uint16_t)value * amount + 255) >> 8;
+}
+#endif
+
+void rgblight_output(const LED_TYPE* frame, LED_TYPE* out, uint8_t count, const uint8_t* from_hsv) {
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t r = frame[i].r;
+    uint8_t g = frame[i].g;
+    uint8_t b = frame[i].b;
+    if (!from_hsv || (from_hsv[i / 8] & (1 << (i % 8)))) {
+      r = pgm_read_byte(&CIE1931_CURVE[r]);
+      g = pgm_read_byte(&CIE1931_CURVE[g]);
+      b = pgm_read_byte(&CIE1931_CURVE[b]);
+#if OUTPUT_SCALED
+      r = scale(r, scale_r);
+      g = scale(g, scale_g);
+      b = scale(b, scale_b);
+#endif
+    }
+#ifdef RGBW
+    uint8_t w = r < g ? r : g;
+    w = w < b ? w : b;
+    r -= w;
+    g -= w;
+    b -= w;
+    out[i].w = w;
+#endif
+    out[i].r = r;
+    out[i].g = g;
+    out[i].b = b;
+  }
+}
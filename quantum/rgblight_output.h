@@ -0,0 +1,40 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RGBLIGHT_OUTPUT_H
+#define RGBLIGHT_OUTPUT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "rgblight_types.h"
+
+// The effects draw colors the way they are perceived, and this turns a whole
+// frame into the values sent to the LEDs in a single pass:
+//
+// 1. The CIE 1931 lightness curve, after which the values are proportional
+//    to the light, and to the current drawn.
+// 2. The brightness limit, RGBLIGHT_LIMIT_VAL, and the white balance,
+//    RGBLIGHT_WHITE_BALANCE_R, _G and _B, combined into one scale per
+//    channel at compile time.
+// 3. With RGBW, the part the three colors have in common goes to the white
+//    LED instead.
+//
+// The first two steps only apply to the LEDs whose bit is set in from_hsv,
+// the colors set as RGB are sent as they are. A NULL from_hsv corrects all
+// the LEDs. frame and out can be the same array.
+void rgblight_output(const LED_TYPE* frame, LED_TYPE* out, uint8_t count, const uint8_t* from_hsv);
+
+#endif
@@ -0,0 +1,81 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "serial_link/protocol/baud_rate.h"
+
+void baud_rate_init(baud_rate_state_t* state, uint8_t num_rates) {
+    state->rate_index = 0;
+    state->num_rates = num_rates;
+    state->ceiling = num_rates - 1;
+    state->ceiling_age = 0;
+    state->good_periods = 0;
+    state->skip_next = false;
+}
+
+bool baud_rate_update(baud_rate_state_t* state, uint32_t frames, uint32_t errors) {
+    // The period when the rate was changed always contains some garbage
+    if (state->skip_next) {
+        state->skip_next = false;
+        return false;
+    }
+    if (errors * 1000 > frames * SERIAL_LINK_BAUD_ERROR_PERMILLE) {
+        state->good_periods = 0;
+        if (state->rate_index > 0) {
+            state->rate_index--;
+            state->ceiling = state->rate_index;
+            state->ceiling_age = 0;
+            state->skip_next = true;
+            return true;
+        }
+        return false;
+    }
+    if (state->ceiling < state->num_rates - 1) {
+        if (++state->ceiling_age >= SERIAL_LINK_BAUD_RETRY_PERIODS) {
+            state->ceiling++;
+            state->ceiling_age = 0;
+        }
+    }
+    // Idle periods don't tell anything about the link quality
+    if (frames > 0 && state->rate_index < state->ceiling) {
+        if (++state->good_periods >= SERIAL_LINK_BAUD_STEP_UP_PERIODS) {
+            state->rate_index++;
+            state->good_periods = 0;
+            state->skip_next = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool baud_rate_link_lost(baud_rate_state_t* state) {
+    state->good_periods = 0;
+    if (state->rate_index == 0) {
+        return false;
+    }
+    state->ceiling = state->rate_index - 1;
+    state->ceiling_age = 0;
+    state->rate_index = 0;
+    state->skip_next = true;
+    return true;
+}
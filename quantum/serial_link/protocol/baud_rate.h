@@ -0,0 +1,66 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SERIAL_LINK_BAUD_RATE_H
+#define SERIAL_LINK_BAUD_RATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Decides the baud rate of a single link, based on the frames and errors
+// seen during a measurement period. The rates are referred to by index,
+// from the slowest and safest rate at index 0 to the fastest.
+// When the error rate goes above the limit, the rate steps down, and is
+// not allowed to go back up until it has been stable for a while.
+typedef struct {
+    uint8_t rate_index;
+    uint8_t num_rates;
+    uint8_t ceiling;
+    uint8_t ceiling_age;
+    uint8_t good_periods;
+    bool skip_next;
+} baud_rate_state_t;
+
+// Errors per thousand frames that are tolerated
+#ifndef SERIAL_LINK_BAUD_ERROR_PERMILLE
+#define SERIAL_LINK_BAUD_ERROR_PERMILLE 10
+#endif
+
+// Number of error free periods before trying the next faster rate
+#ifndef SERIAL_LINK_BAUD_STEP_UP_PERIODS
+#define SERIAL_LINK_BAUD_STEP_UP_PERIODS 5
+#endif
+
+// Number of periods before a rate that failed is tried again
+#ifndef SERIAL_LINK_BAUD_RETRY_PERIODS
+#define SERIAL_LINK_BAUD_RETRY_PERIODS 60
+#endif
+
+void baud_rate_init(baud_rate_state_t* state, uint8_t num_rates);
+// Returns true when the rate index changes
+bool baud_rate_update(baud_rate_state_t* state, uint32_t frames, uint32_t errors);
+// Returns true when the rate index changes
+bool baud_rate_link_lost(baud_rate_state_t* state);
+
+#endif
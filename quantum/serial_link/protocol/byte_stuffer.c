@@ -25,21 +25,14 @@ SOFTWARE.
 #include "serial_link/protocol/byte_stuffer.h"
 #include "serial_link/protocol/frame_validator.h"
 #include "serial_link/protocol/physical.h"
+#include "serial_link/protocol/link_statistics.h"
+#include "serial_link/protocol/context.h"
 #include <stdbool.h>
 
 // This implements the "Consistent overhead byte stuffing protocol"
 // https://en.wikipedia.org/wiki/Consistent_Overhead_Byte_Stuffing
 // http://www.stuartcheshire.org/papers/COBSforToN.pdf
 
-typedef struct byte_stuffer_state {
-    uint16_t next_zero;
-    uint16_t data_pos;
-    bool long_frame;
-    uint8_t data[MAX_FRAME_SIZE];
-}byte_stuffer_state_t;
-
-static byte_stuffer_state_t states[NUM_LINKS];
-
 void init_byte_stuffer_state(byte_stuffer_state_t* state) {
     state->next_zero = 0;
     state->data_pos = 0;
@@ -49,12 +42,13 @@ void init_byte_stuffer_state(byte_stuffer_state_t* state) {
 void init_byte_stuffer(void) {
     int i;
     for (i=0;i<NUM_LINKS;i++) {
-        init_byte_stuffer_state(&states[i]);
+        init_byte_stuffer_state(&serial_link_context->byte_stuffer[i]);
     }
 }
 
 void byte_stuffer_recv_byte(uint8_t link, uint8_t data) {
-    byte_stuffer_state_t* state = &states[link];
+    byte_stuffer_state_t* state = &serial_link_context->byte_stuffer[link];
+    get_link_statistics(link)->bytes_received++;
     // Start of a new frame
     if (state->next_zero == 0) {
         state->next_zero = data;
@@ -74,12 +68,14 @@ void byte_stuffer_recv_byte(uint8_t link, uint8_t data) {
         else {
             // The frame is invalid, so reset
             init_byte_stuffer_state(state);
+            get_link_statistics(link)->cobs_resets++;
         }
     }
     else {
         if (state->data_pos == MAX_FRAME_SIZE) {
             // We exceeded our maximum frame size
             // therefore there's nothing else to do than reset to a new frame
+            get_link_statistics(link)->cobs_resets++;
             state->next_zero = data;
             state->long_frame = data == 0xFF;
             state->data_pos = 0;
@@ -103,6 +99,7 @@ void byte_stuffer_recv_byte(uint8_t link, uint8_t data) {
 }
 
 static void send_block(uint8_t link, uint8_t* start, uint8_t* end, uint8_t num_non_zero) {
+    get_link_statistics(link)->bytes_sent += 1 + (end - start);
     send_data(link, &num_non_zero, 1);
     if (end > start) {
         send_data(link, start, end-start);
@@ -138,5 +135,6 @@ void byte_stuffer_send_frame(uint8_t link, uint8_t* data, uint16_t size) {
         }
         send_block(link, start, data, num_non_zero);
         send_data(link, &zero, 1);
+        get_link_statistics(link)->bytes_sent++;
     }
 }
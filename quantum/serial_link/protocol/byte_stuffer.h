@@ -26,10 +26,18 @@ SOFTWARE.
 #define SERIAL_LINK_BYTE_STUFFER_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #define MAX_FRAME_SIZE 1024
 #define NUM_LINKS 2
 
+typedef struct byte_stuffer_state {
+    uint16_t next_zero;
+    uint16_t data_pos;
+    bool long_frame;
+    uint8_t data[MAX_FRAME_SIZE];
+}byte_stuffer_state_t;
+
 void init_byte_stuffer(void);
 void byte_stuffer_recv_byte(uint8_t link, uint8_t data);
 void byte_stuffer_send_frame(uint8_t link, uint8_t* data, uint16_t size);
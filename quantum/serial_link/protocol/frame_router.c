@@ -25,15 +25,14 @@ SOFTWARE.
 #include "serial_link/protocol/frame_router.h"
 #include "serial_link/protocol/transport.h"
 #include "serial_link/protocol/frame_validator.h"
-
-static bool is_master;
+#include "serial_link/protocol/context.h"
 
 void router_set_master(bool master) {
-   is_master = master;
+   serial_link_context->is_master = master;
 }
 
 void route_incoming_frame(uint8_t link, uint8_t* data, uint16_t size){
-    if (is_master) {
+    if (serial_link_context->is_master) {
         if (link == DOWN_LINK) {
             transport_recv_frame(data[size-1], data, size - 1);
         }
@@ -55,13 +54,13 @@ void route_incoming_frame(uint8_t link, uint8_t* data, uint16_t size){
 
 void router_send_frame(uint8_t destination, uint8_t* data, uint16_t size) {
     if (destination == 0) {
-        if (!is_master) {
+        if (!serial_link_context->is_master) {
             data[size] = 1;
             validator_send_frame(UP_LINK, data, size + 1);
         }
     }
     else {
-        if (is_master) {
+        if (serial_link_context->is_master) {
             data[size] = destination;
             validator_send_frame(DOWN_LINK, data, size + 1);
         }
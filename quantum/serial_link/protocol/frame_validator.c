@@ -25,6 +25,7 @@ SOFTWARE.
 #include "serial_link/protocol/frame_validator.h"
 #include "serial_link/protocol/frame_router.h"
 #include "serial_link/protocol/byte_stuffer.h"
+#include "serial_link/protocol/link_statistics.h"
 #include <string.h>
 
 const uint32_t poly8_lookup[256] =
@@ -109,13 +110,21 @@ void validator_recv_frame(uint8_t link, uint8_t* data, uint16_t size) {
         memcpy(&frame_crc, data + size -4, 4);
         uint32_t expected_crc = crc32_byte(data, size - 4);
         if (frame_crc == expected_crc) {
+            get_link_statistics(link)->frames_received++;
             route_incoming_frame(link, data, size-4);
         }
+        else {
+            get_link_statistics(link)->crc_failures++;
+        }
+    }
+    else {
+        get_link_statistics(link)->crc_failures++;
     }
 }
 
 void validator_send_frame(uint8_t link, uint8_t* data, uint16_t size) {
     uint32_t crc = crc32_byte(data, size);
     memcpy(data + size, &crc, 4);
+    get_link_statistics(link)->frames_sent++;
     byte_stuffer_send_frame(link, data, size + 4);
 }
@@ -0,0 +1,77 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "serial_link/protocol/key_time.h"
+
+void key_time_init(key_time_state_t* state, uint16_t now) {
+    state->last_time = now;
+    state->num_pending = 0;
+}
+
+uint16_t key_time_order(key_time_state_t* state, uint16_t time) {
+    // The times wrap around, so compare the difference instead
+    if ((int16_t)(time - state->last_time) < 0) {
+        return state->last_time;
+    }
+    state->last_time = time;
+    return time;
+}
+
+static int8_t find_pending(key_time_state_t* state, uint8_t row, uint8_t col) {
+    for (uint8_t i=0;i<state->num_pending;i++) {
+        if (state->pending[i].row == row && state->pending[i].col == col) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool key_time_add(key_time_state_t* state, uint8_t row, uint8_t col, uint16_t time) {
+    if (state->num_pending >= KEY_TIME_PENDING_KEYS || find_pending(state, row, col) >= 0) {
+        return false;
+    }
+    key_time_pending_t* p = &state->pending[state->num_pending++];
+    p->row = row;
+    p->col = col;
+    p->time = time;
+    return true;
+}
+
+bool key_time_is_pending(key_time_state_t* state, uint8_t row, uint8_t col) {
+    return find_pending(state, row, col) >= 0;
+}
+
+void key_time_clear(key_time_state_t* state) {
+    state->num_pending = 0;
+}
+
+uint16_t key_time_get(key_time_state_t* state, uint8_t row, uint8_t col, uint16_t now) {
+    int8_t i = find_pending(state, row, col);
+    if (i < 0) {
+        return key_time_order(state, now);
+    }
+    uint16_t time = state->pending[i].time;
+    state->pending[i] = state->pending[--state->num_pending];
+    return key_time_order(state, time);
+}
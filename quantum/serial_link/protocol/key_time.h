@@ -0,0 +1,67 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SERIAL_LINK_KEY_TIME_H
+#define SERIAL_LINK_KEY_TIME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Define this in your config.h to change how many slave keys can wait
+// for keyboard_task at the same time
+#ifndef KEY_TIME_PENDING_KEYS
+#define KEY_TIME_PENDING_KEYS 8
+#endif
+
+typedef struct {
+    uint8_t row;
+    uint8_t col;
+    uint16_t time;
+} key_time_pending_t;
+
+// Keeps the times of the key events given to action_exec in order. The slave
+// key events carry the time when they happened, which can be earlier than
+// a key that has already been processed. Such events get the time of the
+// last key instead, so that the time differences that the tapping code
+// calculates never wrap around. The ticks don't go through here, they always
+// use the current time, which is never earlier than a key.
+typedef struct {
+    uint16_t last_time;
+    uint8_t num_pending;
+    key_time_pending_t pending[KEY_TIME_PENDING_KEYS];
+} key_time_state_t;
+
+void key_time_init(key_time_state_t* state, uint16_t now);
+// Returns the time to use for a key event that happened at time
+uint16_t key_time_order(key_time_state_t* state, uint16_t time);
+// Remembers the time of a slave key until keyboard_task processes it,
+// returns false if there's no room for it
+bool key_time_add(key_time_state_t* state, uint8_t row, uint8_t col, uint16_t time);
+bool key_time_is_pending(key_time_state_t* state, uint8_t row, uint8_t col);
+void key_time_clear(key_time_state_t* state);
+// Returns the time to use for the key, the time it was added with for slave
+// keys, or now for local keys
+uint16_t key_time_get(key_time_state_t* state, uint8_t row, uint8_t col, uint16_t now);
+
+#endif
@@ -0,0 +1,77 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "serial_link/protocol/link_statistics.h"
+#include "serial_link/protocol/context.h"
+#include <string.h>
+
+
+void init_link_statistics(void) {
+    memset(&serial_link_context->statistics, 0, sizeof(link_statistics_state_t));
+}
+
+link_statistics_t* get_link_statistics(uint8_t link) {
+    return &serial_link_context->statistics.links[link];
+}
+
+void link_statistics_update_rates(uint32_t elapsed_ms) {
+    if (elapsed_ms == 0) {
+        return;
+    }
+    link_statistics_state_t* state = &serial_link_context->statistics;
+    int i;
+    for (i=0;i<NUM_LINKS;i++) {
+        link_statistics_t* s = &state->links[i];
+        // The unsigned subtraction handles the wrap around of the counters
+        uint32_t sent = s->bytes_sent - state->last_bytes_sent[i];
+        uint32_t received = s->bytes_received - state->last_bytes_received[i];
+        state->last_bytes_sent[i] = s->bytes_sent;
+        state->last_bytes_received[i] = s->bytes_received;
+        s->bytes_sent_per_second = (uint64_t)sent * 1000 / elapsed_ms;
+        s->bytes_received_per_second = (uint64_t)received * 1000 / elapsed_ms;
+    }
+}
+
+void link_statistics_add_round_trip(uint8_t slave, uint32_t time_us) {
+    if (slave >= NUM_SLAVES) {
+        return;
+    }
+    round_trip_statistics_t* s = &serial_link_context->statistics.round_trips[slave];
+    s->last_us = time_us;
+    if (s->num_samples == 0) {
+        s->average_us = time_us;
+    }
+    else {
+        // Exponential moving average with a weight of 1/8 for the new sample
+        s->average_us = s->average_us - s->average_us / 8 + time_us / 8;
+    }
+    if (time_us > s->max_us) {
+        s->max_us = time_us;
+    }
+    s->num_samples++;
+}
+
+round_trip_statistics_t* get_round_trip_statistics(uint8_t slave) {
+    return &serial_link_context->statistics.round_trips[slave];
+}
@@ -0,0 +1,71 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SERIAL_LINK_LINK_STATISTICS_H
+#define SERIAL_LINK_LINK_STATISTICS_H
+
+#include <stdint.h>
+#include "serial_link/protocol/byte_stuffer.h"
+#include "serial_link/protocol/transport.h"
+
+// The counters are updated by the protocol layers, from the serial link thread
+typedef struct {
+    uint32_t frames_sent;
+    uint32_t frames_received;
+    uint32_t crc_failures;
+    // Number of times the byte stuffer had to throw away a partially received frame
+    uint32_t cobs_resets;
+    uint32_t overruns;
+    // Parity, framing and noise errors reported by the UART
+    uint32_t line_errors;
+    uint32_t bytes_sent;
+    uint32_t bytes_received;
+    // Calculated by link_statistics_update_rates
+    uint32_t bytes_sent_per_second;
+    uint32_t bytes_received_per_second;
+} link_statistics_t;
+
+typedef struct {
+    uint32_t last_us;
+    uint32_t average_us;
+    uint32_t max_us;
+    uint32_t num_samples;
+} round_trip_statistics_t;
+
+typedef struct {
+    link_statistics_t links[NUM_LINKS];
+    round_trip_statistics_t round_trips[NUM_SLAVES];
+    uint32_t last_bytes_sent[NUM_LINKS];
+    uint32_t last_bytes_received[NUM_LINKS];
+} link_statistics_state_t;
+
+void init_link_statistics(void);
+link_statistics_t* get_link_statistics(uint8_t link);
+void link_statistics_update_rates(uint32_t elapsed_ms);
+
+// The round trip time from the master to a slave and back
+void link_statistics_add_round_trip(uint8_t slave, uint32_t time_us);
+round_trip_statistics_t* get_round_trip_statistics(uint8_t slave);
+
+#endif
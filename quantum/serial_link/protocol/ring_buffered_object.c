@@ -0,0 +1,68 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "serial_link/protocol/ring_buffered_object.h"
+#include <stddef.h>
+
+// The head is only written by the producer and the tail only by the consumer.
+// They are free running counters, which works since the number of slots is
+// a power of two. The acquire/release pairs make sure that the contents of a
+// slot are visible before the index that publishes it.
+#define LOAD(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define STORE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+
+void ring_buffer_init(ring_buffer_object_t* object) {
+    object->head = 0;
+    object->tail = 0;
+}
+
+void* ring_buffer_begin_write_internal(uint16_t object_size, uint8_t num_slots, ring_buffer_object_t* object) {
+    uint8_t head = object->head;
+    uint8_t tail = LOAD(object->tail);
+    if ((uint8_t)(head - tail) >= num_slots) {
+        return NULL;
+    }
+    return object->buffer + object_size * (head & (num_slots - 1));
+}
+
+void ring_buffer_end_write_internal(ring_buffer_object_t* object) {
+    STORE(object->head, (uint8_t)(object->head + 1));
+}
+
+void* ring_buffer_read_internal(uint16_t object_size, uint8_t num_slots, ring_buffer_object_t* object) {
+    uint8_t tail = object->tail;
+    uint8_t head = LOAD(object->head);
+    if (head == tail) {
+        return NULL;
+    }
+    return object->buffer + object_size * (tail & (num_slots - 1));
+}
+
+void ring_buffer_end_read_internal(ring_buffer_object_t* object) {
+    STORE(object->tail, (uint8_t)(object->tail + 1));
+}
+
+uint8_t ring_buffer_size_internal(ring_buffer_object_t* object) {
+    return LOAD(object->head) - LOAD(object->tail);
+}
@@ -0,0 +1,96 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SERIAL_LINK_RING_BUFFERED_OBJECT_H
+#define SERIAL_LINK_RING_BUFFERED_OBJECT_H
+
+#include <stdint.h>
+
+// A lock free single producer, single consumer queue of objects
+// Unlike the triple buffered object, no values are dropped, instead the
+// writer gets a NULL pointer back when the queue is full.
+// The number of slots has to be a power of two, and at most 128, declare the
+// buffers with RING_BUFFER_OBJECT
+typedef struct {
+    uint8_t head;
+    uint8_t tail;
+    uint8_t buffer[] __attribute__((aligned(4)));
+}ring_buffer_object_t;
+
+void ring_buffer_init(ring_buffer_object_t* object);
+
+// Fails the build when the slot count can't be used, the head and tail are
+// wrapped by masking
+#define ring_buffer_valid_slots(slots) \
+    ((slots) > 0 && (slots) <= 128 && ((slots) & ((slots) - 1)) == 0)
+
+#ifdef __cplusplus
+#define ring_buffer_check_slots(slots) \
+    static_assert(ring_buffer_valid_slots(slots), \
+        "The number of ring buffer slots has to be a power of two, and at most 128")
+#else
+#define ring_buffer_check_slots(slots) \
+    _Static_assert(ring_buffer_valid_slots(slots), \
+        "The number of ring buffer slots has to be a power of two, and at most 128")
+#endif
+
+// Declares a ring buffer of slots objects of type, with the same layout as
+// ring_buffer_object_t, for example
+// static RING_BUFFER_OBJECT(key_event_t, 16) key_events;
+#define RING_BUFFER_OBJECT(type, slots) \
+    struct { \
+        ring_buffer_check_slots(slots); \
+        uint8_t head; \
+        uint8_t tail; \
+        type buffer[slots] __attribute__((aligned(4))); \
+    }
+
+// The slot count is checked here too, for the buffers that are declared by
+// hand, a negative array size fails the build
+#define ring_buffer_num_slots(object) \
+    (sizeof(char[ring_buffer_valid_slots(sizeof((object)->buffer) / sizeof((object)->buffer[0])) ? 1 : -1]) * \
+        (sizeof((object)->buffer) / sizeof((object)->buffer[0])))
+
+#define ring_buffer_begin_write(object) \
+    (typeof(*object.buffer[0])*)ring_buffer_begin_write_internal(sizeof(*object.buffer[0]), ring_buffer_num_slots(object), (ring_buffer_object_t*)object)
+
+#define ring_buffer_end_write(object) \
+    ring_buffer_end_write_internal((ring_buffer_object_t*)object)
+
+#define ring_buffer_read(object) \
+    (typeof(*object.buffer[0])*)ring_buffer_read_internal(sizeof(*object.buffer[0]), ring_buffer_num_slots(object), (ring_buffer_object_t*)object)
+
+#define ring_buffer_end_read(object) \
+    ring_buffer_end_read_internal((ring_buffer_object_t*)object)
+
+#define ring_buffer_size(object) \
+    ring_buffer_size_internal((ring_buffer_object_t*)object)
+
+void* ring_buffer_begin_write_internal(uint16_t object_size, uint8_t num_slots, ring_buffer_object_t* object);
+void ring_buffer_end_write_internal(ring_buffer_object_t* object);
+void* ring_buffer_read_internal(uint16_t object_size, uint8_t num_slots, ring_buffer_object_t* object);
+void ring_buffer_end_read_internal(ring_buffer_object_t* object);
+uint8_t ring_buffer_size_internal(ring_buffer_object_t* object);
+
+#endif
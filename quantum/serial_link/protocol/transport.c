@@ -25,21 +25,22 @@ SOFTWARE.
 #include "serial_link/protocol/transport.h"
 #include "serial_link/protocol/frame_router.h"
 #include "serial_link/protocol/triple_buffered_object.h"
+#include "serial_link/protocol/context.h"
 #include <string.h>
 
-#define MAX_REMOTE_OBJECTS 16
-static remote_object_t* remote_objects[MAX_REMOTE_OBJECTS];
-static uint32_t num_remote_objects = 0;
-
 void reinitialize_serial_link_transport(void) {
-    num_remote_objects = 0;
+    transport_state_t* state = &serial_link_context->transport;
+    state->num_remote_objects = 0;
+    state->objects_dirty = false;
 }
 
 void add_remote_objects(remote_object_t** _remote_objects, uint32_t _num_remote_objects) {
+    transport_state_t* state = &serial_link_context->transport;
     unsigned int i;
     for(i=0;i<_num_remote_objects;i++) {
         remote_object_t* obj = _remote_objects[i];
-        remote_objects[num_remote_objects++] = obj;
+        state->remote_objects[state->num_remote_objects++] = obj;
+        obj->dirty = 0;
         if (obj->object_type == MASTER_TO_ALL_SLAVES) {
             triple_buffer_object_t* tb = (triple_buffer_object_t*)obj->buffer;
             triple_buffer_init(tb);
@@ -58,6 +59,16 @@ void add_remote_objects(remote_object_t** _remote_objects, uint32_t _num_remote_
             triple_buffer_object_t* tb = (triple_buffer_object_t*)start;
             triple_buffer_init(tb);
         }
+        else if(obj->object_type == SLAVE_TO_MASTER_STREAM) {
+            uint8_t* start = obj->buffer;
+            ring_buffer_init((ring_buffer_object_t*)start);
+            start += LOCAL_STREAM_OBJECT_SIZE(obj->object_size, obj->num_slots);
+            unsigned int j;
+            for (j=0;j<NUM_SLAVES;j++) {
+                ring_buffer_init((ring_buffer_object_t*)start);
+                start += REMOTE_STREAM_OBJECT_SIZE(obj->object_size, obj->num_slots);
+            }
+        }
         else {
             uint8_t* start = obj->buffer;
             triple_buffer_object_t* tb = (triple_buffer_object_t*)start;
@@ -74,12 +85,25 @@ void add_remote_objects(remote_object_t** _remote_objects, uint32_t _num_remote_
 }
 
 void transport_recv_frame(uint8_t from, uint8_t* data, uint16_t size) {
+    transport_state_t* state = &serial_link_context->transport;
     uint8_t id = data[size-1];
-    if (id < num_remote_objects) {
-        remote_object_t* obj = remote_objects[id];
+    if (id < state->num_remote_objects) {
+        remote_object_t* obj = state->remote_objects[id];
         if (obj->object_size == size - 1) {
             uint8_t* start;
-            if (obj->object_type == MASTER_TO_ALL_SLAVES) {
+            if (obj->object_type == SLAVE_TO_MASTER_STREAM) {
+                start = obj->buffer + LOCAL_STREAM_OBJECT_SIZE(obj->object_size, obj->num_slots);
+                start += (from - 1) * REMOTE_STREAM_OBJECT_SIZE(obj->object_size, obj->num_slots);
+                ring_buffer_object_t* rb = (ring_buffer_object_t*)start;
+                void* ptr = ring_buffer_begin_write_internal(obj->object_size, obj->num_slots, rb);
+                // There's no flow control, so the value is lost if the reader is too slow
+                if (ptr) {
+                    memcpy(ptr, data, size - 1);
+                    ring_buffer_end_write_internal(rb);
+                }
+                return;
+            }
+            else if (obj->object_type == MASTER_TO_ALL_SLAVES) {
                 start = obj->buffer + LOCAL_OBJECT_SIZE(obj->object_size);
             }
             else if(obj->object_type == SLAVE_TO_MASTER) {
@@ -97,11 +121,43 @@ void transport_recv_frame(uint8_t from, uint8_t* data, uint16_t size) {
     }
 }
 
+void transport_local_object_written(remote_object_t* object, uint8_t local_index) {
+    serial_link_lock();
+    object->dirty |= 1 << local_index;
+    serial_link_context->transport.objects_dirty = true;
+    serial_link_unlock();
+    signal_data_written();
+}
+
 void update_transport(void) {
+    transport_state_t* state = &serial_link_context->transport;
+    serial_link_lock();
+    bool dirty = state->objects_dirty;
+    state->objects_dirty = false;
+    serial_link_unlock();
+    if (!dirty) {
+        return;
+    }
     unsigned int i;
-    for(i=0;i<num_remote_objects;i++) {
-        remote_object_t* obj = remote_objects[i];
-        if (obj->object_type == MASTER_TO_ALL_SLAVES || obj->object_type == SLAVE_TO_MASTER) {
+    for(i=0;i<state->num_remote_objects;i++) {
+        remote_object_t* obj = state->remote_objects[i];
+        serial_link_lock();
+        uint8_t dirty_buffers = obj->dirty;
+        obj->dirty = 0;
+        serial_link_unlock();
+        if (!dirty_buffers) {
+            continue;
+        }
+        if (obj->object_type == SLAVE_TO_MASTER_STREAM) {
+            ring_buffer_object_t* rb = (ring_buffer_object_t*)obj->buffer;
+            uint8_t* ptr;
+            while ((ptr = (uint8_t*)ring_buffer_read_internal(obj->object_size + LOCAL_OBJECT_EXTRA, obj->num_slots, rb))) {
+                ptr[obj->object_size] = i;
+                router_send_frame(0, ptr, obj->object_size + 1);
+                ring_buffer_end_read_internal(rb);
+            }
+        }
+        else if (obj->object_type == MASTER_TO_ALL_SLAVES || obj->object_type == SLAVE_TO_MASTER) {
             triple_buffer_object_t* tb = (triple_buffer_object_t*)obj->buffer;
             uint8_t* ptr = (uint8_t*)triple_buffer_read_internal(obj->object_size + LOCAL_OBJECT_EXTRA, tb);
             if (ptr) {
@@ -114,12 +170,14 @@ void update_transport(void) {
             uint8_t* start = obj->buffer;
             unsigned int j;
             for (j=0;j<NUM_SLAVES;j++) {
-                triple_buffer_object_t* tb = (triple_buffer_object_t*)start;
-                uint8_t* ptr = (uint8_t*)triple_buffer_read_internal(obj->object_size + LOCAL_OBJECT_EXTRA, tb);
-                if (ptr) {
-                    ptr[obj->object_size] = i;
-                    uint8_t dest = j + 1;
-                    router_send_frame(dest, ptr, obj->object_size + 1);
+                if (dirty_buffers & (1 << j)) {
+                    triple_buffer_object_t* tb = (triple_buffer_object_t*)start;
+                    uint8_t* ptr = (uint8_t*)triple_buffer_read_internal(obj->object_size + LOCAL_OBJECT_EXTRA, tb);
+                    if (ptr) {
+                        ptr[obj->object_size] = i;
+                        uint8_t dest = j + 1;
+                        router_send_frame(dest, ptr, obj->object_size + 1);
+                    }
                 }
                 start += LOCAL_OBJECT_SIZE(obj->object_size);
             }
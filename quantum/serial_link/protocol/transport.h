@@ -26,6 +26,7 @@ SOFTWARE.
 #define SERIAL_LINK_TRANSPORT_H
 
 #include "serial_link/protocol/triple_buffered_object.h"
+#include "serial_link/protocol/ring_buffered_object.h"
 #include "serial_link/system/serial_link.h"
 
 #define NUM_SLAVES 8
@@ -34,23 +35,47 @@ SOFTWARE.
 // master -> slave = 1 local(target all), 1 remote object
 // slave -> master = 1 local(target 0), multiple remote objects
 // master -> single slave (multiple local, target id), 1 remote object
+// slave -> master stream = 1 local ring buffer(target 0), multiple remote ring buffers
 typedef enum {
     MASTER_TO_ALL_SLAVES,
     MASTER_TO_SINGLE_SLAVE,
     SLAVE_TO_MASTER,
+    SLAVE_TO_MASTER_STREAM,
 } remote_object_type;
 
 typedef struct {
     remote_object_type object_type;
     uint16_t object_size;
-    uint8_t buffer[] __attribute__((aligned(4)));
+    // One bit per local buffer that has been written, but not yet sent
+    uint8_t dirty;
+    // Only used by the stream objects
+    uint8_t num_slots;
+    // Zero length, so that the object can be embedded in the helper struct
+    uint8_t buffer[0] __attribute__((aligned(4)));
 } remote_object_t;
 
+#define MAX_REMOTE_OBJECTS 16
+
+typedef struct {
+    remote_object_t* remote_objects[MAX_REMOTE_OBJECTS];
+    uint32_t num_remote_objects;
+    // Set when any of the objects have a dirty local buffer, so that
+    // update_transport doesn't have to look through all objects when idle
+    bool objects_dirty;
+} transport_state_t;
+
 #define REMOTE_OBJECT_SIZE(objectsize) \
     (sizeof(triple_buffer_object_t) + objectsize * 3)
 #define LOCAL_OBJECT_SIZE(objectsize) \
     (sizeof(triple_buffer_object_t) + (objectsize + LOCAL_OBJECT_EXTRA) * 3)
 
+void transport_local_object_written(remote_object_t* object, uint8_t local_index);
+
+#define REMOTE_STREAM_OBJECT_SIZE(objectsize, num_slots) \
+    (sizeof(ring_buffer_object_t) + objectsize * num_slots)
+#define LOCAL_STREAM_OBJECT_SIZE(objectsize, num_slots) \
+    (sizeof(ring_buffer_object_t) + (objectsize + LOCAL_OBJECT_EXTRA) * num_slots)
+
 #define REMOTE_OBJECT_HELPER(name, type, num_local, num_remote) \
 typedef struct { \
     remote_object_t object; \
@@ -76,7 +101,7 @@ typedef struct { \
         remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
         triple_buffer_object_t* tb = (triple_buffer_object_t*)obj->buffer; \
         triple_buffer_end_write_internal(tb); \
-        signal_data_written(); \
+        transport_local_object_written(obj, 0); \
     }\
     type* read_##name(void) { \
         remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
@@ -106,7 +131,7 @@ typedef struct { \
         start += slave * LOCAL_OBJECT_SIZE(obj->object_size); \
         triple_buffer_object_t* tb = (triple_buffer_object_t*)start; \
         triple_buffer_end_write_internal(tb); \
-        signal_data_written(); \
+        transport_local_object_written(obj, slave); \
     }\
     type* read_##name() { \
         remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
@@ -132,7 +157,7 @@ typedef struct { \
         remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
         triple_buffer_object_t* tb = (triple_buffer_object_t*)obj->buffer; \
         triple_buffer_end_write_internal(tb); \
-        signal_data_written(); \
+        transport_local_object_written(obj, 0); \
     }\
     type* read_##name(uint8_t slave) { \
         remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
@@ -142,6 +167,50 @@ typedef struct { \
         return (type*)triple_buffer_read_internal(obj->object_size, tb); \
     }
 
+// The stream objects queue every written value instead of just keeping the latest.
+// begin_write returns NULL when the local queue is full, and every successful
+// read has to be followed by end_read to release the slot
+#define SLAVE_TO_MASTER_STREAM_OBJECT(name, type, slots) \
+ring_buffer_check_slots(slots); \
+typedef struct { \
+    remote_object_t object; \
+    uint8_t buffer[ \
+        NUM_SLAVES * REMOTE_STREAM_OBJECT_SIZE(sizeof(type), slots) + \
+        LOCAL_STREAM_OBJECT_SIZE(sizeof(type), slots)]; \
+} remote_object_##name##_t; \
+    remote_object_##name##_t remote_object_##name = { \
+        .object = { \
+            .object_type = SLAVE_TO_MASTER_STREAM, \
+            .object_size = sizeof(type), \
+            .num_slots = slots, \
+        } \
+    }; \
+    type* begin_write_##name(void) { \
+        remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
+        ring_buffer_object_t* rb = (ring_buffer_object_t*)obj->buffer; \
+        return (type*)ring_buffer_begin_write_internal(sizeof(type) + LOCAL_OBJECT_EXTRA, slots, rb); \
+    }\
+    void end_write_##name(void) { \
+        remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
+        ring_buffer_object_t* rb = (ring_buffer_object_t*)obj->buffer; \
+        ring_buffer_end_write_internal(rb); \
+        transport_local_object_written(obj, 0); \
+    }\
+    type* read_##name(uint8_t slave) { \
+        remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
+        uint8_t* start = obj->buffer + LOCAL_STREAM_OBJECT_SIZE(obj->object_size, slots);\
+        start+=slave * REMOTE_STREAM_OBJECT_SIZE(obj->object_size, slots); \
+        ring_buffer_object_t* rb = (ring_buffer_object_t*)start; \
+        return (type*)ring_buffer_read_internal(obj->object_size, slots, rb); \
+    }\
+    void end_read_##name(uint8_t slave) { \
+        remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
+        uint8_t* start = obj->buffer + LOCAL_STREAM_OBJECT_SIZE(obj->object_size, slots);\
+        start+=slave * REMOTE_STREAM_OBJECT_SIZE(obj->object_size, slots); \
+        ring_buffer_object_t* rb = (ring_buffer_object_t*)start; \
+        ring_buffer_end_read_internal(rb); \
+    }
+
 #define REMOTE_OBJECT(name) (remote_object_t*)&remote_object_##name
 
 void add_remote_objects(remote_object_t** remote_objects, uint32_t num_remote_objects);
@@ -28,9 +28,14 @@ SOFTWARE.
 #include "serial_link/protocol/byte_stuffer.h"
 #include "serial_link/protocol/transport.h"
 #include "serial_link/protocol/frame_router.h"
+#include "serial_link/protocol/link_statistics.h"
+#include "serial_link/protocol/baud_rate.h"
+#include "serial_link/protocol/key_time.h"
 #include "matrix.h"
 #include <stdbool.h>
+#include <string.h>
 #include "print.h"
+#include "timer.h"
 #include "config.h"
 
 static event_source_t new_data_event;
@@ -52,7 +57,7 @@ host_driver_t serial_driver = {
 };
 
 // Define these in your Config.h file
-#ifndef SERIAL_LINK_BAUD
+#if !defined(SERIAL_LINK_BAUD) && !defined(SERIAL_LINK_BAUD_RATES)
 #error "Serial link baud is not set"
 #endif
 
@@ -60,9 +65,30 @@ host_driver_t serial_driver = {
 #error "Serial link thread priority not set"
 #endif
 
-static SerialConfig config = {
-    .sc_speed = SERIAL_LINK_BAUD
-};
+// Define SERIAL_LINK_BAUD_RATES in your config.h as a list of rates from the
+// safest to the fastest, for example { 281250, 562500, 1125000 }. All links
+// start at the first rate, and the master steps each link up as long as its
+// error rate stays low.
+#ifndef SERIAL_LINK_BAUD_RATES
+#define SERIAL_LINK_BAUD_RATES { SERIAL_LINK_BAUD }
+#endif
+
+// A link that hasn't received anything for this long falls back to the first rate
+#ifndef SERIAL_LINK_TIMEOUT
+#define SERIAL_LINK_TIMEOUT 2500
+#endif
+
+static const uint32_t baud_rates[] = SERIAL_LINK_BAUD_RATES;
+#define NUM_BAUD_RATES (sizeof(baud_rates) / sizeof(baud_rates[0]))
+
+static SerialConfig link_configs[NUM_LINKS];
+// Written by the main thread, and applied by the serial thread
+static volatile uint8_t requested_rate[NUM_LINKS];
+static uint8_t current_rate[NUM_LINKS];
+
+static SerialDriver* get_driver(uint8_t link) {
+    return link == DOWN_LINK ? &SD1 : &SD2;
+}
 
 //#define DEBUG_LINK_ERRORS
 
@@ -79,6 +105,40 @@ static uint32_t read_from_serial(SerialDriver* driver, uint8_t link) {
     return bytes_read;
 }
 
+static void count_errors(uint8_t link, eventflags_t flags) {
+    if (flags & SD_OVERRUN_ERROR) {
+        get_link_statistics(link)->overruns++;
+    }
+    if (flags & (SD_PARITY_ERROR | SD_FRAMING_ERROR | SD_NOISE_ERROR)) {
+        get_link_statistics(link)->line_errors++;
+    }
+}
+
+static bool is_output_empty(SerialDriver* driver) {
+    chSysLock();
+    bool empty = oqIsEmptyI(&driver->oqueue);
+    chSysUnlock();
+    return empty;
+}
+
+static void update_baud_rates(void) {
+    for (uint8_t i=0;i<NUM_LINKS;i++) {
+        uint8_t rate = requested_rate[i];
+        if (rate != current_rate[i]) {
+            SerialDriver* driver = get_driver(i);
+            // Let everything that is already queued go out with the old rate
+            while (!is_output_empty(driver)) {
+                chThdSleepMilliseconds(1);
+            }
+            chThdSleepMilliseconds(1);
+            sdStop(driver);
+            link_configs[i].sc_speed = baud_rates[rate];
+            sdStart(driver, &link_configs[i]);
+            current_rate[i] = rate;
+        }
+    }
+}
+
 static void print_error(char* str, eventflags_t flags, SerialDriver* driver) {
 #ifdef DEBUG_LINK_ERRORS
     if (flags & SD_PARITY_ERROR) {
@@ -140,10 +200,12 @@ static THD_FUNCTION(serialThread, arg) {
             eventmask_t mask = chEvtWaitAnyTimeout(ALL_EVENTS, MS2ST(1000));
             if (mask & EVENT_MASK(1)) {
                 flags1 = chEvtGetAndClearFlags(&sd1_listener);
+                count_errors(DOWN_LINK, flags1);
                 print_error("DOWNLINK", flags1, &SD1);
             }
             if (mask & EVENT_MASK(2)) {
                 flags2 = chEvtGetAndClearFlags(&sd2_listener);
+                count_errors(UP_LINK, flags2);
                 print_error("UPLINK", flags2, &SD2);
             }
         }
@@ -155,7 +217,10 @@ static THD_FUNCTION(serialThread, arg) {
         need_wait = true;
         need_wait &= read_from_serial(&SD2, UP_LINK) == 0;
         need_wait &= read_from_serial(&SD1, DOWN_LINK) == 0;
+        // Local writes wake up the thread through new_data_event, and this
+        // only sends the objects marked dirty, so it's cheap when idle
         update_transport();
+        update_baud_rates();
     }
 }
 
@@ -174,14 +239,61 @@ typedef struct {
     matrix_row_t rows[MATRIX_ROWS];
 } matrix_object_t;
 
+// A single key change detected by a slave, the time is already converted to
+// the master clock, so that the tapping decisions are made on the actual
+// press and release times, rather than the time when the master received them
+typedef struct {
+    uint8_t row;
+    uint8_t col;
+    bool pressed;
+    uint16_t time;
+} key_event_object_t;
+
 static matrix_object_t last_matrix = {};
+static key_time_state_t key_time;
+
+// Define this in your config.h to change how many key events a slave can queue
+#ifndef SERIAL_LINK_KEY_EVENT_SLOTS
+#define SERIAL_LINK_KEY_EVENT_SLOTS 16
+#endif
+
+// The full matrix snapshots are only used to resync the master after
+// the event stream has been idle for this long, for example if events were lost
+#ifndef SERIAL_LINK_RESYNC_TIME
+#define SERIAL_LINK_RESYNC_TIME 50
+#endif
 
 SLAVE_TO_MASTER_OBJECT(keyboard_matrix, matrix_object_t);
 MASTER_TO_ALL_SLAVES_OBJECT(serial_link_connected, bool);
+SLAVE_TO_MASTER_STREAM_OBJECT(key_events, key_event_object_t, SERIAL_LINK_KEY_EVENT_SLOTS);
+MASTER_TO_ALL_SLAVES_OBJECT(time_sync, uint16_t);
+MASTER_TO_SINGLE_SLAVE_OBJECT(ping, systime_t);
+SLAVE_TO_MASTER_OBJECT(pong, systime_t);
+
+// The accumulated frames and errors of a slave, the master uses the
+// difference between two reports
+typedef struct {
+    uint32_t frames[NUM_LINKS];
+    uint32_t errors[NUM_LINKS];
+} link_health_object_t;
+
+// The rate index for both links of a slave
+typedef struct {
+    uint8_t rates[NUM_LINKS];
+} link_rate_object_t;
+
+SLAVE_TO_MASTER_OBJECT(link_health, link_health_object_t);
+MASTER_TO_SINGLE_SLAVE_OBJECT(link_rate, link_rate_object_t);
 
 static remote_object_t* remote_objects[] = {
     REMOTE_OBJECT(serial_link_connected),
     REMOTE_OBJECT(keyboard_matrix),
+    REMOTE_OBJECT(key_events),
+    REMOTE_OBJECT(time_sync),
+    REMOTE_OBJECT(ping),
+    REMOTE_OBJECT(pong),
+    REMOTE_OBJECT(link_health),
+    REMOTE_OBJECT(link_rate),
 };
 
 void init_serial_link(void) {
@@ -189,8 +301,15 @@ void init_serial_link(void) {
     init_serial_link_hal();
     add_remote_objects(remote_objects, sizeof(remote_objects)/sizeof(remote_object_t*));
     init_byte_stuffer();
-    sdStart(&SD1, &config);
-    sdStart(&SD2, &config);
+    init_link_statistics();
+    key_time_init(&key_time, timer_read());
+    for (uint8_t i=0;i<NUM_LINKS;i++) {
+        link_configs[i].sc_speed = baud_rates[0];
+        requested_rate[i] = 0;
+        current_rate[i] = 0;
+    }
+    sdStart(&SD1, &link_configs[DOWN_LINK]);
+    sdStart(&SD2, &link_configs[UP_LINK]);
     chEvtObjectInit(&new_data_event);
     (void)chThdCreateStatic(serialThreadStack, sizeof(serialThreadStack),
                               SERIAL_LINK_THREAD_PRIORITY, serialThread, NULL);
@@ -198,11 +317,347 @@ void init_serial_link(void) {
 
 void matrix_set_remote(matrix_row_t* rows, uint8_t index);
 
+// The offset from the local clock to the master clock, as seen by the slave.
+// Every sample is the master time minus the transmission delay, so the largest
+// recent sample is the one with the least delay. Older samples are replaced
+// after a while, so that the estimate follows the clock drift.
+#define TIME_SYNC_MAX_SAMPLE_AGE 16
+static uint16_t master_time_offset = 0;
+static uint8_t master_time_offset_age = TIME_SYNC_MAX_SAMPLE_AGE;
+
+static void update_master_time_offset(uint16_t master_time) {
+    uint16_t sample = master_time - timer_read();
+    if (master_time_offset_age >= TIME_SYNC_MAX_SAMPLE_AGE ||
+            (int16_t)(sample - master_time_offset) > 0) {
+        master_time_offset = sample;
+        master_time_offset_age = 0;
+    }
+    else {
+        master_time_offset_age++;
+    }
+}
+
+static void send_key_events(matrix_object_t* matrix) {
+    uint16_t time = timer_read() + master_time_offset;
+    for (uint8_t row=0;row<MATRIX_ROWS;row++) {
+        matrix_row_t change = matrix->rows[row] ^ last_matrix.rows[row];
+        for (uint8_t col=0;col<MATRIX_COLS && change;col++) {
+            matrix_row_t mask = (matrix_row_t)1 << col;
+            if (change & mask) {
+                change &= ~mask;
+                key_event_object_t* e = begin_write_key_events();
+                // When the queue is full the master resyncs from the snapshot instead
+                if (e) {
+                    e->row = row;
+                    e->col = col;
+                    e->pressed = (matrix->rows[row] & mask) != 0;
+                    e->time = time;
+                    end_write_key_events();
+                }
+            }
+        }
+    }
+}
+
+static matrix_object_t remote_matrix[NUM_SLAVES] = {};
+static matrix_object_t remote_snapshot[NUM_SLAVES] = {};
+static uint16_t last_remote_event[NUM_SLAVES] = {};
+static uint16_t last_pending_key = 0;
+
+// Applies a key event of a slave to the matrix, and remembers its time for
+// keyboard_task. Returns false if the event has to wait for the next scan,
+// because the same key has changed already, or too many keys are waiting.
+static bool apply_key_event(uint8_t slave, key_event_object_t* e) {
+    if (e->row >= MATRIX_ROWS || e->col >= MATRIX_COLS) {
+        return true;
+    }
+    matrix_row_t mask = (matrix_row_t)1 << e->col;
+    matrix_row_t old_row = remote_matrix[slave].rows[e->row];
+    matrix_row_t new_row = e->pressed ? old_row | mask : old_row & ~mask;
+    if (new_row == old_row) {
+        return true;
+    }
+    matrix_row_t before[MATRIX_ROWS];
+    for (uint8_t row=0;row<MATRIX_ROWS;row++) {
+        before[row] = matrix_get_row(row);
+    }
+    remote_matrix[slave].rows[e->row] = new_row;
+    matrix_set_remote(remote_matrix[slave].rows, slave);
+    // The board decides where the remote rows go, so find the changed key
+    // from the full matrix, that's what keyboard_task will see too
+    for (uint8_t row=0;row<MATRIX_ROWS;row++) {
+        matrix_row_t change = before[row] ^ matrix_get_row(row);
+        if (change) {
+            uint8_t col = __builtin_ctz(change);
+            if (!key_time_add(&key_time, row, col, e->time)) {
+                remote_matrix[slave].rows[e->row] = old_row;
+                matrix_set_remote(remote_matrix[slave].rows, slave);
+                return false;
+            }
+            last_pending_key = timer_read();
+            break;
+        }
+    }
+    return true;
+}
+
+static void receive_key_events(void) {
+    // A key that keyboard_task never saw, because the matrix was resynced
+    // before it got to it, would otherwise keep its slot forever
+    if (timer_elapsed(last_pending_key) > SERIAL_LINK_RESYNC_TIME) {
+        key_time_clear(&key_time);
+    }
+    for (uint8_t i=0;i<NUM_SLAVES;i++) {
+        // All queued events are applied at once, every changed key keeps
+        // its own time until keyboard_task processes it
+        key_event_object_t* e;
+        while ((e = read_key_events(i))) {
+            if (!apply_key_event(i, e)) {
+                break;
+            }
+            end_read_key_events(i);
+            last_remote_event[i] = timer_read();
+        }
+        if (!e && timer_elapsed(last_remote_event[i]) > SERIAL_LINK_RESYNC_TIME) {
+            if (memcmp(&remote_matrix[i], &remote_snapshot[i], sizeof(matrix_object_t)) != 0) {
+                remote_matrix[i] = remote_snapshot[i];
+                matrix_set_remote(remote_matrix[i].rows, i);
+            }
+        }
+    }
+}
+
+uint16_t serial_link_get_key_time(uint8_t row, uint8_t col) {
+    return key_time_get(&key_time, row, col, timer_read());
+}
+
+// Define this in your config.h to change how often the round trip time is measured
+// Each ping goes to the next slave, so with many slaves it takes a while to measure them all
+#ifndef SERIAL_LINK_PING_INTERVAL
+#define SERIAL_LINK_PING_INTERVAL 250
+#endif
+
+// The slaves send their matrix at least every 5ms, so a slave that hasn't
+// sent one for a while is not connected
+static bool slave_connected[NUM_SLAVES];
+static uint16_t slave_matrix_time[NUM_SLAVES];
+
+static void read_slave_matrices(void) {
+    for (uint8_t i=0;i<NUM_SLAVES;i++) {
+        matrix_object_t* m = read_keyboard_matrix(i);
+        if (m) {
+            remote_snapshot[i] = *m;
+            slave_matrix_time[i] = timer_read();
+            slave_connected[i] = true;
+        }
+        else if (slave_connected[i] && timer_elapsed(slave_matrix_time[i]) > SERIAL_LINK_TIMEOUT) {
+            slave_connected[i] = false;
+        }
+    }
+}
+
+static void update_ping(void) {
+    static uint8_t ping_slave = 0;
+    static uint16_t last_ping = 0;
+    if (is_master) {
+        if (timer_elapsed(last_ping) > SERIAL_LINK_PING_INTERVAL) {
+            last_ping = timer_read();
+            // Ping the next connected slave
+            for (uint8_t i=0;i<NUM_SLAVES;i++) {
+                uint8_t slave = ping_slave;
+                ping_slave = (ping_slave + 1) % NUM_SLAVES;
+                if (slave_connected[slave]) {
+                    *begin_write_ping(slave) = chVTGetSystemTimeX();
+                    end_write_ping(slave);
+                    break;
+                }
+            }
+        }
+        for (uint8_t i=0;i<NUM_SLAVES;i++) {
+            systime_t* pong = read_pong(i);
+            if (pong && slave_connected[i]) {
+                systime_t round_trip = chVTGetSystemTimeX() - *pong;
+                link_statistics_add_round_trip(i, ST2US(round_trip));
+            }
+        }
+    }
+    else {
+        // Just echo back the time, the master calculates the time from its own clock
+        systime_t* ping = read_ping();
+        if (ping) {
+            *begin_write_pong() = *ping;
+            end_write_pong();
+        }
+    }
+}
+
+static void request_rate(uint8_t link, uint8_t rate) {
+    if (requested_rate[link] != rate) {
+        requested_rate[link] = rate;
+        // Wake up the serial thread so that it applies the rate
+        signal_data_written();
+    }
+}
+
+static uint32_t link_errors(link_statistics_t* s) {
+    return s->crc_failures + s->cobs_resets + s->overruns + s->line_errors;
+}
+
+static void check_link_timeouts(void) {
+    static uint32_t last_frames[NUM_LINKS];
+    static uint16_t last_frame_time[NUM_LINKS];
+    for (uint8_t i=0;i<NUM_LINKS;i++) {
+        uint32_t frames = get_link_statistics(i)->frames_received;
+        if (frames != last_frames[i]) {
+            last_frames[i] = frames;
+            last_frame_time[i] = timer_read();
+        }
+        else if (timer_elapsed(last_frame_time[i]) > SERIAL_LINK_TIMEOUT) {
+            // The other end does the same, so they meet at the first rate
+            request_rate(i, 0);
+        }
+    }
+}
+
+// Link i is between node i and node i + 1, where the master is node 0 and
+// slave i is node i + 1. Both ends of the link report their errors.
+static baud_rate_state_t link_baud_rates[NUM_SLAVES];
+static link_health_object_t slave_health[NUM_SLAVES];
+static uint16_t slave_health_time[NUM_SLAVES];
+static bool slave_alive[NUM_SLAVES];
+static uint32_t last_link_frames[NUM_SLAVES];
+static uint32_t last_link_errors[NUM_SLAVES];
+
+static void read_slave_health(void) {
+    for (uint8_t i=0;i<NUM_SLAVES;i++) {
+        link_health_object_t* health = read_link_health(i);
+        if (health) {
+            slave_health[i] = *health;
+            slave_health_time[i] = timer_read();
+            if (!slave_alive[i]) {
+                slave_alive[i] = true;
+                baud_rate_init(&link_baud_rates[i], NUM_BAUD_RATES);
+                last_link_frames[i] = 0;
+                last_link_errors[i] = 0;
+            }
+        }
+        else if (slave_alive[i] && timer_elapsed(slave_health_time[i]) > SERIAL_LINK_TIMEOUT) {
+            slave_alive[i] = false;
+            baud_rate_link_lost(&link_baud_rates[i]);
+        }
+    }
+}
+
+static void negotiate_link_rates(void) {
+    for (uint8_t i=0;i<NUM_SLAVES;i++) {
+        if (!slave_alive[i]) {
+            continue;
+        }
+        uint32_t frames = slave_health[i].frames[UP_LINK];
+        uint32_t errors = slave_health[i].errors[UP_LINK];
+        if (i == 0) {
+            frames += get_link_statistics(DOWN_LINK)->frames_received;
+            errors += link_errors(get_link_statistics(DOWN_LINK));
+        }
+        else {
+            frames += slave_health[i - 1].frames[DOWN_LINK];
+            errors += slave_health[i - 1].errors[DOWN_LINK];
+        }
+        baud_rate_update(&link_baud_rates[i],
+            frames - last_link_frames[i], errors - last_link_errors[i]);
+        last_link_frames[i] = frames;
+        last_link_errors[i] = errors;
+    }
+    for (uint8_t i=0;i<NUM_SLAVES;i++) {
+        if (slave_alive[i]) {
+            link_rate_object_t* r = begin_write_link_rate(i);
+            r->rates[UP_LINK] = link_baud_rates[i].rate_index;
+            bool has_next = i + 1 < NUM_SLAVES && slave_alive[i + 1];
+            r->rates[DOWN_LINK] = has_next ? link_baud_rates[i + 1].rate_index : 0;
+            end_write_link_rate(i);
+        }
+    }
+    request_rate(DOWN_LINK, slave_alive[0] ? link_baud_rates[0].rate_index : 0);
+}
+
+static void update_link_rates(bool new_period) {
+    if (NUM_BAUD_RATES == 1) {
+        return;
+    }
+    check_link_timeouts();
+    if (is_master) {
+        read_slave_health();
+        if (new_period) {
+            negotiate_link_rates();
+        }
+    }
+    else {
+        link_rate_object_t* r = read_link_rate();
+        if (r) {
+            request_rate(UP_LINK, r->rates[UP_LINK]);
+            request_rate(DOWN_LINK, r->rates[DOWN_LINK]);
+        }
+        if (new_period) {
+            link_health_object_t* health = begin_write_link_health();
+            for (uint8_t i=0;i<NUM_LINKS;i++) {
+                health->frames[i] = get_link_statistics(i)->frames_received;
+                health->errors[i] = link_errors(get_link_statistics(i));
+            }
+            end_write_link_health();
+        }
+    }
+}
+
+void serial_link_print_statistics(void) {
+    const char* names[NUM_LINKS] = { "UPLINK", "DOWNLINK" };
+    for (uint8_t i=0;i<NUM_LINKS;i++) {
+        link_statistics_t* s = get_link_statistics(i);
+        xprintf("%s frames sent %lu received %lu\n", names[i], s->frames_sent, s->frames_received);
+        xprintf("%s crc failures %lu cobs resets %lu overruns %lu line errors %lu\n", names[i],
+            s->crc_failures, s->cobs_resets, s->overruns, s->line_errors);
+        xprintf("%s baud %lu\n", names[i], baud_rates[current_rate[i]]);
+        xprintf("%s bytes/s sent %lu received %lu\n", names[i],
+            s->bytes_sent_per_second, s->bytes_received_per_second);
+    }
+    for (uint8_t i=0;i<NUM_SLAVES;i++) {
+        round_trip_statistics_t* r = get_round_trip_statistics(i);
+        if (r->num_samples) {
+            xprintf("SLAVE %d round trip us last %lu average %lu max %lu\n", i,
+                r->last_us, r->average_us, r->max_us);
+        }
+    }
+}
+
+// Define SERIAL_LINK_STATISTICS_INTERVAL in your config.h to print the
+// statistics to the console periodically
+static void update_statistics(void) {
+    static uint16_t last_rate_update = 0;
+    uint16_t elapsed = timer_elapsed(last_rate_update);
+    bool new_period = elapsed >= 1000;
+    if (new_period) {
+        last_rate_update = timer_read();
+        link_statistics_update_rates(elapsed);
+    }
+    update_link_rates(new_period);
+#ifdef SERIAL_LINK_STATISTICS_INTERVAL
+    static uint16_t last_print = 0;
+    if (timer_elapsed(last_print) >= SERIAL_LINK_STATISTICS_INTERVAL) {
+        last_print = timer_read();
+        serial_link_print_statistics();
+    }
+#endif
+}
+
 void serial_link_update(void) {
     if (read_serial_link_connected()) {
         serial_link_connected = true;
     }
 
+    uint16_t* master_time = read_time_sync();
+    if (master_time) {
+        update_master_time_offset(*master_time);
+    }
+
     matrix_object_t matrix;
     bool changed = false;
     for(uint8_t i=0;i<MATRIX_ROWS;i++) {
@@ -210,6 +665,10 @@ void serial_link_update(void) {
         changed |= matrix.rows[i] != last_matrix.rows[i];
     }
 
+    if (changed && !is_master) {
+        send_key_events(&matrix);
+    }
+
     systime_t current_time = chVTGetSystemTimeX();
     systime_t delta = current_time - last_update;
     if (changed || delta > US2ST(5000)) {
@@ -222,12 +681,14 @@ void serial_link_update(void) {
         end_write_keyboard_matrix();
         *begin_write_serial_link_connected() = true;
         end_write_serial_link_connected();
+        *begin_write_time_sync() = timer_read();
+        end_write_time_sync();
     }
 
-    matrix_object_t* m = read_keyboard_matrix(0);
-    if (m) {
-        matrix_set_remote(m->rows, 0);
-    }
+    read_slave_matrices();
+    receive_key_events();
+    update_ping();
+    update_statistics();
 }
 
 void signal_data_written(void) {
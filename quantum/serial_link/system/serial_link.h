@@ -34,6 +34,12 @@ bool is_serial_link_connected(void);
 bool is_serial_link_master(void);
 host_driver_t* get_serial_link_driver(void);
 void serial_link_update(void);
+// Returns the time when a key changed on a slave, or the current time for local
+// keys. The key times never go back, a slave key that changed before the last
+// key gets the time of that key. Ticks use the current time and don't call this.
+uint16_t serial_link_get_key_time(uint8_t row, uint8_t col);
+// Prints the link statistics and round trip times to the console
+void serial_link_print_statistics(void);
 
 #if defined(PROTOCOL_CHIBIOS)
 #include "ch.h"
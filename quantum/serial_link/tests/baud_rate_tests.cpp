@@ -0,0 +1,118 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "gtest/gtest.h"
+extern "C" {
+#include "serial_link/protocol/baud_rate.h"
+}
+
+class BaudRate : public testing::Test {
+public:
+    BaudRate() {
+        baud_rate_init(&state, 4);
+    }
+
+    void run_good_periods(unsigned int num) {
+        for (unsigned int i=0;i<num;i++) {
+            baud_rate_update(&state, 1000, 0);
+        }
+    }
+
+    baud_rate_state_t state;
+};
+
+TEST_F(BaudRate, starts_at_the_slowest_rate) {
+    EXPECT_EQ(state.rate_index, 0);
+}
+
+TEST_F(BaudRate, steps_up_after_enough_good_periods) {
+    run_good_periods(SERIAL_LINK_BAUD_STEP_UP_PERIODS - 1);
+    EXPECT_EQ(state.rate_index, 0);
+    EXPECT_TRUE(baud_rate_update(&state, 1000, 0));
+    EXPECT_EQ(state.rate_index, 1);
+}
+
+TEST_F(BaudRate, ignores_the_period_after_a_change) {
+    run_good_periods(SERIAL_LINK_BAUD_STEP_UP_PERIODS);
+    EXPECT_EQ(state.rate_index, 1);
+    EXPECT_FALSE(baud_rate_update(&state, 10, 1000));
+    EXPECT_EQ(state.rate_index, 1);
+}
+
+TEST_F(BaudRate, does_not_step_up_when_idle) {
+    for (int i=0;i<SERIAL_LINK_BAUD_STEP_UP_PERIODS * 2;i++) {
+        EXPECT_FALSE(baud_rate_update(&state, 0, 0));
+    }
+    EXPECT_EQ(state.rate_index, 0);
+}
+
+TEST_F(BaudRate, stops_at_the_fastest_rate) {
+    run_good_periods((SERIAL_LINK_BAUD_STEP_UP_PERIODS + 1) * 10);
+    EXPECT_EQ(state.rate_index, 3);
+}
+
+TEST_F(BaudRate, tolerates_a_low_error_rate) {
+    run_good_periods((SERIAL_LINK_BAUD_STEP_UP_PERIODS + 1) * 2);
+    EXPECT_EQ(state.rate_index, 2);
+    EXPECT_FALSE(baud_rate_update(&state, 1000, SERIAL_LINK_BAUD_ERROR_PERMILLE));
+    EXPECT_EQ(state.rate_index, 2);
+}
+
+TEST_F(BaudRate, steps_down_when_errors_spike) {
+    run_good_periods((SERIAL_LINK_BAUD_STEP_UP_PERIODS + 1) * 2);
+    EXPECT_EQ(state.rate_index, 2);
+    EXPECT_TRUE(baud_rate_update(&state, 1000, SERIAL_LINK_BAUD_ERROR_PERMILLE + 1));
+    EXPECT_EQ(state.rate_index, 1);
+}
+
+TEST_F(BaudRate, steps_down_when_there_are_only_errors) {
+    run_good_periods(SERIAL_LINK_BAUD_STEP_UP_PERIODS + 1);
+    EXPECT_TRUE(baud_rate_update(&state, 0, 1));
+    EXPECT_EQ(state.rate_index, 0);
+}
+
+TEST_F(BaudRate, retries_failed_rate_only_after_the_retry_time) {
+    run_good_periods((SERIAL_LINK_BAUD_STEP_UP_PERIODS + 1) * 2);
+    baud_rate_update(&state, 1000, 1000);
+    EXPECT_EQ(state.rate_index, 1);
+    run_good_periods(SERIAL_LINK_BAUD_RETRY_PERIODS - 1);
+    EXPECT_EQ(state.rate_index, 1);
+    run_good_periods(SERIAL_LINK_BAUD_STEP_UP_PERIODS + 1);
+    EXPECT_EQ(state.rate_index, 2);
+}
+
+TEST_F(BaudRate, falls_back_to_the_slowest_rate_when_the_link_is_lost) {
+    run_good_periods((SERIAL_LINK_BAUD_STEP_UP_PERIODS + 1) * 3);
+    EXPECT_EQ(state.rate_index, 3);
+    EXPECT_TRUE(baud_rate_link_lost(&state));
+    EXPECT_EQ(state.rate_index, 0);
+    EXPECT_FALSE(baud_rate_link_lost(&state));
+}
+
+TEST_F(BaudRate, never_changes_with_a_single_rate) {
+    baud_rate_init(&state, 1);
+    run_good_periods(SERIAL_LINK_BAUD_RETRY_PERIODS * 2);
+    EXPECT_EQ(state.rate_index, 0);
+    EXPECT_FALSE(baud_rate_update(&state, 1000, 1000));
+}
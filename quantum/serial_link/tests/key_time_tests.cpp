@@ -0,0 +1,118 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "gtest/gtest.h"
+extern "C" {
+#include "serial_link/protocol/key_time.h"
+}
+
+class KeyTime : public testing::Test {
+public:
+    KeyTime() {
+        key_time_init(&state, 1000);
+    }
+
+    key_time_state_t state;
+};
+
+TEST_F(KeyTime, keeps_times_that_are_in_order) {
+    EXPECT_EQ(key_time_order(&state, 1000), 1000);
+    EXPECT_EQ(key_time_order(&state, 1010), 1010);
+    EXPECT_EQ(key_time_order(&state, 1200), 1200);
+}
+
+TEST_F(KeyTime, delays_an_event_that_is_older_than_the_last_one) {
+    EXPECT_EQ(key_time_order(&state, 1100), 1100);
+    // A slave key that was released before the master key was pressed
+    EXPECT_EQ(key_time_order(&state, 1090), 1100);
+    EXPECT_EQ(key_time_order(&state, 1105), 1105);
+}
+
+TEST_F(KeyTime, an_older_event_does_not_move_the_last_time_back) {
+    EXPECT_EQ(key_time_order(&state, 1100), 1100);
+    EXPECT_EQ(key_time_order(&state, 1050), 1100);
+    EXPECT_EQ(key_time_order(&state, 1080), 1100);
+}
+
+TEST_F(KeyTime, a_local_key_gets_the_current_time) {
+    EXPECT_EQ(key_time_get(&state, 1, 2, 1100), 1100);
+}
+
+TEST_F(KeyTime, a_slave_key_gets_the_time_it_was_added_with) {
+    EXPECT_TRUE(key_time_add(&state, 3, 4, 1050));
+    EXPECT_TRUE(key_time_is_pending(&state, 3, 4));
+    EXPECT_EQ(key_time_get(&state, 3, 4, 1100), 1050);
+    EXPECT_FALSE(key_time_is_pending(&state, 3, 4));
+    // The next change of the same key is a local one again
+    EXPECT_EQ(key_time_get(&state, 3, 4, 1110), 1110);
+}
+
+TEST_F(KeyTime, an_older_slave_key_keeps_its_time_after_a_tick) {
+    EXPECT_EQ(key_time_get(&state, 3, 4, 1000), 1000);
+    EXPECT_TRUE(key_time_add(&state, 3, 4, 1090));
+    // keyboard_task runs the ticks with the current time, without asking
+    // for a key time, so the 1150 tick doesn't move the last time
+    EXPECT_EQ(key_time_get(&state, 3, 4, 1150), 1090);
+}
+
+TEST_F(KeyTime, the_tapping_term_is_measured_from_the_slave_times) {
+    EXPECT_TRUE(key_time_add(&state, 3, 4, 1100));
+    uint16_t press = key_time_get(&state, 3, 4, 1105);
+    // A tick at 1150, and then the release that happened at 1140
+    EXPECT_TRUE(key_time_add(&state, 3, 4, 1140));
+    uint16_t release = key_time_get(&state, 3, 4, 1155);
+    EXPECT_EQ((uint16_t)(release - press), 40);
+}
+
+TEST_F(KeyTime, several_slave_keys_keep_their_own_times) {
+    EXPECT_TRUE(key_time_add(&state, 0, 1, 1010));
+    EXPECT_TRUE(key_time_add(&state, 2, 3, 1020));
+    EXPECT_TRUE(key_time_add(&state, 4, 5, 1030));
+    EXPECT_EQ(key_time_get(&state, 0, 1, 1100), 1010);
+    EXPECT_EQ(key_time_get(&state, 2, 3, 1100), 1020);
+    EXPECT_EQ(key_time_get(&state, 4, 5, 1100), 1030);
+}
+
+TEST_F(KeyTime, a_key_can_only_be_pending_once) {
+    EXPECT_TRUE(key_time_add(&state, 0, 1, 1010));
+    EXPECT_FALSE(key_time_add(&state, 0, 1, 1020));
+    EXPECT_EQ(key_time_get(&state, 0, 1, 1100), 1010);
+}
+
+TEST_F(KeyTime, no_more_keys_are_added_when_full) {
+    for (uint8_t i=0;i<KEY_TIME_PENDING_KEYS;i++) {
+        EXPECT_TRUE(key_time_add(&state, i, 0, 1000 + i));
+    }
+    EXPECT_FALSE(key_time_add(&state, KEY_TIME_PENDING_KEYS, 0, 1100));
+    key_time_clear(&state);
+    EXPECT_FALSE(key_time_is_pending(&state, 0, 0));
+    EXPECT_TRUE(key_time_add(&state, KEY_TIME_PENDING_KEYS, 0, 1100));
+}
+
+TEST_F(KeyTime, handles_the_timer_wrapping_around) {
+    key_time_init(&state, 0xFFF0);
+    EXPECT_EQ(key_time_order(&state, 0xFFFA), 0xFFFA);
+    EXPECT_EQ(key_time_order(&state, 0x0005), 0x0005);
+    EXPECT_EQ(key_time_order(&state, 0xFFFC), 0x0005);
+}
@@ -0,0 +1,138 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "gtest/gtest.h"
+#include <vector>
+extern "C" {
+#include "serial_link/protocol/link_statistics.h"
+#include "serial_link/protocol/byte_stuffer.h"
+#include "serial_link/protocol/frame_validator.h"
+#include "serial_link/protocol/physical.h"
+}
+
+class LinkStatistics : public testing::Test {
+public:
+    LinkStatistics() {
+        Instance = this;
+        init_byte_stuffer();
+        init_link_statistics();
+    }
+
+    ~LinkStatistics() {
+        Instance = nullptr;
+    }
+
+    void receive_sent_data(uint8_t link) {
+        for (uint8_t d : sent_data) {
+            byte_stuffer_recv_byte(link, d);
+        }
+    }
+
+    std::vector<uint8_t> sent_data;
+    uint32_t num_routed = 0;
+
+    static LinkStatistics* Instance;
+};
+
+LinkStatistics* LinkStatistics::Instance = nullptr;
+
+extern "C" {
+void send_data(uint8_t link, const uint8_t* data, uint16_t size) {
+    std::copy(data, data + size, std::back_inserter(LinkStatistics::Instance->sent_data));
+}
+
+void route_incoming_frame(uint8_t link, uint8_t* data, uint16_t size) {
+    LinkStatistics::Instance->num_routed++;
+}
+}
+
+TEST_F(LinkStatistics, starts_with_zero_counters) {
+    link_statistics_t* s = get_link_statistics(0);
+    EXPECT_EQ(s->frames_sent, 0);
+    EXPECT_EQ(s->frames_received, 0);
+    EXPECT_EQ(s->crc_failures, 0);
+    EXPECT_EQ(s->cobs_resets, 0);
+    EXPECT_EQ(s->bytes_sent, 0);
+    EXPECT_EQ(s->bytes_received, 0);
+}
+
+TEST_F(LinkStatistics, counts_sent_and_received_frames) {
+    uint8_t data[] = {1, 2, 3, 0, 0, 0, 0};
+    validator_send_frame(1, data, 3);
+    EXPECT_EQ(get_link_statistics(1)->frames_sent, 1);
+    EXPECT_EQ(get_link_statistics(1)->bytes_sent, sent_data.size());
+    receive_sent_data(0);
+    EXPECT_EQ(num_routed, 1);
+    EXPECT_EQ(get_link_statistics(0)->frames_received, 1);
+    EXPECT_EQ(get_link_statistics(0)->bytes_received, sent_data.size());
+    EXPECT_EQ(get_link_statistics(0)->crc_failures, 0);
+    EXPECT_EQ(get_link_statistics(1)->frames_received, 0);
+}
+
+TEST_F(LinkStatistics, counts_crc_failures) {
+    uint8_t data[] = {1, 2, 3, 0, 0, 0, 0};
+    validator_send_frame(0, data, 3);
+    sent_data[2] ^= 0x10;
+    receive_sent_data(0);
+    EXPECT_EQ(num_routed, 0);
+    EXPECT_EQ(get_link_statistics(0)->frames_received, 0);
+    EXPECT_EQ(get_link_statistics(0)->crc_failures, 1);
+}
+
+TEST_F(LinkStatistics, counts_cobs_resets) {
+    byte_stuffer_recv_byte(1, 3);
+    byte_stuffer_recv_byte(1, 1);
+    byte_stuffer_recv_byte(1, 0);
+    EXPECT_EQ(get_link_statistics(1)->cobs_resets, 1);
+    EXPECT_EQ(get_link_statistics(1)->bytes_received, 3);
+}
+
+TEST_F(LinkStatistics, calculates_byte_rates) {
+    get_link_statistics(0)->bytes_sent = 500;
+    get_link_statistics(0)->bytes_received = 1000;
+    link_statistics_update_rates(500);
+    EXPECT_EQ(get_link_statistics(0)->bytes_sent_per_second, 1000);
+    EXPECT_EQ(get_link_statistics(0)->bytes_received_per_second, 2000);
+    get_link_statistics(0)->bytes_sent = 600;
+    link_statistics_update_rates(1000);
+    EXPECT_EQ(get_link_statistics(0)->bytes_sent_per_second, 100);
+    EXPECT_EQ(get_link_statistics(0)->bytes_received_per_second, 0);
+}
+
+TEST_F(LinkStatistics, tracks_round_trip_times) {
+    link_statistics_add_round_trip(2, 800);
+    round_trip_statistics_t* r = get_round_trip_statistics(2);
+    EXPECT_EQ(r->num_samples, 1);
+    EXPECT_EQ(r->last_us, 800);
+    EXPECT_EQ(r->average_us, 800);
+    EXPECT_EQ(r->max_us, 800);
+    link_statistics_add_round_trip(2, 1600);
+    EXPECT_EQ(r->num_samples, 2);
+    EXPECT_EQ(r->last_us, 1600);
+    EXPECT_EQ(r->average_us, 900);
+    EXPECT_EQ(r->max_us, 1600);
+    link_statistics_add_round_trip(2, 400);
+    EXPECT_EQ(r->max_us, 1600);
+    EXPECT_EQ(get_round_trip_statistics(1)->num_samples, 0);
+}
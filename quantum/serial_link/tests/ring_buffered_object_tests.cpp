@@ -0,0 +1,137 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "gtest/gtest.h"
+#include <thread>
+extern "C" {
+#include "serial_link/protocol/ring_buffered_object.h"
+}
+
+RING_BUFFER_OBJECT(uint32_t, 4) test_object;
+
+class RingBufferedObject : public testing::Test {
+public:
+    RingBufferedObject() {
+        ring_buffer_init((ring_buffer_object_t*)&test_object);
+    }
+};
+
+TEST_F(RingBufferedObject, writes_and_reads_object) {
+    *ring_buffer_begin_write(&test_object) = 0x3456ABCC;
+    ring_buffer_end_write(&test_object);
+    EXPECT_EQ(*ring_buffer_read(&test_object), 0x3456ABCC);
+}
+
+TEST_F(RingBufferedObject, does_not_read_empty) {
+    EXPECT_EQ(ring_buffer_read(&test_object), nullptr);
+}
+
+TEST_F(RingBufferedObject, writes_twice_and_reads_both_objects) {
+    *ring_buffer_begin_write(&test_object) = 0x3456ABCC;
+    ring_buffer_end_write(&test_object);
+    *ring_buffer_begin_write(&test_object) = 0x44778899;
+    ring_buffer_end_write(&test_object);
+    EXPECT_EQ(*ring_buffer_read(&test_object), 0x3456ABCC);
+    ring_buffer_end_read(&test_object);
+    EXPECT_EQ(*ring_buffer_read(&test_object), 0x44778899);
+    ring_buffer_end_read(&test_object);
+    EXPECT_EQ(ring_buffer_read(&test_object), nullptr);
+}
+
+TEST_F(RingBufferedObject, reads_same_object_until_end_read) {
+    *ring_buffer_begin_write(&test_object) = 1;
+    ring_buffer_end_write(&test_object);
+    EXPECT_EQ(*ring_buffer_read(&test_object), 1);
+    EXPECT_EQ(*ring_buffer_read(&test_object), 1);
+    ring_buffer_end_read(&test_object);
+    EXPECT_EQ(ring_buffer_read(&test_object), nullptr);
+}
+
+TEST_F(RingBufferedObject, performs_another_write_in_the_middle_of_read) {
+    *ring_buffer_begin_write(&test_object) = 1;
+    ring_buffer_end_write(&test_object);
+    uint32_t* read = ring_buffer_read(&test_object);
+    *ring_buffer_begin_write(&test_object) = 2;
+    ring_buffer_end_write(&test_object);
+    EXPECT_EQ(*read, 1);
+    ring_buffer_end_read(&test_object);
+    EXPECT_EQ(*ring_buffer_read(&test_object), 2);
+    ring_buffer_end_read(&test_object);
+    EXPECT_EQ(ring_buffer_read(&test_object), nullptr);
+}
+
+TEST_F(RingBufferedObject, does_not_write_when_full) {
+    for (uint32_t i=0;i<4;i++) {
+        *ring_buffer_begin_write(&test_object) = i;
+        ring_buffer_end_write(&test_object);
+    }
+    EXPECT_EQ(ring_buffer_size(&test_object), 4);
+    EXPECT_EQ(ring_buffer_begin_write(&test_object), nullptr);
+    EXPECT_EQ(*ring_buffer_read(&test_object), 0);
+    ring_buffer_end_read(&test_object);
+    EXPECT_NE(ring_buffer_begin_write(&test_object), nullptr);
+}
+
+TEST_F(RingBufferedObject, wraps_around) {
+    for (uint32_t i=0;i<1000;i++) {
+        *ring_buffer_begin_write(&test_object) = i;
+        ring_buffer_end_write(&test_object);
+        EXPECT_EQ(*ring_buffer_read(&test_object), i);
+        ring_buffer_end_read(&test_object);
+    }
+    EXPECT_EQ(ring_buffer_size(&test_object), 0);
+}
+
+TEST_F(RingBufferedObject, reads_all_values_written_from_another_thread) {
+    const uint32_t num_values = 200000;
+    std::thread producer([num_values]() {
+        for (uint32_t i=0;i<num_values;) {
+            uint32_t* write = ring_buffer_begin_write(&test_object);
+            if (write) {
+                *write = i;
+                ring_buffer_end_write(&test_object);
+                i++;
+            }
+            else {
+                std::this_thread::yield();
+            }
+        }
+    });
+    uint32_t expected = 0;
+    bool in_order = true;
+    while (expected < num_values) {
+        uint32_t* read = ring_buffer_read(&test_object);
+        if (read) {
+            in_order &= *read == expected;
+            ring_buffer_end_read(&test_object);
+            expected++;
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    EXPECT_TRUE(in_order);
+    EXPECT_EQ(ring_buffer_read(&test_object), nullptr);
+}
@@ -1,22 +1,61 @@
 serial_link_byte_stuffer_SRC :=\
 	$(SERIAL_PATH)/tests/byte_stuffer_tests.cpp \
-	$(SERIAL_PATH)/protocol/byte_stuffer.c
+	$(SERIAL_PATH)/protocol/byte_stuffer.c \
+	$(SERIAL_PATH)/protocol/link_statistics.c \
+	$(SERIAL_PATH)/protocol/context.c
 
 serial_link_frame_validator_SRC := \
 	$(SERIAL_PATH)/tests/frame_validator_tests.cpp \
-	$(SERIAL_PATH)/protocol/frame_validator.c 
+	$(SERIAL_PATH)/protocol/frame_validator.c \
+	$(SERIAL_PATH)/protocol/link_statistics.c \
+	$(SERIAL_PATH)/protocol/context.c
 
 serial_link_frame_router_SRC := \
 	$(SERIAL_PATH)/tests/frame_router_tests.cpp \
 	$(SERIAL_PATH)/protocol/byte_stuffer.c \
 	$(SERIAL_PATH)/protocol/frame_validator.c \
-	$(SERIAL_PATH)/protocol/frame_router.c
+	$(SERIAL_PATH)/protocol/frame_router.c \
+	$(SERIAL_PATH)/protocol/link_statistics.c \
+	$(SERIAL_PATH)/protocol/context.c
+
+serial_link_link_statistics_SRC := \
+	$(SERIAL_PATH)/tests/link_statistics_tests.cpp \
+	$(SERIAL_PATH)/protocol/byte_stuffer.c \
+	$(SERIAL_PATH)/protocol/frame_validator.c \
+	$(SERIAL_PATH)/protocol/link_statistics.c \
+	$(SERIAL_PATH)/protocol/context.c
+
+serial_link_baud_rate_SRC := \
+	$(SERIAL_PATH)/tests/baud_rate_tests.cpp \
+	$(SERIAL_PATH)/protocol/baud_rate.c
+
+serial_link_key_time_SRC := \
+	$(SERIAL_PATH)/tests/key_time_tests.cpp \
+	$(SERIAL_PATH)/protocol/key_time.c
 
 serial_link_triple_buffered_object_SRC := \
 	$(SERIAL_PATH)/tests/triple_buffered_object_tests.cpp \
 	$(SERIAL_PATH)/protocol/triple_buffered_object.c 
 
+serial_link_ring_buffered_object_SRC := \
+	$(SERIAL_PATH)/tests/ring_buffered_object_tests.cpp \
+	$(SERIAL_PATH)/protocol/ring_buffered_object.c
+
 serial_link_transport_SRC := \
 	$(SERIAL_PATH)/tests/transport_tests.cpp \
 	$(SERIAL_PATH)/protocol/transport.c \
-	$(SERIAL_PATH)/protocol/triple_buffered_object.c 
+	$(SERIAL_PATH)/protocol/triple_buffered_object.c \
+	$(SERIAL_PATH)/protocol/ring_buffered_object.c \
+	$(SERIAL_PATH)/protocol/context.c
+
+serial_link_simulator_SRC := \
+	$(SERIAL_PATH)/tests/simulator_tests.cpp \
+	$(SERIAL_PATH)/tests/simulator.cpp \
+	$(SERIAL_PATH)/protocol/byte_stuffer.c \
+	$(SERIAL_PATH)/protocol/frame_validator.c \
+	$(SERIAL_PATH)/protocol/frame_router.c \
+	$(SERIAL_PATH)/protocol/transport.c \
+	$(SERIAL_PATH)/protocol/triple_buffered_object.c \
+	$(SERIAL_PATH)/protocol/ring_buffered_object.c \
+	$(SERIAL_PATH)/protocol/link_statistics.c \
+	$(SERIAL_PATH)/protocol/context.c
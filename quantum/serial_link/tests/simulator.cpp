@@ -0,0 +1,153 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "simulator.hpp"
+extern "C" {
+#include "serial_link/protocol/byte_stuffer.h"
+#include "serial_link/protocol/frame_router.h"
+#include "serial_link/protocol/physical.h"
+#include "serial_link/protocol/link_statistics.h"
+}
+
+VirtualUart::VirtualUart(const VirtualUartConfig& config, std::mt19937& random)
+    : config(config), random(random) {
+}
+
+void VirtualUart::send(uint64_t now_ns, const uint8_t* data, uint16_t size) {
+    // One start bit and one stop bit
+    const uint64_t byte_ns = 10ull * 1000000000ull / config.baud;
+    std::bernoulli_distribution bit_error(config.bit_error_rate);
+    for (uint16_t i=0;i<size;i++) {
+        uint8_t byte = data[i];
+        if (config.bit_error_rate > 0.0) {
+            for (int bit=0;bit<8;bit++) {
+                if (bit_error(random)) {
+                    byte ^= 1 << bit;
+                }
+            }
+        }
+        line_free_ns = std::max(line_free_ns, now_ns) + byte_ns;
+        in_flight.emplace_back(line_free_ns + config.latency_us * 1000ull, byte);
+        num_bytes_sent++;
+    }
+}
+
+bool VirtualUart::receive(uint64_t now_ns, uint8_t& data) {
+    if (!in_flight.empty() && in_flight.front().first <= now_ns) {
+        data = in_flight.front().second;
+        in_flight.pop_front();
+        return true;
+    }
+    return false;
+}
+
+Simulator* Simulator::Instance = nullptr;
+
+Simulator::Simulator(unsigned num_nodes, const VirtualUartConfig& config, unsigned seed)
+    : random(seed) {
+    Instance = this;
+    for (unsigned i=0;i<num_nodes;i++) {
+        nodes.emplace_back(new Node());
+        run_on(i, [i]() {
+            init_byte_stuffer();
+            init_link_statistics();
+            reinitialize_serial_link_transport();
+            router_set_master(i == 0);
+        });
+    }
+    for (unsigned i=1;i<num_nodes;i++) {
+        uarts.emplace_back(new VirtualUart(config, random));
+        VirtualUart* down = uarts.back().get();
+        uarts.emplace_back(new VirtualUart(config, random));
+        VirtualUart* up = uarts.back().get();
+        nodes[i - 1]->down_tx = down;
+        nodes[i]->up_rx = down;
+        nodes[i]->up_tx = up;
+        nodes[i - 1]->down_rx = up;
+    }
+}
+
+Simulator::~Simulator() {
+    if (Instance == this) {
+        Instance = nullptr;
+    }
+}
+
+void Simulator::add_remote_objects(unsigned node, remote_object_t** objects, uint32_t num_objects) {
+    run_on(node, [objects, num_objects]() {
+        ::add_remote_objects(objects, num_objects);
+    });
+}
+
+void Simulator::step() {
+    now_ns += step_ns;
+    for (unsigned i=0;i<nodes.size();i++) {
+        Node* node = nodes[i].get();
+        uint64_t now = now_ns;
+        run_on(i, [node, now]() {
+            uint8_t data;
+            while (node->up_rx && node->up_rx->receive(now, data)) {
+                byte_stuffer_recv_byte(UP_LINK, data);
+            }
+            while (node->down_rx && node->down_rx->receive(now, data)) {
+                byte_stuffer_recv_byte(DOWN_LINK, data);
+            }
+            update_transport();
+        });
+    }
+}
+
+void Simulator::run_for(uint64_t us) {
+    uint64_t end = now_ns + us * 1000;
+    while (now_ns < end) {
+        step();
+    }
+}
+
+link_statistics_t* Simulator::statistics(unsigned node, uint8_t link) {
+    link_statistics_t* ret;
+    run_on(node, [&ret, link]() {
+        ret = get_link_statistics(link);
+    });
+    return ret;
+}
+
+void Simulator::send_data(uint8_t link, const uint8_t* data, uint16_t size) {
+    Node* node = nodes[current_node].get();
+    VirtualUart* uart = link == UP_LINK ? node->up_tx : node->down_tx;
+    // The ends of the chain are not connected to anything
+    if (uart) {
+        uart->send(now_ns, data, size);
+    }
+}
+
+extern "C" {
+void send_data(uint8_t link, const uint8_t* data, uint16_t size) {
+    Simulator::Instance->send_data(link, data, size);
+}
+
+void signal_data_written(void) {
+    // The simulator updates the transport of every node on every step
+}
+}
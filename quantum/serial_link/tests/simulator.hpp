@@ -0,0 +1,125 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+extern "C" {
+#include "serial_link/protocol/context.h"
+}
+
+struct VirtualUartConfig {
+    uint32_t baud = 562500;
+    // Extra delay on top of the transmission time of each byte
+    uint32_t latency_us = 0;
+    // Probability for each transmitted bit to be flipped
+    double bit_error_rate = 0.0;
+};
+
+// One direction of a serial line. Bytes are sent one after another at the
+// configured baud, with a start and a stop bit, so a byte can't be
+// received before the previous one has finished.
+class VirtualUart {
+public:
+    VirtualUart(const VirtualUartConfig& config, std::mt19937& random);
+
+    void send(uint64_t now_ns, const uint8_t* data, uint16_t size);
+    bool receive(uint64_t now_ns, uint8_t& data);
+    uint64_t bytes_sent() const { return num_bytes_sent; }
+private:
+    VirtualUartConfig config;
+    std::mt19937& random;
+    std::deque<std::pair<uint64_t, uint8_t>> in_flight;
+    uint64_t line_free_ns = 0;
+    uint64_t num_bytes_sent = 0;
+};
+
+// A chain of nodes, where node 0 is the master and node i + 1 is slave i.
+// Every node has its own protocol context, and the simulator switches to it
+// when running the node, just like the serial link thread on the keyboard
+// would receive the data and update the transport.
+class Simulator {
+public:
+    Simulator(unsigned num_nodes, const VirtualUartConfig& config, unsigned seed = 1);
+    ~Simulator();
+
+    void add_remote_objects(unsigned node, remote_object_t** objects, uint32_t num_objects);
+
+    // Runs the function with the context of the node, so that the transport
+    // functions operate on that node
+    template<typename F>
+    void run_on(unsigned node, F f) {
+        serial_link_context_t* previous = serial_link_context;
+        current_node = node;
+        serial_link_set_context(&nodes[node]->context);
+        f();
+        serial_link_set_context(previous);
+    }
+
+    void step();
+    void run_for(uint64_t us);
+    // Steps until the condition is true, returns false if it times out
+    template<typename F>
+    bool run_until(F condition, uint64_t timeout_us) {
+        uint64_t end = now_ns + timeout_us * 1000;
+        while (now_ns < end) {
+            if (condition()) {
+                return true;
+            }
+            step();
+        }
+        return condition();
+    }
+
+    uint64_t now_us() const { return now_ns / 1000; }
+    unsigned num_nodes() const { return nodes.size(); }
+    link_statistics_t* statistics(unsigned node, uint8_t link);
+
+    void send_data(uint8_t link, const uint8_t* data, uint16_t size);
+
+    static Simulator* Instance;
+    // Time advanced by every step, smaller than a byte at the highest baud
+    static const uint64_t step_ns = 1000;
+private:
+    struct Node {
+        serial_link_context_t context;
+        // The lines that this node transmits on
+        VirtualUart* up_tx = nullptr;
+        VirtualUart* down_tx = nullptr;
+        // The lines that this node receives from
+        VirtualUart* up_rx = nullptr;
+        VirtualUart* down_rx = nullptr;
+    };
+
+    std::mt19937 random;
+    std::vector<std::unique_ptr<Node>> nodes;
+    std::vector<std::unique_ptr<VirtualUart>> uarts;
+    uint64_t now_ns = 0;
+    unsigned current_node = 0;
+};
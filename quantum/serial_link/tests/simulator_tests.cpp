@@ -0,0 +1,187 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "gtest/gtest.h"
+#include "simulator.hpp"
+#include <cstdio>
+extern "C" {
+#include "serial_link/protocol/transport.h"
+#include "serial_link/protocol/frame_router.h"
+}
+
+struct test_matrix {
+    uint32_t rows[8];
+};
+
+// Every node needs its own copy of the objects, the id of an object is
+// its position in the list, so all nodes have to use the same order
+#define NODE_OBJECTS(n) \
+    SLAVE_TO_MASTER_OBJECT(matrix##n, test_matrix); \
+    MASTER_TO_ALL_SLAVES_OBJECT(leds##n, uint32_t); \
+    SLAVE_TO_MASTER_STREAM_OBJECT(events##n, uint32_t, 8); \
+    static remote_object_t* node_objects##n[] = { \
+        REMOTE_OBJECT(matrix##n), \
+        REMOTE_OBJECT(leds##n), \
+        REMOTE_OBJECT(events##n), \
+    };
+
+NODE_OBJECTS(0)
+NODE_OBJECTS(1)
+NODE_OBJECTS(2)
+NODE_OBJECTS(3)
+NODE_OBJECTS(4)
+
+static remote_object_t** node_objects[] = {
+    node_objects0, node_objects1, node_objects2, node_objects3, node_objects4
+};
+
+typedef test_matrix* (*begin_write_matrix_t)(void);
+typedef void (*end_write_matrix_t)(void);
+static begin_write_matrix_t begin_write_matrix[] = {
+    begin_write_matrix0, begin_write_matrix1, begin_write_matrix2, begin_write_matrix3, begin_write_matrix4
+};
+static end_write_matrix_t end_write_matrix[] = {
+    end_write_matrix0, end_write_matrix1, end_write_matrix2, end_write_matrix3, end_write_matrix4
+};
+
+typedef uint32_t* (*read_leds_t)(void);
+static read_leds_t read_leds[] = {
+    read_leds0, read_leds1, read_leds2, read_leds3, read_leds4
+};
+
+class SerialLinkSimulator : public testing::Test {
+public:
+    void create(unsigned num_nodes, const VirtualUartConfig& config = VirtualUartConfig()) {
+        simulator.reset(new Simulator(num_nodes, config));
+        for (unsigned i=0;i<num_nodes;i++) {
+            simulator->add_remote_objects(i, node_objects[i], 3);
+        }
+    }
+
+    void write_matrix(unsigned node, uint32_t value) {
+        simulator->run_on(node, [node, value]() {
+            test_matrix* m = begin_write_matrix[node]();
+            for (int i=0;i<8;i++) {
+                m->rows[i] = value;
+            }
+            end_write_matrix[node]();
+        });
+    }
+
+    // Returns the time in microseconds it takes for a matrix written by the
+    // slave to arrive at the master, or 0 if it never does
+    uint64_t measure_slave_to_master_latency(unsigned slave, uint32_t value) {
+        uint64_t start = simulator->now_us();
+        write_matrix(slave + 1, value);
+        bool received = simulator->run_until([this, slave, value]() {
+            test_matrix* m = read_matrix0(slave);
+            return m && m->rows[7] == value;
+        }, 100000);
+        return received ? simulator->now_us() - start : 0;
+    }
+
+    std::unique_ptr<Simulator> simulator;
+};
+
+TEST_F(SerialLinkSimulator, slave_to_master_with_one_slave) {
+    create(2);
+    EXPECT_NE(measure_slave_to_master_latency(0, 0x12345678), 0);
+}
+
+TEST_F(SerialLinkSimulator, slaves_to_master_through_a_chain) {
+    create(5);
+    for (unsigned slave=0;slave<4;slave++) {
+        EXPECT_NE(measure_slave_to_master_latency(slave, slave + 1), 0);
+    }
+}
+
+TEST_F(SerialLinkSimulator, master_to_all_slaves_through_a_chain) {
+    create(5);
+    simulator->run_on(0, []() {
+        *begin_write_leds0() = 0xABCD;
+        end_write_leds0();
+    });
+    for (unsigned node=1;node<5;node++) {
+        uint32_t* leds = nullptr;
+        read_leds_t read = read_leds[node];
+        EXPECT_TRUE(simulator->run_until([&leds, read]() {
+            leds = read();
+            return leds != nullptr;
+        }, 100000));
+        EXPECT_EQ(*leds, 0xABCD);
+    }
+}
+
+TEST_F(SerialLinkSimulator, streams_events_from_the_last_slave) {
+    create(4);
+    simulator->run_on(3, []() {
+        for (uint32_t i=0;i<8;i++) {
+            *begin_write_events3() = i;
+            end_write_events3();
+        }
+    });
+    uint32_t expected = 0;
+    simulator->run_until([&expected]() {
+        uint32_t* e;
+        while ((e = read_events0(2))) {
+            EXPECT_EQ(*e, expected);
+            expected++;
+            end_read_events0(2);
+        }
+        return expected == 8;
+    }, 100000);
+    EXPECT_EQ(expected, 8);
+}
+
+TEST_F(SerialLinkSimulator, drops_corrupted_frames) {
+    VirtualUartConfig config;
+    config.bit_error_rate = 0.01;
+    create(2, config);
+    for (int i=0;i<50;i++) {
+        write_matrix(1, i);
+        simulator->run_for(2000);
+    }
+    link_statistics_t* s = simulator->statistics(0, DOWN_LINK);
+    EXPECT_GT(s->crc_failures + s->cobs_resets, 0);
+    EXPECT_LT(s->frames_received, 50);
+}
+
+TEST_F(SerialLinkSimulator, latency_by_chain_length) {
+    const uint32_t bauds[] = { 281250, 562500, 1125000 };
+    printf("%10s %8s %12s\n", "baud", "slaves", "latency us");
+    for (uint32_t baud : bauds) {
+        uint64_t previous = 0;
+        for (unsigned slaves=1;slaves<=4;slaves++) {
+            VirtualUartConfig config;
+            config.baud = baud;
+            config.latency_us = 5;
+            create(slaves + 1, config);
+            uint64_t latency = measure_slave_to_master_latency(slaves - 1, 0x55AA55AA);
+            printf("%10u %8u %12llu\n", baud, slaves, (unsigned long long)latency);
+            EXPECT_NE(latency, 0);
+            EXPECT_GT(latency, previous);
+            previous = latency;
+        }
+    }
+}
@@ -2,5 +2,10 @@ TEST_LIST +=\
 	serial_link_byte_stuffer\
 	serial_link_frame_validator\
 	serial_link_frame_router\
+	serial_link_link_statistics\
+	serial_link_baud_rate\
+	serial_link_key_time\
 	serial_link_triple_buffered_object\
-	serial_link_transport
\ No newline at end of file
+	serial_link_ring_buffered_object\
+	serial_link_transport\
+	serial_link_simulator
\ No newline at end of file
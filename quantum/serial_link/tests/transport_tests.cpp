@@ -45,11 +45,13 @@ struct test_object2 {
 MASTER_TO_ALL_SLAVES_OBJECT(master_to_slave, test_object1);
 MASTER_TO_SINGLE_SLAVE_OBJECT(master_to_single_slave, test_object1);
 SLAVE_TO_MASTER_OBJECT(slave_to_master, test_object1);
+SLAVE_TO_MASTER_STREAM_OBJECT(slave_to_master_stream, test_object1, 4);
 
 static remote_object_t* test_remote_objects[] = {
     REMOTE_OBJECT(master_to_slave),
     REMOTE_OBJECT(master_to_single_slave),
     REMOTE_OBJECT(slave_to_master),
+    REMOTE_OBJECT(slave_to_master_stream),
 };
 
 class Transport : public testing::Test {
@@ -186,3 +188,63 @@ TEST_F(Transport, ignores_object_with_size_too_big) {
     test_object1* obj2 = read_master_to_slave();
     EXPECT_EQ(obj2, nullptr);
 }
+
+TEST_F(Transport, does_not_send_when_nothing_is_written) {
+    EXPECT_CALL(*this, router_send_frame(_)).Times(0);
+    update_transport();
+    update_transport();
+}
+
+TEST_F(Transport, sends_written_object_only_once) {
+    begin_write_master_to_slave()->test = 5;
+    EXPECT_CALL(*this, signal_data_written());
+    end_write_master_to_slave();
+    EXPECT_CALL(*this, router_send_frame(0xFF)).Times(1);
+    update_transport();
+    update_transport();
+}
+
+TEST_F(Transport, sends_only_to_the_written_single_slaves) {
+    begin_write_master_to_single_slave(1)->test = 5;
+    EXPECT_CALL(*this, signal_data_written()).Times(2);
+    end_write_master_to_single_slave(1);
+    begin_write_master_to_single_slave(6)->test = 6;
+    end_write_master_to_single_slave(6);
+    EXPECT_CALL(*this, router_send_frame(2));
+    EXPECT_CALL(*this, router_send_frame(7));
+    update_transport();
+}
+
+TEST_F(Transport, streams_all_values_from_slave_to_master) {
+    EXPECT_CALL(*this, signal_data_written()).Times(3);
+    for (uint32_t i=0;i<3;i++) {
+        begin_write_slave_to_master_stream()->test = i + 10;
+        end_write_slave_to_master_stream();
+    }
+    EXPECT_CALL(*this, router_send_frame(0)).Times(3);
+    update_transport();
+    const size_t frame_size = sent_data.size() / 3;
+    for (uint32_t i=0;i<3;i++) {
+        transport_recv_frame(2, sent_data.data() + i * frame_size, frame_size);
+    }
+    EXPECT_EQ(read_slave_to_master_stream(0), nullptr);
+    for (uint32_t i=0;i<3;i++) {
+        test_object1* obj = read_slave_to_master_stream(1);
+        EXPECT_NE(obj, nullptr);
+        EXPECT_EQ(obj->test, i + 10);
+        end_read_slave_to_master_stream(1);
+    }
+    EXPECT_EQ(read_slave_to_master_stream(1), nullptr);
+}
+
+TEST_F(Transport, stream_write_fails_when_the_local_queue_is_full) {
+    EXPECT_CALL(*this, signal_data_written()).Times(4);
+    for (uint32_t i=0;i<4;i++) {
+        begin_write_slave_to_master_stream()->test = i;
+        end_write_slave_to_master_stream();
+    }
+    EXPECT_EQ(begin_write_slave_to_master_stream(), nullptr);
+    EXPECT_CALL(*this, router_send_frame(0)).Times(4);
+    update_transport();
+    EXPECT_NE(begin_write_slave_to_master_stream(), nullptr);
+}
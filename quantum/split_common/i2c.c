@@ -9,8 +9,8 @@
 #ifdef USE_I2C
 
 // Limits the amount of we wait for any one i2c transaction.
-// Since were running SCL line 100kHz (=> 10μs/bit), and each transactions is
-// 9 bits, a single transaction will take around 90μs to complete.
+// At the default 400kHz (=> 2.5μs/bit), and each transactions is 9 bits, a
+// single transaction will take around 23μs to complete.
 //
 // (F_CPU/SCL_CLOCK)  =>  # of μC cycles to transfer a bit
 // poll loop takes at least 8 clock cycles to execute
@@ -22,6 +22,9 @@ volatile uint8_t i2c_slave_buffer[SLAVE_BUFFER_SIZE];
 
 static volatile uint8_t slave_buffer_pos;
 static volatile bool slave_has_register_set = false;
+// Set when the master wrote only a register address, so the next read starts
+// there. Other reads always start at the beginning of the buffer.
+static volatile bool slave_read_from_register = false;
 
 // Wait for an i2c operation to finish
 inline static
@@ -34,7 +37,7 @@ void i2c_delay(void) {
   // _delay_us(100);
 }
 
-// Setup twi to run at 100kHz
+// Setup twi to run at SCL_CLOCK
 void i2c_master_init(void) {
   // no prescaler
   TWSR = 0;
@@ -68,6 +71,44 @@ uint8_t i2c_master_start(uint8_t address) {
 }
 
 
+// Read length bytes from the slave in a single transaction, starting at the
+// beginning of its buffer. This avoids writing the register address first,
+// so a one byte read only needs the address and the data on the bus.
+// returns: 0 => success
+//          1 => error
+uint8_t i2c_master_read_block(uint8_t address, uint8_t* data, uint8_t length) {
+  if (i2c_master_start(address + I2C_READ))
+    return 1;
+
+  while (length--) {
+    // acknowledge every byte except the last one, which ends the read
+    TWCR = (1<<TWINT) | (1<<TWEN) | ((length ? 1 : 0)<<TWEA);
+    i2c_delay();
+    if (TW_STATUS != (length ? TW_MR_DATA_ACK : TW_MR_DATA_NACK))
+      return 1;
+    *data++ = TWDR;
+  }
+
+  i2c_master_stop();
+  return 0;
+}
+
+// Write tx_length bytes to the slave at reg, then read rx_length bytes from
+// the beginning of its buffer after a repeated start, in one transaction.
+// returns: 0 => success
+//          1 => error
+uint8_t i2c_master_write_read_block(uint8_t address, uint8_t reg, const uint8_t* tx, uint8_t tx_length, uint8_t* rx, uint8_t rx_length) {
+  if (i2c_master_start(address + I2C_WRITE))
+    return 1;
+  if (i2c_master_write(reg))
+    return 1;
+  while (tx_length--) {
+    if (i2c_master_write(*tx++))
+      return 1;
+  }
+  return i2c_master_read_block(address, rx, rx_length);
+}
+
 // Finish the i2c transaction.
 void i2c_master_stop(void) {
   TWCR = (1<<TWINT) | (1<<TWEN) | (1<<TWSTO);
@@ -137,13 +178,20 @@ ISR(TWI_vect) {
           slave_buffer_pos = 0;
         }
         slave_has_register_set = true;
+        slave_read_from_register = true;
       } else {
+        slave_read_from_register = false;
         i2c_slave_buffer[slave_buffer_pos] = TWDR;
         BUFFER_POS_INC();
       }
       break;
 
     case TW_ST_SLA_ACK:
+      if (!slave_read_from_register) {
+        slave_buffer_pos = 0;
+      }
+      slave_read_from_register = false;
+      // fall through
     case TW_ST_DATA_ACK:
       // master has addressed this device as a slave transmitter and is
       // requesting data.
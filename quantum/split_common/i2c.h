@@ -13,10 +13,17 @@
 #define I2C_ACK 1
 #define I2C_NACK 0
 
-#define SLAVE_BUFFER_SIZE 0x10
+// Needs to hold the slave data followed by the master data, see
+// split_transport.h, matrix.c fails to compile if it's too small
+#ifndef SLAVE_BUFFER_SIZE
+#define SLAVE_BUFFER_SIZE 0x20
+#endif
 
-// i2c SCL clock frequency
+// i2c SCL clock frequency, the fastest the AVR supports at 16MHz is about
+// 444kHz, where TWBR reaches its minimum of 10
+#ifndef SCL_CLOCK
 #define SCL_CLOCK  400000L
+#endif
 
 extern volatile uint8_t i2c_slave_buffer[SLAVE_BUFFER_SIZE];
 
@@ -25,6 +32,8 @@ uint8_t i2c_master_start(uint8_t address);
 void i2c_master_stop(void);
 uint8_t i2c_master_write(uint8_t data);
 uint8_t i2c_master_read(int);
+uint8_t i2c_master_read_block(uint8_t address, uint8_t* data, uint8_t length);
+uint8_t i2c_master_write_read_block(uint8_t address, uint8_t reg, const uint8_t* tx, uint8_t tx_length, uint8_t* rx, uint8_t rx_length);
 void i2c_reset_state(void);
 void i2c_slave_init(uint8_t address);
 
@@ -27,6 +27,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "util.h"
 #include "matrix.h"
 #include "split_util.h"
+#include "split_transport.h"
 #include "pro_micro.h"
 #include "config.h"
 #include "timer.h"
@@ -51,10 +52,17 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #    define print_matrix_row(row)  print_bin_reverse8(matrix_get_row(row))
 #    define matrix_bitpop(i)       bitpop(matrix[i])
 #    define ROW_SHIFTER ((uint8_t)1)
-#else
-#    error "Currently only supports 8 COLS"
+#elif (MATRIX_COLS <= 16)
+#    define print_matrix_header()  print("\nr/c 0123456789ABCDEF\n")
+#    define print_matrix_row(row)  print_bin_reverse16(matrix_get_row(row))
+#    define matrix_bitpop(i)       bitpop16(matrix[i])
+#    define ROW_SHIFTER ((uint16_t)1)
+#elif (MATRIX_COLS <= 32)
+#    define print_matrix_header()  print("\nr/c 0123456789ABCDEF0123456789ABCDEF\n")
+#    define print_matrix_row(row)  print_bin_reverse32(matrix_get_row(row))
+#    define matrix_bitpop(i)       bitpop32(matrix[i])
+#    define ROW_SHIFTER  ((uint32_t)1)
 #endif
-static matrix_row_t matrix_debouncing[MATRIX_ROWS];
 
 #define ERROR_DISCONNECT_COUNT 5
 
@@ -166,7 +174,6 @@ uint8_t _matrix_scan(void)
             if (matrix_changed) {
                 debouncing = true;
                 debouncing_time = timer_read();
-                PORTD ^= (1 << 2);
             }
 
 #       else
@@ -205,50 +212,76 @@ uint8_t _matrix_scan(void)
 
 #ifdef USE_I2C
 
-// Get rows from other half over i2c
-int i2c_transaction(void) {
-    int slaveOffset = (isLeftHand) ? (ROWS_PER_HAND) : 0;
+volatile split_slave_data_t* split_transport_slave_data(void) {
+    return (volatile split_slave_data_t*)i2c_slave_buffer;
+}
 
-    int err = i2c_master_start(SLAVE_I2C_ADDRESS + I2C_WRITE);
-    if (err) goto i2c_error;
+// the master data is stored right after the slave data
+#define MASTER_DATA_OFFSET sizeof(split_slave_data_t)
 
-    // start of matrix stored at 0x00
-    err = i2c_master_write(0x00);
-    if (err) goto i2c_error;
+_Static_assert(sizeof(split_slave_data_t) + sizeof(split_master_data_t) <= SLAVE_BUFFER_SIZE,
+    "The split data doesn't fit into the i2c slave buffer, increase SLAVE_BUFFER_SIZE");
 
-    // Start read
-    err = i2c_master_start(SLAVE_I2C_ADDRESS + I2C_READ);
-    if (err) goto i2c_error;
+volatile split_master_data_t* split_transport_master_data(void) {
+    return (volatile split_master_data_t*)(i2c_slave_buffer + MASTER_DATA_OFFSET);
+}
 
-    if (!err) {
-        int i;
-        for (i = 0; i < ROWS_PER_HAND-1; ++i) {
-            matrix[slaveOffset+i] = i2c_master_read(I2C_ACK);
-        }
-        matrix[slaveOffset+i] = i2c_master_read(I2C_NACK);
-        i2c_master_stop();
+// Read from the start of the slave buffer over i2c, in a single burst, after
+// writing the master data if there is any
+split_transfer_result_t split_transport_transfer(const uint8_t* tx, uint8_t tx_length, uint8_t* rx, uint8_t rx_length) {
+    uint8_t err;
+    if (tx_length) {
+        err = i2c_master_write_read_block(SLAVE_I2C_ADDRESS, MASTER_DATA_OFFSET, tx, tx_length, rx, rx_length);
     } else {
-i2c_error: // the cable is disconnceted, or something else went wrong
+        err = i2c_master_read_block(SLAVE_I2C_ADDRESS, rx, rx_length);
+    }
+    if (err) {
+        // the cable is disconnceted, or something else went wrong
         i2c_reset_state();
-        return err;
+        return SPLIT_TRANSFER_FAILED;
     }
-
-    return 0;
+    return SPLIT_TRANSFER_DONE;
 }
 
 #else // USE_SERIAL
 
-int serial_transaction(void) {
-    int slaveOffset = (isLeftHand) ? (ROWS_PER_HAND) : 0;
+_Static_assert(sizeof(split_slave_data_t) <= SERIAL_SLAVE_BUFFER_LENGTH,
+    "The split slave data doesn't fit into SERIAL_SLAVE_BUFFER_LENGTH");
+_Static_assert(sizeof(split_master_data_t) <= SERIAL_MASTER_BUFFER_LENGTH,
+    "The split master data doesn't fit into SERIAL_MASTER_BUFFER_LENGTH");
 
-    if (serial_update_buffers()) {
-        return 1;
-    }
+volatile split_slave_data_t* split_transport_slave_data(void) {
+    return (volatile split_slave_data_t*)serial_slave_buffer;
+}
 
-    for (int i = 0; i < ROWS_PER_HAND; ++i) {
-        matrix[slaveOffset+i] = serial_slave_buffer[i];
+volatile split_master_data_t* split_transport_master_data(void) {
+    return (volatile split_master_data_t*)serial_master_buffer;
+}
+
+// The counter polls end the frame early, and block until the few bytes have
+// been received. Reading the whole slave data, and sending the master data,
+// is done in a complete frame, which serial_update_buffers spreads over
+// several scans.
+split_transfer_result_t split_transport_transfer(const uint8_t* tx, uint8_t tx_length, uint8_t* rx, uint8_t rx_length) {
+    if (rx_length < SERIAL_SLAVE_BUFFER_LENGTH) {
+        return serial_read_slave_buffer(rx, rx_length) ? SPLIT_TRANSFER_DONE : SPLIT_TRANSFER_FAILED;
+    }
+    // the frame copies the master buffer when it starts
+    for (uint8_t i = 0; i < tx_length; ++i) {
+        serial_master_buffer[i] = tx[i];
     }
-    return 0;
+    switch (serial_update_buffers()) {
+    case SERIAL_FRAME_INCOMPLETE:
+        return SPLIT_TRANSFER_BUSY;
+    case SERIAL_FRAME_ERROR:
+        return SPLIT_TRANSFER_FAILED;
+    default:
+        break;
+    }
+    for (uint8_t i = 0; i < rx_length; ++i) {
+        rx[i] = serial_slave_buffer[i];
+    }
+    return SPLIT_TRANSFER_DONE;
 }
 #endif
 
@@ -256,11 +289,12 @@ uint8_t matrix_scan(void)
 {
     uint8_t ret = _matrix_scan();
 
-#ifdef USE_I2C
-    if( i2c_transaction() ) {
-#else // USE_SERIAL
-    if( serial_transaction() ) {
-#endif
+    int slaveOffset = (isLeftHand) ? (ROWS_PER_HAND) : 0;
+    split_state_t state;
+    split_state_get(&state);
+    // only reads the whole slave half when it reports a change, or when the
+    // state has to be sent down
+    if( split_transport_master_update(matrix + slaveOffset, &state) == SPLIT_TRANSPORT_ERROR ) {
         // turn on the indicator led when halves are disconnected
         TXLED1;
 
@@ -268,7 +302,6 @@ uint8_t matrix_scan(void)
 
         if (error_count > ERROR_DISCONNECT_COUNT) {
             // reset other half if disconnected
-            int slaveOffset = (isLeftHand) ? (ROWS_PER_HAND) : 0;
             for (int i = 0; i < ROWS_PER_HAND; ++i) {
                 matrix[slaveOffset+i] = 0;
             }
@@ -287,15 +320,12 @@ void matrix_slave_scan(void) {
 
     int offset = (isLeftHand) ? 0 : ROWS_PER_HAND;
 
-#ifdef USE_I2C
-    for (int i = 0; i < ROWS_PER_HAND; ++i) {
-        i2c_slave_buffer[i] = matrix[offset+i];
-    }
-#else // USE_SERIAL
-    for (int i = 0; i < ROWS_PER_HAND; ++i) {
-        serial_slave_buffer[i] = matrix[offset+i];
+    split_transport_slave_update(matrix + offset);
+
+    split_state_t state;
+    if (split_transport_slave_get_state(&state)) {
+        split_state_apply(&state);
     }
-#endif
 }
 
 bool matrix_is_modified(void)
@@ -318,10 +348,11 @@ matrix_row_t matrix_get_row(uint8_t row)
 
 void matrix_print(void)
 {
-    print("\nr/c 0123456789ABCDEF\n");
+    print_matrix_header();
+
     for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
         phex(row); print(": ");
-        pbin_reverse16(matrix_get_row(row));
+        print_matrix_row(row);
         print("\n");
     }
 }
@@ -330,7 +361,7 @@ uint8_t matrix_key_count(void)
 {
     uint8_t count = 0;
     for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
-        count += bitpop16(matrix[i]);
+        count += matrix_bitpop(i);
     }
     return count;
 }
@@ -0,0 +1,336 @@
+/*
+ * WARNING: be careful changing this code, it is very timing dependent
+ *
+ * The master and the slave exchange one byte in each direction per
+ * transaction. The master starts a transaction by pulling the line low, the
+ * falling edge triggers the pin interrupt on the slave. The edge is latched,
+ * so even a short pulse is seen by a slave that has interrupts disabled at
+ * the time, the master waits up to SERIAL_RESPONSE_TIMEOUT for the answer.
+ * Holding the line low for a whole bit period marks the first byte of a
+ * frame, a short pulse continues the current frame. This lets the master spread a frame over several calls to
+ * serial_update_buffers, so the keyboard loop is never stalled for more than
+ * SERIAL_BYTES_PER_UPDATE bytes, and the slave keeps scanning in between.
+ * The master can also end a frame early with serial_read_slave_buffer, to
+ * poll the first few bytes of the slave buffer, which blocks for just those
+ * bytes.
+ */
+
+#ifndef F_CPU
+#define F_CPU 16000000
+#endif
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/delay.h>
+#include <stdbool.h>
+#include "serial.h"
+
+#ifndef USE_I2C
+
+uint8_t volatile serial_slave_buffer[SERIAL_SLAVE_BUFFER_LENGTH] = {0};
+uint8_t volatile serial_master_buffer[SERIAL_MASTER_BUFFER_LENGTH] = {0};
+
+#define SLAVE_DATA_CORRUPT (1<<0)
+volatile uint8_t status = 0;
+
+// The state of the frame currently being transferred, the master and the
+// slave each use their own half of it
+static uint8_t frame_index = 0;
+static uint8_t frame_checksum_sent = 0;
+static uint8_t frame_checksum_computed = 0;
+static uint8_t frame_tx[SERIAL_FRAME_LENGTH - 1];
+static uint8_t frame_rx[SERIAL_FRAME_LENGTH - 1];
+
+inline static
+void serial_delay(void) {
+  _delay_us(SERIAL_DELAY);
+}
+
+inline static
+void serial_delay_half(void) {
+  _delay_us(SERIAL_DELAY/2);
+}
+
+inline static
+void serial_output(void) {
+  SERIAL_PIN_DDR |= SERIAL_PIN_MASK;
+}
+
+// make the serial pin an input with pull-up resistor
+inline static
+void serial_input(void) {
+  SERIAL_PIN_DDR  &= ~SERIAL_PIN_MASK;
+  SERIAL_PIN_PORT |= SERIAL_PIN_MASK;
+}
+
+inline static
+uint8_t serial_read_pin(void) {
+  return !!(SERIAL_PIN_INPUT & SERIAL_PIN_MASK);
+}
+
+inline static
+void serial_low(void) {
+  SERIAL_PIN_PORT &= ~SERIAL_PIN_MASK;
+}
+
+inline static
+void serial_high(void) {
+  SERIAL_PIN_PORT |= SERIAL_PIN_MASK;
+}
+
+void serial_master_init(void) {
+  serial_output();
+  serial_high();
+}
+
+void serial_slave_init(void) {
+  serial_input();
+
+  // Trigger on the falling edge of the pin, and ignore any edge from before
+  SERIAL_PIN_EICR = (SERIAL_PIN_EICR & ~_BV(SERIAL_PIN_ISC0_BIT)) | _BV(SERIAL_PIN_ISC1_BIT);
+  EIFR = _BV(SERIAL_PIN_INTF_BIT);
+  EIMSK |= _BV(SERIAL_PIN_INT_BIT);
+}
+
+// Used by the master to synchronize timing with the slave.
+static
+void sync_recv(void) {
+  serial_input();
+  // This shouldn't hang if the slave disconnects because the
+  // serial line will float to high if the slave does disconnect.
+  while (!serial_read_pin());
+  serial_delay();
+}
+
+// Used by the slave to send a synchronization signal to the master.
+static
+void sync_send(void) {
+  serial_output();
+
+  serial_low();
+  serial_delay();
+
+  serial_high();
+}
+
+// Reads a byte from the serial line
+static
+uint8_t serial_read_byte(void) {
+  uint8_t byte = 0;
+  serial_input();
+  for ( uint8_t i = 0; i < 8; ++i) {
+    byte = (byte << 1) | serial_read_pin();
+    serial_delay();
+    _delay_us(1);
+  }
+
+  return byte;
+}
+
+// Sends a byte with MSB ordering
+static
+void serial_write_byte(uint8_t data) {
+  uint8_t b = 8;
+  serial_output();
+  while( b-- ) {
+    if(data & (1 << b)) {
+      serial_high();
+    } else {
+      serial_low();
+    }
+    serial_delay();
+  }
+}
+
+// Returns the byte to send at the current frame position, and updates the
+// checksum of the sent bytes
+static
+uint8_t frame_next_tx(void) {
+  if (frame_index == SERIAL_FRAME_LENGTH - 1) {
+    return frame_checksum_sent;
+  }
+  uint8_t data = frame_tx[frame_index];
+  frame_checksum_sent += data;
+  return data;
+}
+
+// Stores a received byte, returns true when it completes a valid frame
+static
+bool frame_store_rx(uint8_t data) {
+  if (frame_index == SERIAL_FRAME_LENGTH - 1) {
+    frame_index = 0;
+    return data == frame_checksum_computed;
+  }
+  frame_rx[frame_index++] = data;
+  frame_checksum_computed += data;
+  return false;
+}
+
+static
+void frame_start(volatile uint8_t* tx, uint8_t tx_length) {
+  frame_index = 0;
+  frame_checksum_sent = 0;
+  frame_checksum_computed = 0;
+  for (uint8_t i = 0; i < SERIAL_FRAME_LENGTH - 1; ++i) {
+    frame_tx[i] = i < tx_length ? tx[i] : 0;
+  }
+}
+
+// interrupt handle to be used by the slave device
+ISR(SERIAL_PIN_INTERRUPT) {
+  // a long start pulse begins a new frame
+  serial_delay_half();
+  if (!serial_read_pin()) {
+    frame_start(serial_slave_buffer, SERIAL_SLAVE_BUFFER_LENGTH);
+    while (!serial_read_pin());
+  }
+  uint8_t data = frame_next_tx();
+
+  sync_send();
+  serial_write_byte(data);
+  sync_send();
+
+  // wait for the sync to finish sending
+  serial_delay();
+
+  // read the middle of pulses
+  serial_delay_half();
+
+  data = serial_read_byte();
+  sync_send();
+
+  serial_input(); // end transaction
+
+  uint8_t index = frame_index;
+  if (frame_store_rx(data)) {
+    for (uint8_t i = 0; i < SERIAL_MASTER_BUFFER_LENGTH; ++i) {
+      serial_master_buffer[i] = frame_rx[i];
+    }
+    status &= ~SLAVE_DATA_CORRUPT;
+  } else if (index == SERIAL_FRAME_LENGTH - 1) {
+    status |= SLAVE_DATA_CORRUPT;
+  }
+
+  // ignore the edges generated by the transaction itself
+  EIFR = _BV(SERIAL_PIN_INTF_BIT);
+}
+
+inline
+bool serial_slave_data_corrupt(void) {
+  return status & SLAVE_DATA_CORRUPT;
+}
+
+// Exchanges a single byte with the slave
+//
+// Returns:
+// true => the slave responded
+// false => slave did not respond
+static
+bool serial_exchange_byte(bool first, uint8_t tx, uint8_t* rx) {
+  // this code is very time dependent, so we need to disable interrupts
+  cli();
+
+  // signal to the slave that we want to start a transaction
+  serial_output();
+  serial_low();
+  if (first) {
+    serial_delay();
+  } else {
+    _delay_us(1);
+  }
+
+  // wait for the slaves response, it starts as soon as the line goes high
+  // after a long pulse, and half a period after a short one, or later if
+  // the slave had interrupts disabled
+  serial_input();
+  serial_high();
+  // give the pull-up time to raise the line
+  serial_delay_half();
+  uint16_t timeout = SERIAL_RESPONSE_TIMEOUT;
+  while (serial_read_pin()) {
+    if (!timeout--) {
+      // slave failed to pull the line low, assume not present
+      serial_output();
+      serial_high();
+      sei();
+      return false;
+    }
+    _delay_us(1);
+  }
+
+  // if the slave is present syncronize with it
+  sync_recv();
+
+  *rx = serial_read_byte();
+  sync_recv();
+
+  serial_write_byte(tx);
+  sync_recv();
+
+  // always, release the line when not in use
+  serial_output();
+  serial_high();
+
+  sei();
+  return true;
+}
+
+// Continues the transfer of serial_slave_buffer to the master and
+// serial_master_buffer to the slave. Each call exchanges at most
+// SERIAL_BYTES_PER_UPDATE bytes, and serial_slave_buffer is updated once the
+// whole frame has been received.
+//
+// Returns:
+// SERIAL_FRAME_INCOMPLETE => call again to continue the frame
+// SERIAL_FRAME_COMPLETE => serial_slave_buffer has been updated
+// SERIAL_FRAME_ERROR => slave did not respond, or the frame was corrupted
+serial_frame_result_t serial_update_buffers(void) {
+  for (uint8_t i = 0; i < SERIAL_BYTES_PER_UPDATE; ++i) {
+    bool first = frame_index == 0;
+    if (first) {
+      frame_start(serial_master_buffer, SERIAL_MASTER_BUFFER_LENGTH);
+    }
+
+    uint8_t data;
+    if (!serial_exchange_byte(first, frame_next_tx(), &data)) {
+      frame_index = 0;
+      return SERIAL_FRAME_ERROR;
+    }
+
+    bool last = frame_index == SERIAL_FRAME_LENGTH - 1;
+    if (frame_store_rx(data)) {
+      for (uint8_t j = 0; j < SERIAL_SLAVE_BUFFER_LENGTH; ++j) {
+        serial_slave_buffer[j] = frame_rx[j];
+      }
+      return SERIAL_FRAME_COMPLETE;
+    } else if (last) {
+      return SERIAL_FRAME_ERROR;
+    }
+  }
+  return SERIAL_FRAME_INCOMPLETE;
+}
+
+// Reads the first length bytes of the slave buffer in a new frame, blocking
+// until they have been received. The frame is ended early, so the bytes are
+// not checked, and the slave buffer and the master buffer are not updated.
+// The length has to be shorter than the slave buffer, complete frames are
+// transferred with serial_update_buffers.
+//
+// Don't call this while serial_update_buffers is in the middle of a frame,
+// they share the frame state.
+bool serial_read_slave_buffer(uint8_t* data, uint8_t length) {
+  frame_start(serial_master_buffer, SERIAL_MASTER_BUFFER_LENGTH);
+  for (uint8_t i = 0; i < length; ++i) {
+    uint8_t byte;
+    if (!serial_exchange_byte(i == 0, frame_next_tx(), &byte)) {
+      frame_index = 0;
+      return false;
+    }
+    frame_store_rx(byte);
+    data[i] = byte;
+  }
+  frame_index = 0;
+  return true;
+}
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef SPLIT_COMMON_SERIAL_H
+#define SPLIT_COMMON_SERIAL_H
+
+#include "config.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include "split_transport.h"
+
+/* The pin used for the single wire link, it has to be an external interrupt
+ * pin on the slave side. SERIAL_PIN_INT is the number of its interrupt, for
+ * example 0 for INT0 on PD0, the vector and the interrupt bits follow from
+ * it. The defaults match the boards that used to carry their own copy of
+ * this file.
+ */
+#ifndef SERIAL_PIN_DDR
+#define SERIAL_PIN_DDR DDRD
+#endif
+#ifndef SERIAL_PIN_PORT
+#define SERIAL_PIN_PORT PORTD
+#endif
+#ifndef SERIAL_PIN_INPUT
+#define SERIAL_PIN_INPUT PIND
+#endif
+#ifndef SERIAL_PIN_MASK
+#define SERIAL_PIN_MASK _BV(PD0)
+#endif
+#ifndef SERIAL_PIN_INT
+#define SERIAL_PIN_INT 0
+#endif
+#ifdef SERIAL_PIN_INTERRUPT
+#error "Set SERIAL_PIN_INT to the number of the external interrupt instead of SERIAL_PIN_INTERRUPT"
+#endif
+
+#define SERIAL_CONCAT(a, b, c) a ## b ## c
+#define SERIAL_XCONCAT(a, b, c) SERIAL_CONCAT(a, b, c)
+#define SERIAL_PIN_INTERRUPT SERIAL_XCONCAT(INT, SERIAL_PIN_INT, _vect)
+#define SERIAL_PIN_INT_BIT SERIAL_XCONCAT(INT, SERIAL_PIN_INT, )
+#define SERIAL_PIN_INTF_BIT SERIAL_XCONCAT(INTF, SERIAL_PIN_INT, )
+#define SERIAL_PIN_ISC0_BIT SERIAL_XCONCAT(ISC, SERIAL_PIN_INT, 0)
+#define SERIAL_PIN_ISC1_BIT SERIAL_XCONCAT(ISC, SERIAL_PIN_INT, 1)
+#if SERIAL_PIN_INT < 4
+#define SERIAL_PIN_EICR EICRA
+#else
+#define SERIAL_PIN_EICR EICRB
+#endif
+
+// Serial pulse period in microseconds. Short cables usually work with values
+// down to around 12, lower it in config.h and test on the actual hardware.
+#ifndef SERIAL_DELAY
+#define SERIAL_DELAY 24
+#endif
+
+// How long the master waits, in microseconds, for the slave to answer the
+// start of a byte. The slave answers from its pin interrupt, so this has to
+// cover the longest time it runs with interrupts disabled, for example while
+// it sends the colors to WS2812 LEDs, which takes about 30us per LED.
+#ifndef SERIAL_RESPONSE_TIMEOUT
+#define SERIAL_RESPONSE_TIMEOUT 100
+#endif
+
+// The number of bytes the master exchanges with the slave each time
+// serial_update_buffers is called. The split transport calls it once per
+// scan while a frame is being transferred, so the keyboard loop is only
+// blocked for that many bytes. Otherwise it just polls the two change
+// counter bytes. Set it to SERIAL_FRAME_LENGTH to transfer a whole frame on
+// every call.
+#ifndef SERIAL_BYTES_PER_UPDATE
+#define SERIAL_BYTES_PER_UPDATE 1
+#endif
+
+// The slave sends its rows up, and the master sends the keyboard state
+// down, see split_transport.h
+#ifndef SERIAL_SLAVE_BUFFER_LENGTH
+#define SERIAL_SLAVE_BUFFER_LENGTH sizeof(split_slave_data_t)
+#endif
+#ifndef SERIAL_MASTER_BUFFER_LENGTH
+#define SERIAL_MASTER_BUFFER_LENGTH sizeof(split_master_data_t)
+#endif
+
+// Both sides send the same number of bytes, the shorter buffer is padded
+// with zeroes, followed by a checksum
+#define SERIAL_FRAME_LENGTH ((SERIAL_SLAVE_BUFFER_LENGTH > SERIAL_MASTER_BUFFER_LENGTH ? \
+    SERIAL_SLAVE_BUFFER_LENGTH : SERIAL_MASTER_BUFFER_LENGTH) + 1)
+
+// Buffers for master - slave communication
+// They are only updated when a whole frame has been received with a valid
+// checksum, so they never contain a partially transferred frame.
+extern volatile uint8_t serial_slave_buffer[SERIAL_SLAVE_BUFFER_LENGTH];
+extern volatile uint8_t serial_master_buffer[SERIAL_MASTER_BUFFER_LENGTH];
+
+typedef enum {
+    SERIAL_FRAME_INCOMPLETE,
+    SERIAL_FRAME_COMPLETE,
+    SERIAL_FRAME_ERROR,
+} serial_frame_result_t;
+
+void serial_master_init(void);
+void serial_slave_init(void);
+serial_frame_result_t serial_update_buffers(void);
+bool serial_read_slave_buffer(uint8_t* data, uint8_t length);
+bool serial_slave_data_corrupt(void);
+
+#endif
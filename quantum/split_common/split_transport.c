@@ -0,0 +1,104 @@
+#include <string.h>
+#include "split_transport.h"
+
+static uint8_t last_change_counter;
+static uint8_t state_ack;
+static bool needs_full_read = true;
+static bool transfer_busy = false;
+static split_master_data_t master_data;
+
+void split_transport_init(void) {
+    needs_full_read = true;
+    transfer_busy = false;
+    // the slave starts with a state counter of zero, so it will take the
+    // first state the master sends
+    master_data.counter = 1;
+    volatile split_slave_data_t* data = split_transport_slave_data();
+    data->change_check = ~data->change_counter;
+}
+
+bool split_transport_slave_update(const matrix_row_t* rows) {
+    volatile split_slave_data_t* data = split_transport_slave_data();
+    bool changed = false;
+    for (uint8_t i = 0; i < SPLIT_ROWS_PER_HAND; ++i) {
+        if (data->rows[i] != rows[i]) {
+            data->rows[i] = rows[i];
+            changed = true;
+        }
+    }
+    // The counter is written last, so the master never sees the new value
+    // together with the old rows
+    if (changed) {
+        uint8_t counter = data->change_counter + 1;
+        data->change_counter = counter;
+        data->change_check = ~counter;
+    }
+    return changed;
+}
+
+bool split_transport_slave_get_state(split_state_t* state) {
+    volatile split_master_data_t* master = split_transport_master_data();
+    volatile split_slave_data_t* data = split_transport_slave_data();
+    uint8_t counter = master->counter;
+    if (counter == data->state_counter) {
+        return false;
+    }
+    volatile uint8_t* src = (volatile uint8_t*)&master->state;
+    uint8_t* dst = (uint8_t*)state;
+    for (uint8_t i = 0; i < sizeof(split_state_t); ++i) {
+        dst[i] = src[i];
+    }
+    // The master wrote a new state while it was copied, take it next time
+    if (master->counter != counter) {
+        return false;
+    }
+    data->state_counter = counter;
+    return true;
+}
+
+split_transport_result_t split_transport_master_update(matrix_row_t* rows, const split_state_t* state) {
+    if (memcmp(&master_data.state, state, sizeof(split_state_t)) != 0) {
+        master_data.state = *state;
+        master_data.counter++;
+    }
+    bool full_read = needs_full_read;
+    bool send_state = full_read || state_ack != master_data.counter;
+
+    // a transfer that is already under way is continued without polling
+    if (!send_state && !transfer_busy) {
+        uint8_t counter[2];
+        if (split_transport_transfer(NULL, 0, counter, sizeof(counter)) != SPLIT_TRANSFER_DONE) {
+            needs_full_read = true;
+            return SPLIT_TRANSPORT_ERROR;
+        }
+        if (counter[0] == last_change_counter && counter[1] == (uint8_t)~counter[0]) {
+            return SPLIT_TRANSPORT_UNCHANGED;
+        }
+    }
+
+    split_slave_data_t data;
+    split_transfer_result_t result;
+    if (send_state) {
+        result = split_transport_transfer((uint8_t*)&master_data, sizeof(master_data), (uint8_t*)&data, sizeof(data));
+    } else {
+        result = split_transport_transfer(NULL, 0, (uint8_t*)&data, sizeof(data));
+    }
+    transfer_busy = result == SPLIT_TRANSFER_BUSY;
+    if (transfer_busy) {
+        return SPLIT_TRANSPORT_UNCHANGED;
+    }
+    if (result != SPLIT_TRANSFER_DONE) {
+        needs_full_read = true;
+        return SPLIT_TRANSPORT_ERROR;
+    }
+    needs_full_read = false;
+    state_ack = data.state_counter;
+    // the rows may not have changed when the read was only done to send the
+    // state, or because the polled counter was corrupted
+    if (!full_read && data.change_counter == last_change_counter) {
+        return SPLIT_TRANSPORT_UNCHANGED;
+    }
+    last_change_counter = data.change_counter;
+    memcpy(rows, data.rows, sizeof(data.rows));
+    return SPLIT_TRANSPORT_CHANGED;
+}
@@ -0,0 +1,83 @@
+#ifndef SPLIT_TRANSPORT_H
+#define SPLIT_TRANSPORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "matrix.h"
+
+#define SPLIT_ROWS_PER_HAND (MATRIX_ROWS / 2)
+
+// The keyboard state the master sends down to the slave, so it can show
+// layer indicators and run the same lighting
+typedef struct __attribute__((packed)) {
+    uint32_t layer_state;
+    uint8_t mods;
+    uint8_t leds;
+#ifdef BACKLIGHT_ENABLE
+    uint8_t backlight_level;
+#endif
+#ifdef RGBLIGHT_ENABLE
+    uint32_t rgblight_config;
+#endif
+} split_state_t;
+
+// The data the slave half exposes to the master. The slave increments the
+// change counter every time its rows change, so while nothing happens the
+// master only has to read the counter and its check byte, which holds the
+// complement of the counter. A corrupted counter doesn't match the check
+// byte, so it can't hide a change. The state counter tells which state from
+// the master the slave has received.
+typedef struct __attribute__((packed)) {
+    uint8_t change_counter;
+    uint8_t change_check;
+    uint8_t state_counter;
+    matrix_row_t rows[SPLIT_ROWS_PER_HAND];
+} split_slave_data_t;
+
+// The data the master writes to the slave. The counter comes last, so that
+// it's only updated after the state when written byte by byte.
+typedef struct __attribute__((packed)) {
+    split_state_t state;
+    uint8_t counter;
+} split_master_data_t;
+
+typedef enum {
+    SPLIT_TRANSPORT_UNCHANGED,
+    SPLIT_TRANSPORT_CHANGED,
+    SPLIT_TRANSPORT_ERROR,
+} split_transport_result_t;
+
+typedef enum {
+    SPLIT_TRANSFER_DONE,
+    SPLIT_TRANSFER_BUSY,
+    SPLIT_TRANSFER_FAILED,
+} split_transfer_result_t;
+
+// Called by both halves before the transport starts
+void split_transport_init(void);
+
+// Called by the slave after each scan, returns true if the rows changed
+bool split_transport_slave_update(const matrix_row_t* rows);
+// Called by the slave, returns true and fills in state when a new state has
+// arrived from the master
+bool split_transport_slave_get_state(split_state_t* state);
+
+// Called by the master each scan, rows are only written when the slave
+// reported a change. The state is sent along with the read whenever it
+// differs from what the slave has acknowledged.
+split_transport_result_t split_transport_master_update(matrix_row_t* rows, const split_state_t* state);
+
+// Implemented by the transport (i2c or serial)
+
+// The slave side buffers, the master reads the slave data and writes the
+// master data
+volatile split_slave_data_t* split_transport_slave_data(void);
+volatile split_master_data_t* split_transport_master_data(void);
+// Writes tx_length bytes of master data to the slave, when tx_length is not
+// zero, and reads the first rx_length bytes of the slave data in the same
+// transaction. A transfer of the whole slave data can be spread over several
+// scans, it returns SPLIT_TRANSFER_BUSY until it's done, and is called again
+// on the next scan. Shorter reads are always done at once.
+split_transfer_result_t split_transport_transfer(const uint8_t* tx, uint8_t tx_length, uint8_t* rx, uint8_t rx_length);
+
+#endif
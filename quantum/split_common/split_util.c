@@ -0,0 +1,156 @@
+#include <avr/io.h>
+#include <avr/wdt.h>
+#include <avr/power.h>
+#include <avr/interrupt.h>
+#include <util/delay.h>
+#include <avr/eeprom.h>
+#include "split_util.h"
+#include "split_transport.h"
+#include "matrix.h"
+#include "keyboard.h"
+#include "config.h"
+#include "timer.h"
+#include "action_layer.h"
+#include "action_util.h"
+#include "host.h"
+#include "led.h"
+#ifdef BACKLIGHT_ENABLE
+#  include "backlight.h"
+#endif
+#ifdef RGBLIGHT_ENABLE
+#  include "rgblight.h"
+extern rgblight_config_t rgblight_config;
+#endif
+
+#ifdef USE_I2C
+#  include "i2c.h"
+#else
+#  include "serial.h"
+#endif
+
+volatile bool isLeftHand = true;
+
+static void setup_handedness(void) {
+  #ifdef EE_HANDS
+    isLeftHand = eeprom_read_byte(EECONFIG_HANDEDNESS);
+  #else
+    // I2C_MASTER_RIGHT is deprecated, use MASTER_RIGHT instead, since this works for both serial and i2c
+    #if defined(I2C_MASTER_RIGHT) || defined(MASTER_RIGHT)
+      isLeftHand = !has_usb();
+    #else
+      isLeftHand = has_usb();
+    #endif
+  #endif
+}
+
+static void keyboard_master_setup(void) {
+    split_transport_init();
+#ifdef USE_I2C
+    i2c_master_init();
+#ifdef SSD1306OLED
+    matrix_master_OLED_init ();
+#endif
+#else
+    serial_master_init();
+#endif
+}
+
+static void keyboard_slave_setup(void) {
+  timer_init();
+    split_transport_init();
+#ifdef USE_I2C
+    i2c_slave_init(SLAVE_I2C_ADDRESS);
+#else
+    serial_slave_init();
+#endif
+}
+
+bool has_usb(void) {
+   USBCON |= (1 << OTGPADE); //enables VBUS pad
+   _delay_us(5);
+   return (USBSTA & (1<<VBUS));  //checks state of VBUS
+}
+
+void split_keyboard_setup(void) {
+   setup_handedness();
+
+   if (has_usb()) {
+      keyboard_master_setup();
+   } else {
+      keyboard_slave_setup();
+   }
+   sei();
+}
+
+void split_state_get(split_state_t* state) {
+#ifndef NO_ACTION_LAYER
+    state->layer_state = layer_state;
+#else
+    state->layer_state = 0;
+#endif
+    state->mods = get_mods();
+    state->leds = host_keyboard_leds();
+#ifdef BACKLIGHT_ENABLE
+    state->backlight_level = get_backlight_level();
+#endif
+#ifdef RGBLIGHT_ENABLE
+    state->rgblight_config = rgblight_config.raw;
+#endif
+}
+
+// Only calls the functions for the parts that changed, the rgblight and
+// backlight ones write to the eeprom
+void split_state_apply(const split_state_t* state) {
+    static split_state_t applied;
+    static bool first = true;
+
+#ifndef NO_ACTION_LAYER
+    if (first || state->layer_state != applied.layer_state) {
+        layer_state_set(state->layer_state);
+    }
+#endif
+    if (first || state->mods != applied.mods) {
+        set_mods(state->mods);
+    }
+    if (first || state->leds != applied.leds) {
+        led_set(state->leds);
+    }
+#ifdef BACKLIGHT_ENABLE
+    if (first || state->backlight_level != applied.backlight_level) {
+        backlight_level(state->backlight_level);
+    }
+#endif
+#ifdef RGBLIGHT_ENABLE
+    if (first || state->rgblight_config != applied.rgblight_config) {
+        rgblight_update_dword(state->rgblight_config);
+    }
+#endif
+    applied = *state;
+    first = false;
+}
+
+void keyboard_slave_loop(void) {
+   matrix_init();
+#ifdef BACKLIGHT_ENABLE
+   backlight_init();
+#endif
+#ifdef RGBLIGHT_ENABLE
+   rgblight_init();
+#endif
+
+   while (1) {
+      matrix_slave_scan();
+#if defined(RGBLIGHT_ENABLE) && defined(RGBLIGHT_ANIMATIONS)
+      rgblight_task();
+#endif
+   }
+}
+
+// this code runs before the usb and keyboard is initialized
+void matrix_setup(void) {
+    split_keyboard_setup();
+
+    if (!has_usb()) {
+        keyboard_slave_loop();
+    }
+}
@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include "eeconfig.h"
+#include "split_transport.h"
 
 #define SLAVE_I2C_ADDRESS           0x32
 
@@ -17,4 +18,8 @@ void keyboard_slave_loop(void);
 
 void matrix_master_OLED_init (void);
 
+// Collect the keyboard state on the master, and show it on the slave
+void split_state_get(split_state_t* state);
+void split_state_apply(const split_state_t* state);
+
 #endif
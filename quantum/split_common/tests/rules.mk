@@ -0,0 +1,5 @@
+split_common_transport_SRC :=\
+	$(QUANTUM_PATH)/split_common/tests/split_transport_tests.cpp \
+	$(QUANTUM_PATH)/split_common/split_transport.c
+
+split_common_transport_DEFS := -DMATRIX_ROWS=8 -DMATRIX_COLS=10
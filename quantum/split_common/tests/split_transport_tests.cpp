@@ -0,0 +1,335 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <cstring>
+extern "C" {
+#include "split_common/split_transport.h"
+}
+
+// A fake i2c or serial link, the master reads directly from the slave buffer
+// and writes to the master buffer
+class FakeTransport {
+public:
+    FakeTransport() {
+        Instance = this;
+        memset(&slave_data, 0, sizeof(slave_data));
+        memset(&master_data, 0, sizeof(master_data));
+    }
+    ~FakeTransport() {
+        if (Instance == this) {
+            Instance = nullptr;
+        }
+    }
+
+    split_slave_data_t slave_data;
+    split_master_data_t master_data;
+    unsigned int bytes_read = 0;
+    unsigned int bytes_written = 0;
+    unsigned int num_reads = 0;
+    bool connected = true;
+    // The number of scans a full transfer takes, like the serial transport
+    unsigned int scans_per_transfer = 1;
+    unsigned int transfer_scans = 0;
+    // Replaces the next polled counter, like a corrupted byte would
+    bool corrupt_next_poll = false;
+    uint8_t corrupted_counter = 0;
+
+    static FakeTransport* Instance;
+};
+
+FakeTransport* FakeTransport::Instance = nullptr;
+
+extern "C" {
+volatile split_slave_data_t* split_transport_slave_data(void) {
+    return &FakeTransport::Instance->slave_data;
+}
+
+volatile split_master_data_t* split_transport_master_data(void) {
+    return &FakeTransport::Instance->master_data;
+}
+
+split_transfer_result_t split_transport_transfer(const uint8_t* tx, uint8_t tx_length, uint8_t* rx, uint8_t rx_length) {
+    FakeTransport* transport = FakeTransport::Instance;
+    if (!transport->connected) {
+        transport->transfer_scans = 0;
+        return SPLIT_TRANSFER_FAILED;
+    }
+    if (rx_length == sizeof(split_slave_data_t) &&
+            ++transport->transfer_scans < transport->scans_per_transfer) {
+        return SPLIT_TRANSFER_BUSY;
+    }
+    transport->transfer_scans = 0;
+    transport->bytes_written += tx_length;
+    memcpy(&transport->master_data, tx, tx_length);
+    transport->num_reads++;
+    transport->bytes_read += rx_length;
+    memcpy(rx, &transport->slave_data, rx_length);
+    if (rx_length < sizeof(split_slave_data_t) && transport->corrupt_next_poll) {
+        transport->corrupt_next_poll = false;
+        rx[0] = transport->corrupted_counter;
+    }
+    return SPLIT_TRANSFER_DONE;
+}
+}
+
+class SplitTransport : public testing::Test {
+public:
+    SplitTransport() {
+        split_transport_init();
+        memset(master_rows, 0, sizeof(master_rows));
+        memset(slave_rows, 0, sizeof(slave_rows));
+        memset(&master_state, 0, sizeof(master_state));
+        memset(&slave_state, 0, sizeof(slave_state));
+    }
+
+    split_transport_result_t master_update() {
+        return split_transport_master_update(master_rows, &master_state);
+    }
+
+    // a slave scan, returns true when a new state arrived
+    bool slave_update() {
+        split_transport_slave_update(slave_rows);
+        return split_transport_slave_get_state(&slave_state);
+    }
+
+    // the first exchange, after which the slave has acknowledged the state
+    void connect() {
+        master_update();
+        slave_update();
+        master_update();
+        transport.bytes_read = 0;
+        transport.bytes_written = 0;
+        transport.num_reads = 0;
+    }
+
+    void press(uint8_t row, uint8_t col) {
+        slave_rows[row] |= (matrix_row_t)1 << col;
+    }
+
+    void release(uint8_t row, uint8_t col) {
+        slave_rows[row] &= ~((matrix_row_t)1 << col);
+    }
+
+    void expect_rows_equal() {
+        for (int i = 0; i < SPLIT_ROWS_PER_HAND; i++) {
+            EXPECT_EQ(master_rows[i], slave_rows[i]);
+        }
+    }
+
+    FakeTransport transport;
+    matrix_row_t master_rows[SPLIT_ROWS_PER_HAND];
+    matrix_row_t slave_rows[SPLIT_ROWS_PER_HAND];
+    split_state_t master_state;
+    split_state_t slave_state;
+};
+
+TEST_F(SplitTransport, first_update_reads_everything_and_sends_the_state) {
+    press(1, 9);
+    master_state.layer_state = 0x5;
+    slave_update();
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_CHANGED);
+    EXPECT_EQ(transport.bytes_read, sizeof(split_slave_data_t));
+    EXPECT_EQ(transport.bytes_written, sizeof(split_master_data_t));
+    expect_rows_equal();
+    EXPECT_TRUE(slave_update());
+    EXPECT_EQ(slave_state.layer_state, 0x5);
+}
+
+TEST_F(SplitTransport, polls_a_single_byte_while_idle) {
+    connect();
+    for (int i = 0; i < 100; i++) {
+        EXPECT_FALSE(slave_update());
+        EXPECT_EQ(master_update(), SPLIT_TRANSPORT_UNCHANGED);
+    }
+    EXPECT_EQ(transport.num_reads, 100);
+    // the counter and its check byte
+    EXPECT_EQ(transport.bytes_read, 200);
+    EXPECT_EQ(transport.bytes_written, 0);
+}
+
+TEST_F(SplitTransport, reads_the_rows_when_they_change) {
+    connect();
+    press(0, 0);
+    press(3, 9);
+    EXPECT_TRUE(split_transport_slave_update(slave_rows));
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_CHANGED);
+    EXPECT_EQ(transport.bytes_read, 2 + sizeof(split_slave_data_t));
+    expect_rows_equal();
+    release(0, 0);
+    slave_update();
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_CHANGED);
+    expect_rows_equal();
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_UNCHANGED);
+}
+
+TEST_F(SplitTransport, the_counter_only_changes_with_the_rows) {
+    press(2, 4);
+    slave_update();
+    uint8_t counter = transport.slave_data.change_counter;
+    slave_update();
+    slave_update();
+    EXPECT_EQ(transport.slave_data.change_counter, counter);
+    release(2, 4);
+    slave_update();
+    EXPECT_EQ(transport.slave_data.change_counter, (uint8_t)(counter + 1));
+}
+
+TEST_F(SplitTransport, does_not_miss_changes_when_the_counter_wraps) {
+    connect();
+    for (int i = 0; i < 300; i++) {
+        if (i & 1) {
+            release(1, 1);
+        } else {
+            press(1, 1);
+        }
+        slave_update();
+        EXPECT_EQ(master_update(), SPLIT_TRANSPORT_CHANGED);
+        expect_rows_equal();
+    }
+}
+
+TEST_F(SplitTransport, sends_the_state_until_the_slave_acknowledges_it) {
+    connect();
+    master_state.mods = 0x2;
+    master_state.leds = 0x1;
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_UNCHANGED);
+    EXPECT_EQ(transport.bytes_written, sizeof(split_master_data_t));
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_UNCHANGED);
+    EXPECT_EQ(transport.bytes_written, 2 * sizeof(split_master_data_t));
+    EXPECT_TRUE(slave_update());
+    EXPECT_EQ(slave_state.mods, 0x2);
+    EXPECT_EQ(slave_state.leds, 0x1);
+    EXPECT_FALSE(slave_update());
+    // the next read picks up the acknowledgement
+    master_update();
+    transport.bytes_written = 0;
+    transport.bytes_read = 0;
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_UNCHANGED);
+    EXPECT_EQ(transport.bytes_written, 0);
+    EXPECT_EQ(transport.bytes_read, 2);
+}
+
+TEST_F(SplitTransport, sends_the_rows_and_the_state_in_the_same_transfer) {
+    connect();
+    press(2, 2);
+    slave_update();
+    master_state.layer_state = 0x10;
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_CHANGED);
+    EXPECT_EQ(transport.num_reads, 1);
+    expect_rows_equal();
+    EXPECT_TRUE(slave_update());
+    EXPECT_EQ(slave_state.layer_state, 0x10);
+}
+
+TEST_F(SplitTransport, only_the_latest_state_is_applied) {
+    connect();
+    master_state.layer_state = 1;
+    master_update();
+    master_state.layer_state = 2;
+    master_update();
+    EXPECT_TRUE(slave_update());
+    EXPECT_EQ(slave_state.layer_state, 2);
+    EXPECT_FALSE(slave_update());
+}
+
+TEST_F(SplitTransport, reports_errors_and_reads_everything_after_reconnecting) {
+    connect();
+    transport.connected = false;
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_ERROR);
+    transport.connected = true;
+    transport.bytes_read = 0;
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_CHANGED);
+    EXPECT_EQ(transport.bytes_read, sizeof(split_slave_data_t));
+}
+
+TEST_F(SplitTransport, picks_up_changes_made_while_disconnected) {
+    connect();
+    transport.connected = false;
+    press(0, 2);
+    slave_update();
+    master_state.mods = 0x4;
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_ERROR);
+    transport.connected = true;
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_CHANGED);
+    expect_rows_equal();
+    EXPECT_TRUE(slave_update());
+    EXPECT_EQ(slave_state.mods, 0x4);
+}
+
+TEST_F(SplitTransport, a_corrupted_counter_does_not_hide_a_change) {
+    connect();
+    uint8_t counter = transport.slave_data.change_counter;
+    press(3, 3);
+    slave_update();
+    // the poll reads the old counter, but the check byte doesn't match it
+    transport.corrupt_next_poll = true;
+    transport.corrupted_counter = counter;
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_CHANGED);
+    expect_rows_equal();
+}
+
+TEST_F(SplitTransport, a_corrupted_counter_without_a_change_is_ignored) {
+    connect();
+    transport.corrupt_next_poll = true;
+    transport.corrupted_counter = transport.slave_data.change_counter + 1;
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_UNCHANGED);
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_UNCHANGED);
+    expect_rows_equal();
+}
+
+TEST_F(SplitTransport, continues_a_transfer_over_several_scans) {
+    connect();
+    transport.scans_per_transfer = 4;
+    press(1, 5);
+    slave_update();
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_UNCHANGED);
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_UNCHANGED);
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_UNCHANGED);
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_CHANGED);
+    expect_rows_equal();
+    // only the first scan polled the counter
+    EXPECT_EQ(transport.num_reads, 2);
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_UNCHANGED);
+    EXPECT_EQ(transport.num_reads, 3);
+}
+
+TEST_F(SplitTransport, sends_the_state_in_a_transfer_over_several_scans) {
+    connect();
+    transport.scans_per_transfer = 3;
+    master_state.layer_state = 0x20;
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_UNCHANGED);
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_UNCHANGED);
+    EXPECT_FALSE(slave_update());
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_UNCHANGED);
+    EXPECT_TRUE(slave_update());
+    EXPECT_EQ(slave_state.layer_state, 0x20);
+}
+
+TEST_F(SplitTransport, starts_over_when_a_transfer_fails) {
+    connect();
+    transport.scans_per_transfer = 3;
+    press(0, 1);
+    slave_update();
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_UNCHANGED);
+    transport.connected = false;
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_ERROR);
+    transport.connected = true;
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_UNCHANGED);
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_UNCHANGED);
+    EXPECT_EQ(master_update(), SPLIT_TRANSPORT_CHANGED);
+    expect_rows_equal();
+}
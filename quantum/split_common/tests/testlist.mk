@@ -0,0 +1,2 @@
+TEST_LIST +=\
+	split_common_transport
\ No newline at end of file
@@ -0,0 +1,90 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "gtest/gtest.h"
+#include <chrono>
+#include <iostream>
+extern "C" {
+#include "color.h"
+}
+
+// The conversion that sethsv used to do, with divisions
+static RGB reference_hsv_to_rgb(uint16_t hue, uint8_t sat, uint8_t val) {
+  uint8_t r = 0, g = 0, b = 0, base, color;
+  if (sat == 0) {
+    r = val;
+    g = val;
+    b = val;
+  } else {
+    base = ((255 - sat) * val) >> 8;
+    color = (val - base) * (hue % 60) / 60;
+
+    switch (hue / 60) {
+      case 0: r = val; g = base + color; b = base; break;
+      case 1: r = val - color; g = val; b = base; break;
+      case 2: r = base; g = val; b = base + color; break;
+      case 3: r = base; g = val - color; b = val; break;
+      case 4: r = base + color; g = base; b = val; break;
+      case 5: r = val; g = base; b = val - color; break;
+    }
+  }
+  RGB rgb = {r, g, b};
+  return rgb;
+}
+
+TEST(Color, hsv_to_rgb_is_identical_to_the_division_version) {
+  for (uint16_t hue = 0; hue < 370; hue++) {
+    for (int sat = 0; sat < 256; sat++) {
+      for (int val = 0; val < 256; val++) {
+        RGB expected = reference_hsv_to_rgb(hue, sat, val);
+        RGB actual = hsv_to_rgb(hue, sat, val);
+        ASSERT_EQ(actual.r, expected.r) << hue << " " << sat << " " << val;
+        ASSERT_EQ(actual.g, expected.g) << hue << " " << sat << " " << val;
+        ASSERT_EQ(actual.b, expected.b) << hue << " " << sat << " " << val;
+      }
+    }
+  }
+}
+
+TEST(Color, hue_add_wraps_around) {
+  EXPECT_EQ(hue_add(0, 10), 10);
+  EXPECT_EQ(hue_add(350, 10), 0);
+  EXPECT_EQ(hue_add(359, 359), 358);
+}
+
+// Host compilers turn the divisions by a constant into multiplications too,
+// so this only shows that the conversion is not slower. On the AVR, with
+// -Os, each division is a call to __udivmodhi4.
+TEST(Color, benchmark) {
+  volatile uint8_t sink = 0;
+  auto run = [&](RGB (*convert)(uint16_t, uint8_t, uint8_t)) {
+    auto start = std::chrono::steady_clock::now();
+    for (int repeat = 0; repeat < 4; repeat++) {
+      for (uint16_t hue = 0; hue < 360; hue++) {
+        for (int val = 0; val < 256; val += 3) {
+          RGB rgb = convert(hue, 200, val);
+          sink += rgb.r + rgb.g + rgb.b;
+        }
+      }
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  };
+  long reference = run(reference_hsv_to_rgb);
+  long optimized = run(hsv_to_rgb);
+  std::cout << "hsv to rgb, divisions: " << reference << " us, multiply-shift: " << optimized << " us" << std::endl;
+  (void)sink;
+}
@@ -0,0 +1,66 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <string.h>
+extern "C" {
+#include "led_frame.h"
+}
+
+class LedFrame : public testing::Test {
+public:
+  LedFrame() {
+    memset(frame, 0, sizeof(frame));
+    memset(sent, 0, sizeof(sent));
+  }
+
+  uint16_t changed_length() {
+    return led_frame_changed_length(frame, sent, sizeof(frame));
+  }
+
+  uint8_t frame[30];
+  uint8_t sent[30];
+};
+
+TEST_F(LedFrame, an_unchanged_frame_is_not_sent) {
+  EXPECT_EQ(changed_length(), 0);
+}
+
+TEST_F(LedFrame, sends_up_to_the_last_change) {
+  frame[4] = 10;
+  EXPECT_EQ(changed_length(), 5);
+}
+
+TEST_F(LedFrame, sends_the_whole_frame_when_the_last_byte_changes) {
+  frame[1] = 1;
+  frame[29] = 2;
+  EXPECT_EQ(changed_length(), 30);
+}
+
+TEST_F(LedFrame, remembers_what_was_sent) {
+  frame[7] = 3;
+  EXPECT_EQ(changed_length(), 8);
+  EXPECT_EQ(memcmp(frame, sent, sizeof(frame)), 0);
+  EXPECT_EQ(changed_length(), 0);
+  frame[2] = 0;
+  frame[7] = 0;
+  EXPECT_EQ(changed_length(), 8);
+}
+
+TEST_F(LedFrame, sends_the_first_byte_alone) {
+  frame[0] = 255;
+  EXPECT_EQ(changed_length(), 1);
+}
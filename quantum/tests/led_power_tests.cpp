@@ -0,0 +1,74 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <vector>
+extern "C" {
+#include "led_power.h"
+}
+
+static const uint8_t channel_ma = 20;
+
+static double current(const std::vector<uint8_t>& frame) {
+  double sum = 0;
+  for (uint8_t v : frame) {
+    sum += v * channel_ma / 255.0;
+  }
+  return sum;
+}
+
+TEST(LedPower, leaves_a_frame_within_the_budget_alone) {
+  std::vector<uint8_t> frame(30, 255);
+  EXPECT_FALSE(led_power_limit(frame.data(), frame.size(), channel_ma, 600));
+  EXPECT_EQ(frame, std::vector<uint8_t>(30, 255));
+}
+
+TEST(LedPower, scales_full_white_down_to_the_budget) {
+  // 30 RGB LEDs at full white would draw 1800mA
+  std::vector<uint8_t> frame(90, 255);
+  EXPECT_TRUE(led_power_limit(frame.data(), frame.size(), channel_ma, 500));
+  EXPECT_LE(current(frame), 500);
+  EXPECT_GT(current(frame), 480);
+}
+
+TEST(LedPower, keeps_the_colors) {
+  std::vector<uint8_t> frame;
+  for (int i = 0; i < 30; i++) {
+    frame.push_back(200);
+    frame.push_back(100);
+    frame.push_back(0);
+  }
+  led_power_limit(frame.data(), frame.size(), channel_ma, 200);
+  EXPECT_LE(current(frame), 200);
+  EXPECT_NEAR(frame[0], frame[1] * 2, 1);
+  EXPECT_EQ(frame[2], 0);
+}
+
+TEST(LedPower, never_goes_over_the_budget) {
+  for (int budget = 1; budget < 2000; budget += 7) {
+    std::vector<uint8_t> frame;
+    for (int i = 0; i < 100; i++) {
+      frame.push_back((i * 37 + budget) & 0xFF);
+    }
+    led_power_limit(frame.data(), frame.size(), channel_ma, budget);
+    EXPECT_LE(current(frame), budget) << "budget " << budget;
+  }
+}
+
+TEST(LedPower, a_dark_frame_is_free) {
+  std::vector<uint8_t> frame(10, 0);
+  EXPECT_EQ(led_power_scale(frame.data(), frame.size(), channel_ma, 0), 255);
+}
@@ -0,0 +1,87 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <cmath>
+extern "C" {
+#include "led_table_generator.h"
+#include "led_tables.h"
+}
+
+#define SIN_ENTRY(i) ((uint8_t)(255.0 * LED_TABLE_SIN((i) / 255.0 * LED_TABLE_PI)))
+#define BREATHE_ENTRY(i) LED_TABLE_BREATHE(i, 256, 1.85, 255)
+#define DIM_BREATHE_ENTRY(i) LED_TABLE_BREATHE(i, 256, 1.4, 127)
+#define SMALL_BREATHE_ENTRY(i) LED_TABLE_BREATHE(i, 64, 1.85, 255)
+
+static const uint8_t sin_table[] PROGMEM = { LED_TABLE_256(SIN_ENTRY) };
+static const uint8_t breathe_table[] PROGMEM = { LED_TABLE_256(BREATHE_ENTRY) };
+static const uint8_t dim_breathe_table[] PROGMEM = { LED_TABLE_256(DIM_BREATHE_ENTRY) };
+static const uint8_t small_breathe_table[] PROGMEM = { LED_TABLE_64(SMALL_BREATHE_ENTRY) };
+
+// The formula rgblight used to evaluate at runtime
+static uint8_t reference_breathe(int pos, double center, double max) {
+    float val = (exp(sin((pos/255.0)*M_PI)) - center/M_E)*(max/(M_E-1/M_E));
+    return val;
+}
+
+TEST(LedTableGenerator, SinMatchesLibm) {
+    for (int i = 0; i < 256; i++) {
+        EXPECT_NEAR(sin_table[i], (uint8_t)(255.0 * sin(i / 255.0 * M_PI)), 1) << "at " << i;
+    }
+}
+
+TEST(LedTableGenerator, ExpMatchesLibm) {
+    for (int i = -100; i <= 100; i++) {
+        double x = i / 100.0;
+        EXPECT_NEAR(LED_TABLE_EXP(x), exp(x), 1e-5) << "at " << x;
+    }
+}
+
+TEST(LedTableGenerator, Cie1931MatchesTheLedTable) {
+    for (int i = 0; i < 256; i++) {
+        EXPECT_NEAR(CIE1931_CURVE[i], LED_TABLE_CIE1931(i) * 255, 0.5) << "at " << i;
+    }
+}
+
+TEST(LedTableGenerator, BreatheMatchesTheFloatingPointVersion) {
+    for (int i = 0; i < 256; i++) {
+        EXPECT_NEAR(breathe_table[i], reference_breathe(i, 1.85, 255), 1) << "at " << i;
+        EXPECT_NEAR(dim_breathe_table[i], reference_breathe(i, 1.4, 127), 1) << "at " << i;
+    }
+}
+
+TEST(LedTableGenerator, ReadsAFullTableDirectly) {
+    for (int i = 0; i < 256; i++) {
+        EXPECT_EQ(led_table_read(breathe_table, 8, i), breathe_table[i]);
+    }
+}
+
+TEST(LedTableGenerator, InterpolatesASmallTable) {
+    for (int i = 0; i < 256; i++) {
+        if (i % 4 == 0) {
+            EXPECT_EQ(led_table_read(small_breathe_table, 6, i), small_breathe_table[i / 4]);
+        }
+        // The curve is smooth enough that interpolating a quarter of the
+        // entries stays close to the full table
+        EXPECT_NEAR(led_table_read(small_breathe_table, 6, i), breathe_table[i], 4) << "at " << i;
+    }
+}
+
+TEST(LedTableGenerator, InterpolationWrapsAround) {
+    uint8_t last = small_breathe_table[63];
+    uint8_t first = small_breathe_table[0];
+    EXPECT_EQ(led_table_read(small_breathe_table, 6, 254), last + (first - last) / 2);
+}
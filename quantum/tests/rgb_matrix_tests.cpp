@@ -0,0 +1,228 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <vector>
+extern "C" {
+#include "rgb_matrix.h"
+void set_time(uint32_t t);
+void advance_time(uint32_t ms);
+}
+
+// A 3 x 5 board, with an LED under every key, and one more underneath the
+// keyboard
+#define KEY(row, col) {row, col, (uint8_t)(col * 16 + 8), (uint8_t)(row * 16 + 8)}
+
+extern "C" const rgb_led_t rgb_matrix_leds[RGB_MATRIX_LED_COUNT] PROGMEM = {
+  KEY(0, 0), KEY(0, 1), KEY(0, 2), KEY(0, 3), KEY(0, 4),
+  KEY(1, 0), KEY(1, 1), KEY(1, 2), KEY(1, 3), KEY(1, 4),
+  KEY(2, 0), KEY(2, 1), KEY(2, 2), KEY(2, 3), KEY(2, 4),
+  {RGB_MATRIX_NO_KEY, RGB_MATRIX_NO_KEY, 40, 24},
+};
+
+static std::vector<std::vector<RGB>> flushed;
+
+extern "C" void rgb_matrix_driver_flush(const RGB* frame, uint8_t count) {
+  flushed.push_back(std::vector<RGB>(frame, frame + count));
+}
+
+static uint8_t led(uint8_t row, uint8_t col) {
+  return row * 5 + col;
+}
+
+static bool lit(uint8_t index) {
+  RGB c = rgb_matrix_frame[index];
+  return c.r || c.g || c.b;
+}
+
+class RGBMatrix : public testing::Test {
+public:
+  RGBMatrix() {
+    flushed.clear();
+    set_time(1000);
+    rgb_matrix_init();
+    rgb_matrix_sethsv(0, 255, 255);
+  }
+
+  void press(uint8_t row, uint8_t col, uint16_t time) {
+    rgb_matrix_record_key(row, col, true, time);
+    rgb_matrix_record_key(row, col, false, time + 20);
+  }
+};
+
+TEST_F(RGBMatrix, solid_sets_every_led) {
+  rgb_matrix_mode(RGB_MATRIX_SOLID);
+  rgb_matrix_sethsv(120, 255, 200);
+  rgb_matrix_render(1000);
+  RGB expected = hsv_to_rgb(120, 255, 200);
+  for (int i = 0; i < RGB_MATRIX_LED_COUNT; i++) {
+    EXPECT_EQ(rgb_matrix_frame[i].r, expected.r);
+    EXPECT_EQ(rgb_matrix_frame[i].g, expected.g);
+    EXPECT_EQ(rgb_matrix_frame[i].b, expected.b);
+  }
+}
+
+TEST_F(RGBMatrix, off_turns_everything_off) {
+  rgb_matrix_mode(RGB_MATRIX_OFF);
+  rgb_matrix_render(1000);
+  for (int i = 0; i < RGB_MATRIX_LED_COUNT; i++) {
+    EXPECT_FALSE(lit(i));
+  }
+}
+
+TEST_F(RGBMatrix, gradient_follows_the_x_position) {
+  rgb_matrix_mode(RGB_MATRIX_GRADIENT);
+  rgb_matrix_render(1000);
+  for (int col = 0; col < 5; col++) {
+    EXPECT_EQ(rgb_matrix_frame[led(0, col)].r, rgb_matrix_frame[led(2, col)].r);
+    EXPECT_EQ(rgb_matrix_frame[led(0, col)].g, rgb_matrix_frame[led(2, col)].g);
+  }
+  // Red on the left, moving towards green
+  EXPECT_GT(rgb_matrix_frame[led(0, 0)].r, rgb_matrix_frame[led(0, 0)].g);
+  EXPECT_GT(rgb_matrix_frame[led(0, 4)].g, rgb_matrix_frame[led(0, 0)].g);
+}
+
+TEST_F(RGBMatrix, ripple_spreads_out_from_the_pressed_key) {
+  rgb_matrix_mode(RGB_MATRIX_RIPPLE);
+  press(1, 2, 1000);
+  rgb_matrix_render(1000);
+  EXPECT_TRUE(lit(led(1, 2)));
+  EXPECT_FALSE(lit(led(1, 0)));
+  EXPECT_FALSE(lit(led(1, 4)));
+
+  // Two keys away after 128ms
+  rgb_matrix_render(1128);
+  EXPECT_FALSE(lit(led(1, 2)));
+  EXPECT_TRUE(lit(led(1, 0)));
+  EXPECT_TRUE(lit(led(1, 4)));
+}
+
+TEST_F(RGBMatrix, ripple_fades_away) {
+  rgb_matrix_mode(RGB_MATRIX_RIPPLE);
+  press(0, 0, 1000);
+  rgb_matrix_render(1000 + RGB_MATRIX_HIT_TIME);
+  for (int i = 0; i < RGB_MATRIX_LED_COUNT; i++) {
+    EXPECT_FALSE(lit(i));
+  }
+}
+
+TEST_F(RGBMatrix, splash_fills_the_circle_and_changes_color) {
+  rgb_matrix_mode(RGB_MATRIX_SPLASH);
+  press(1, 2, 1000);
+  rgb_matrix_render(1064);
+  EXPECT_TRUE(lit(led(1, 2)));
+  EXPECT_TRUE(lit(led(1, 3)));
+  EXPECT_FALSE(lit(led(1, 4)));
+  // Red at the pressed key, turning towards yellow further out
+  EXPECT_EQ(rgb_matrix_frame[led(1, 2)].g, 0);
+  EXPECT_GT(rgb_matrix_frame[led(1, 3)].g, 0);
+}
+
+TEST_F(RGBMatrix, only_draws_the_latest_presses) {
+  rgb_matrix_mode(RGB_MATRIX_SPLASH);
+  for (int i = 0; i <= RGB_MATRIX_HITS; i++) {
+    press(i / 5, i % 5, 1000);
+  }
+  rgb_matrix_render(1000);
+  EXPECT_FALSE(lit(led(0, 0)));
+  for (int i = 1; i <= RGB_MATRIX_HITS; i++) {
+    EXPECT_TRUE(lit(i)) << "led " << i;
+  }
+}
+
+TEST_F(RGBMatrix, ignores_releases_and_keys_without_leds) {
+  rgb_matrix_mode(RGB_MATRIX_SPLASH);
+  rgb_matrix_record_key(0, 0, false, 1000);
+  rgb_matrix_record_key(5, 5, true, 1000);
+  rgb_matrix_render(1000);
+  for (int i = 0; i < RGB_MATRIX_LED_COUNT; i++) {
+    EXPECT_FALSE(lit(i));
+  }
+}
+
+TEST_F(RGBMatrix, heatmap_warms_up_the_pressed_keys_and_cools_down) {
+  rgb_matrix_mode(RGB_MATRIX_HEATMAP);
+  rgb_matrix_render(1000);
+  EXPECT_EQ(rgb_matrix_frame[led(0, 0)].b, 255);
+  EXPECT_EQ(rgb_matrix_frame[led(0, 0)].r, 0);
+
+  for (int i = 0; i < 8; i++) {
+    press(0, 0, 1000);
+  }
+  rgb_matrix_render(1000);
+  EXPECT_EQ(rgb_matrix_frame[led(0, 0)].r, 255);
+  EXPECT_EQ(rgb_matrix_frame[led(0, 0)].b, 0);
+  EXPECT_EQ(rgb_matrix_frame[led(0, 1)].b, 255);
+
+  rgb_matrix_render(1000 + 255 * RGB_MATRIX_HEAT_DECAY_INTERVAL);
+  EXPECT_EQ(rgb_matrix_frame[led(0, 0)].b, 255);
+  EXPECT_EQ(rgb_matrix_frame[led(0, 0)].r, 0);
+}
+
+TEST_F(RGBMatrix, sends_frames_at_the_frame_rate) {
+  rgb_matrix_mode(RGB_MATRIX_RIPPLE);
+  rgb_matrix_task();
+  EXPECT_EQ(flushed.size(), 0);
+  advance_time(RGB_MATRIX_FRAME_INTERVAL);
+  rgb_matrix_task();
+  rgb_matrix_task();
+  EXPECT_EQ(flushed.size(), 1);
+  advance_time(RGB_MATRIX_FRAME_INTERVAL);
+  rgb_matrix_task();
+  EXPECT_EQ(flushed.size(), 2);
+}
+
+TEST_F(RGBMatrix, static_effects_are_only_sent_when_they_change) {
+  rgb_matrix_mode(RGB_MATRIX_SOLID);
+  for (int i = 0; i < 3; i++) {
+    advance_time(RGB_MATRIX_FRAME_INTERVAL);
+    rgb_matrix_task();
+  }
+  EXPECT_EQ(flushed.size(), 1);
+  rgb_matrix_sethsv(60, 255, 255);
+  advance_time(RGB_MATRIX_FRAME_INTERVAL);
+  rgb_matrix_task();
+  EXPECT_EQ(flushed.size(), 2);
+}
+
+// Built with RGB_MATRIX_MAX_CURRENT 300, 16 red LEDs at full brightness draw 320mA
+
+TEST_F(RGBMatrix, the_current_limit_leaves_the_frame_alone) {
+  rgb_matrix_mode(RGB_MATRIX_SOLID);
+  rgb_matrix_sethsv(0, 255, 255);
+  advance_time(RGB_MATRIX_FRAME_INTERVAL);
+  rgb_matrix_task();
+  ASSERT_EQ(flushed.size(), 1);
+  EXPECT_EQ(flushed[0][0].r, 255);
+  EXPECT_EQ(rgb_matrix_frame[0].r, 255);
+}
+
+TEST_F(RGBMatrix, limit_power_dims_the_values_of_the_driver) {
+  RGB out[RGB_MATRIX_LED_COUNT];
+  for (int i = 0; i < RGB_MATRIX_LED_COUNT; i++) {
+    out[i] = (RGB){255, 0, 0};
+  }
+  EXPECT_TRUE(rgb_matrix_limit_power(out, RGB_MATRIX_LED_COUNT));
+  EXPECT_LE(out[0].r * RGB_MATRIX_LED_COUNT * 20 / 255, 300);
+  EXPECT_GT(out[0].r, 230);
+}
+
+TEST_F(RGBMatrix, limit_power_keeps_values_within_the_limit) {
+  RGB out[RGB_MATRIX_LED_COUNT] = {};
+  out[0] = (RGB){255, 255, 255};
+  EXPECT_FALSE(rgb_matrix_limit_power(out, RGB_MATRIX_LED_COUNT));
+  EXPECT_EQ(out[0].r, 255);
+}
@@ -0,0 +1,103 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+extern "C" {
+#include "rgblight_output.h"
+#include "led_tables.h"
+}
+
+// Built with RGBW, RGBLIGHT_LIMIT_VAL 128 and RGBLIGHT_WHITE_BALANCE_B 200
+
+static LED_TYPE color(uint8_t r, uint8_t g, uint8_t b) {
+  LED_TYPE c = {};
+  c.r = r;
+  c.g = g;
+  c.b = b;
+  return c;
+}
+
+static uint8_t curve(uint8_t v) {
+  return CIE1931_CURVE[v];
+}
+
+// The full power of a channel, after the limit
+static const uint8_t limit = CIE1931_CURVE[128];
+
+TEST(RGBLightOutput, black_stays_black) {
+  LED_TYPE in = color(0, 0, 0);
+  LED_TYPE out;
+  rgblight_output(&in, &out, 1, NULL);
+  EXPECT_EQ(out.r, 0);
+  EXPECT_EQ(out.g, 0);
+  EXPECT_EQ(out.b, 0);
+  EXPECT_EQ(out.w, 0);
+}
+
+TEST(RGBLightOutput, limits_the_brightness_to_the_curve_at_the_limit) {
+  LED_TYPE in = color(255, 0, 0);
+  LED_TYPE out;
+  rgblight_output(&in, &out, 1, NULL);
+  EXPECT_NEAR(out.r, limit, 1);
+  EXPECT_EQ(out.g, 0);
+  EXPECT_EQ(out.b, 0);
+}
+
+TEST(RGBLightOutput, applies_the_curve_before_scaling) {
+  LED_TYPE in = color(0, 200, 0);
+  LED_TYPE out;
+  rgblight_output(&in, &out, 1, NULL);
+  EXPECT_NEAR(out.g, curve(200) * limit / 255.0, 1);
+}
+
+TEST(RGBLightOutput, balances_the_white) {
+  LED_TYPE in = color(0, 0, 255);
+  LED_TYPE out;
+  rgblight_output(&in, &out, 1, NULL);
+  EXPECT_NEAR(out.b, limit * 200 / 255.0, 1);
+}
+
+TEST(RGBLightOutput, moves_the_common_part_to_the_white_led) {
+  LED_TYPE in = color(255, 255, 128);
+  LED_TYPE out;
+  rgblight_output(&in, &out, 1, NULL);
+  uint8_t blue = (curve(128) * limit * 200 / 255 + 254) / 255;
+  EXPECT_NEAR(out.w, blue, 1);
+  EXPECT_NEAR(out.r, limit - out.w, 1);
+  EXPECT_NEAR(out.g, limit - out.w, 1);
+  EXPECT_EQ(out.b, 0);
+}
+
+TEST(RGBLightOutput, converts_a_whole_frame_in_place) {
+  LED_TYPE frame[3] = {color(255, 0, 0), color(0, 255, 0), color(0, 0, 0)};
+  rgblight_output(frame, frame, 3, NULL);
+  EXPECT_NEAR(frame[0].r, limit, 1);
+  EXPECT_NEAR(frame[1].g, limit, 1);
+  EXPECT_EQ(frame[2].r, 0);
+}
+
+TEST(RGBLightOutput, sends_the_leds_set_as_rgb_as_they_are) {
+  LED_TYPE frame[3] = {color(200, 0, 0), color(200, 0, 0), color(128, 64, 200)};
+  // Only the first LED was set from HSV
+  uint8_t from_hsv[1] = {0x01};
+  rgblight_output(frame, frame, 3, from_hsv);
+  EXPECT_NEAR(frame[0].r, curve(200) * limit / 255.0, 1);
+  EXPECT_EQ(frame[1].r, 200);
+  EXPECT_EQ(frame[2].r, 128 - 64);
+  EXPECT_EQ(frame[2].g, 0);
+  EXPECT_EQ(frame[2].b, 200 - 64);
+  EXPECT_EQ(frame[2].w, 64);
+}
@@ -0,0 +1,31 @@
+quantum_color_SRC :=\
+	$(QUANTUM_PATH)/tests/color_tests.cpp \
+	$(QUANTUM_PATH)/color.c
+
+quantum_led_table_generator_SRC :=\
+	$(QUANTUM_PATH)/tests/led_table_generator_tests.cpp \
+	$(QUANTUM_PATH)/led_tables.c
+
+quantum_led_table_generator_DEFS := -DUSE_CIE1931_CURVE
+
+quantum_led_frame_SRC :=\
+	$(QUANTUM_PATH)/tests/led_frame_tests.cpp \
+	$(QUANTUM_PATH)/led_frame.c
+
+quantum_rgb_matrix_SRC :=\
+	$(QUANTUM_PATH)/tests/rgb_matrix_tests.cpp \
+	$(QUANTUM_PATH)/rgb_matrix.c \
+	$(QUANTUM_PATH)/color.c \
+	$(TMK_PATH)/common/test/timer.c
+
+quantum_rgb_matrix_DEFS := -DRGB_MATRIX_LED_COUNT=16 -DRGB_MATRIX_MAX_CURRENT=300
+
+quantum_rgblight_output_SRC :=\
+	$(QUANTUM_PATH)/tests/rgblight_output_tests.cpp \
+	$(QUANTUM_PATH)/rgblight_output.c \
+	$(QUANTUM_PATH)/led_tables.c
+
+quantum_rgblight_output_DEFS := -DUSE_CIE1931_CURVE -DRGBW -DRGBLIGHT_LIMIT_VAL=128 -DRGBLIGHT_WHITE_BALANCE_B=200
+
+quantum_led_power_SRC :=\
+	$(QUANTUM_PATH)/tests/led_power_tests.cpp
\ No newline at end of file
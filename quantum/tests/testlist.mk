@@ -0,0 +1,7 @@
+TEST_LIST +=\
+	quantum_color \
+	quantum_led_table_generator \
+	quantum_led_frame \
+	quantum_rgb_matrix \
+	quantum_rgblight_output \
+	quantum_led_power
\ No newline at end of file
@@ -0,0 +1,3 @@
+visualizer_math_SRC :=\
+	$(QUANTUM_PATH)/visualizer/tests/visualizer_math_tests.cpp \
+	$(QUANTUM_PATH)/visualizer/visualizer_math.c
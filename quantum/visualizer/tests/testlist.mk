@@ -0,0 +1,2 @@
+TEST_LIST +=\
+	visualizer_math
\ No newline at end of file
@@ -0,0 +1,135 @@
+/* Copyright 2018 Fred Sundvik
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <cmath>
+#include <cstdlib>
+extern "C" {
+#include "visualizer/visualizer_math.h"
+}
+
+// The floating point versions that used to be in led_backlight_keyframes.c
+// and lcd_backlight.c, the fixed point versions are compared against them
+
+static uint8_t float_gradient_color(float t, float index, float num) {
+    const float two_pi = M_PI * 2.0f;
+    float normalized_index = (1.0f - index / (num - 1.0f)) * two_pi;
+    float x = t * two_pi + normalized_index;
+    float v = 0.5 * (cosf(x) + 1.0f);
+    return (uint8_t)(255.0f * v);
+}
+
+static void float_hsi_to_rgb(float h, float s, float i, uint16_t* r_out, uint16_t* g_out, uint16_t* b_out) {
+    unsigned int r, g, b;
+    h = fmodf(h, 360.0f);
+    h = 3.14159f * h / 180.0f;
+    s = s > 0.0f ? (s < 1.0f ? s : 1.0f) : 0.0f;
+    i = i > 0.0f ? (i < 1.0f ? i : 1.0f) : 0.0f;
+
+    if(h < 2.09439f) {
+        r = 65535.0f * i/3.0f *(1.0f + s * cos(h) / cosf(1.047196667f - h));
+        g = 65535.0f * i/3.0f *(1.0f + s *(1.0f - cosf(h) / cos(1.047196667f - h)));
+        b = 65535.0f * i/3.0f *(1.0f - s);
+    } else if(h < 4.188787) {
+        h = h - 2.09439;
+        g = 65535.0f * i/3.0f *(1.0f + s * cosf(h) / cosf(1.047196667f - h));
+        b = 65535.0f * i/3.0f *(1.0f + s * (1.0f - cosf(h) / cosf(1.047196667f - h)));
+        r = 65535.0f * i/3.0f *(1.0f - s);
+    } else {
+        h = h - 4.188787;
+        b = 65535.0f*i/3.0f * (1.0f + s * cosf(h) / cosf(1.047196667f - h));
+        r = 65535.0f*i/3.0f * (1.0f + s * (1.0f - cosf(h) / cosf(1.047196667f - h)));
+        g = 65535.0f*i/3.0f * (1.0f - s);
+    }
+    *r_out = r > 65535 ? 65535 : r;
+    *g_out = g > 65535 ? 65535 : g;
+    *b_out = b > 65535 ? 65535 : b;
+}
+
+TEST(VisualizerMath, cos_matches_the_float_version) {
+    for (uint32_t angle = 0; angle < VISUALIZER_FULL_TURN; angle++) {
+        float expected = 32767.0f * cosf(angle * 2.0f * M_PI / VISUALIZER_FULL_TURN);
+        ASSERT_NEAR(visualizer_cos(angle), expected, 4) << "angle " << angle;
+    }
+}
+
+TEST(VisualizerMath, cos_has_exact_values_at_the_quarters) {
+    EXPECT_EQ(visualizer_cos(0), 32767);
+    EXPECT_EQ(visualizer_cos(VISUALIZER_FULL_TURN / 4), 0);
+    EXPECT_EQ(visualizer_cos(VISUALIZER_FULL_TURN / 2), -32767);
+    EXPECT_EQ(visualizer_cos(3 * VISUALIZER_FULL_TURN / 4), 0);
+}
+
+TEST(VisualizerMath, raised_cos_covers_the_full_range) {
+    EXPECT_EQ(visualizer_raised_cos8(0), 255);
+    EXPECT_EQ(visualizer_raised_cos8(VISUALIZER_FULL_TURN / 2), 0);
+}
+
+TEST(VisualizerMath, frame_position_goes_from_zero_to_a_full_turn) {
+    EXPECT_EQ(visualizer_frame_position(1000, 1000), 0);
+    EXPECT_EQ(visualizer_frame_position(1000, 500), VISUALIZER_FULL_TURN / 2);
+    EXPECT_EQ(visualizer_frame_position(1000, 0), VISUALIZER_FULL_TURN);
+    EXPECT_EQ(visualizer_frame_position(0, 0), 0);
+}
+
+TEST(VisualizerMath, gradient_matches_the_float_version) {
+    const int frame_length = 2000;
+    for (int num = 2; num <= 16; num++) {
+        for (int index = 0; index < num; index++) {
+            for (int time_left = frame_length; time_left >= 0; time_left -= 7) {
+                float t = (float)(frame_length - time_left) / frame_length;
+                int expected = float_gradient_color(t, index, num);
+                uint32_t position = visualizer_frame_position(frame_length, time_left);
+                int actual = visualizer_gradient_color(position, index, num);
+                ASSERT_NEAR(actual, expected, 1) << "num " << num << " index " << index << " time " << time_left;
+            }
+        }
+    }
+}
+
+TEST(VisualizerMath, hsi_to_rgb_matches_the_float_version) {
+    int max_error = 0;
+    for (int hue = 0; hue < 256; hue++) {
+        for (int saturation = 0; saturation < 256; saturation += 5) {
+            for (int intensity = 0; intensity < 256; intensity += 15) {
+                uint16_t r, g, b;
+                uint16_t er, eg, eb;
+                float_hsi_to_rgb(360.0f * hue / 255.0f, saturation / 255.0f, intensity / 255.0f, &er, &eg, &eb);
+                visualizer_hsi_to_rgb(hue, saturation, intensity * 257, &r, &g, &b);
+                max_error = std::max(max_error, std::abs(r - er));
+                max_error = std::max(max_error, std::abs(g - eg));
+                max_error = std::max(max_error, std::abs(b - eb));
+            }
+        }
+    }
+    EXPECT_LE(max_error, 16);
+}
+
+TEST(VisualizerMath, hsi_primaries) {
+    uint16_t r, g, b;
+    visualizer_hsi_to_rgb(0, 255, 65535, &r, &g, &b);
+    EXPECT_NEAR(r, 65535, 64);
+    EXPECT_NEAR(g, 0, 64);
+    EXPECT_EQ(b, 0);
+    visualizer_hsi_to_rgb(85, 255, 65535, &r, &g, &b);
+    EXPECT_NEAR(g, 65535, 64);
+    EXPECT_NEAR(r, 0, 64);
+    EXPECT_NEAR(b, 0, 64);
+    visualizer_hsi_to_rgb(0, 0, 65535, &r, &g, &b);
+    EXPECT_NEAR(r, 21845, 1);
+    EXPECT_NEAR(g, 21845, 1);
+    EXPECT_NEAR(b, 21845, 1);
+}
@@ -70,29 +70,62 @@ static visualizer_keyboard_status_t current_status = {
 #endif
 };
 
-static bool same_status(visualizer_keyboard_status_t* status1, visualizer_keyboard_status_t* status2) {
-    return status1->layer == status2->layer &&
-        status1->default_layer == status2->default_layer &&
-        status1->mods == status2->mods &&
-        status1->leds == status2->leds &&
-        status1->suspended == status2->suspended
+static uint8_t get_status_changes(visualizer_keyboard_status_t* status1, visualizer_keyboard_status_t* status2) {
+    uint8_t changes = 0;
+    if (status1->layer != status2->layer) {
+        changes |= VISUALIZER_CHANGED_LAYER;
+    }
+    if (status1->default_layer != status2->default_layer) {
+        changes |= VISUALIZER_CHANGED_DEFAULT_LAYER;
+    }
+    if (status1->mods != status2->mods) {
+        changes |= VISUALIZER_CHANGED_MODS;
+    }
+    if (status1->leds != status2->leds) {
+        changes |= VISUALIZER_CHANGED_LEDS;
+    }
+    if (status1->suspended != status2->suspended) {
+        changes |= VISUALIZER_CHANGED_SUSPENDED;
+    }
 #ifdef BACKLIGHT_ENABLE
-        && status1->backlight_level == status2->backlight_level
+    if (status1->backlight_level != status2->backlight_level) {
+        changes |= VISUALIZER_CHANGED_BACKLIGHT;
+    }
 #endif
 #ifdef VISUALIZER_USER_DATA_SIZE
-        && memcmp(status1->user_data, status2->user_data, VISUALIZER_USER_DATA_SIZE) == 0
+    if (memcmp(status1->user_data, status2->user_data, VISUALIZER_USER_DATA_SIZE) != 0) {
+        changes |= VISUALIZER_CHANGED_USER_DATA;
+    }
 #endif
-    ;
+    return changes;
 }
 
+// The changes made to current_status that the visualizer thread hasn't seen
+// yet. The thread reads both of them with the system locked.
+static uint8_t pending_changes = 0;
+
 static bool visualizer_enabled = false;
 
 #ifdef VISUALIZER_USER_DATA_SIZE
 static uint8_t user_data[VISUALIZER_USER_DATA_SIZE];
+static bool user_data_changed = false;
 #endif
 
-#define MAX_SIMULTANEOUS_ANIMATIONS 4
-static keyframe_animation_t* animations[MAX_SIMULTANEOUS_ANIMATIONS] = {};
+// The running animations, linked through the animations themselves and
+// ordered by when they need to be updated next, so there's no limit on how
+// many can run at the same time
+static keyframe_animation_t* animations = NULL;
+
+// The animation that update_due_animations is updating. It has been taken
+// out of the list, so its own frame functions can only change its state
+// when they start or stop it, and it's scheduled again after the update.
+static keyframe_animation_t* updating_animation = NULL;
+static bool updating_animation_restarted = false;
+
+// Continuously updating animations, like fades, are updated this often
+#ifndef VISUALIZER_REFRESH_INTERVAL
+#define VISUALIZER_REFRESH_INTERVAL 10
+#endif
 
 #ifdef SERIAL_LINK_ENABLE
 MASTER_TO_ALL_SLAVES_OBJECT(current_status, visualizer_keyboard_status_t);
@@ -120,57 +153,70 @@ GDisplay* get_led_display(void) {
 }
 #endif
 
-void start_keyframe_animation(keyframe_animation_t* animation) {
-    animation->current_frame = -1;
-    animation->time_left_in_frame = 0;
-    animation->need_update = true;
-    int free_index = -1;
-    for (int i=0;i<MAX_SIMULTANEOUS_ANIMATIONS;i++) {
-        if (animations[i] == animation) {
-            return;
-        }
-        if (free_index == -1 && animations[i] == NULL) {
-           free_index=i;
-        }
+// True if time a comes before time b, also when the tick counter wraps
+static bool time_before(systemticks_t a, systemticks_t b) {
+    return (systemticks_t)(a - b) > ((systemticks_t)-1) / 2;
+}
+
+static void schedule_animation(keyframe_animation_t* animation) {
+    keyframe_animation_t** pos = &animations;
+    while (*pos && !time_before(animation->next_update, (*pos)->next_update)) {
+        pos = &(*pos)->next;
     }
-    if (free_index!=-1) {
-        animations[free_index] = animation;
+    animation->next = *pos;
+    *pos = animation;
+}
+
+static bool unschedule_animation(keyframe_animation_t* animation) {
+    for (keyframe_animation_t** pos = &animations; *pos; pos = &(*pos)->next) {
+        if (*pos == animation) {
+            *pos = animation->next;
+            animation->next = NULL;
+            return true;
+        }
     }
+    return false;
 }
 
-void stop_keyframe_animation(keyframe_animation_t* animation) {
+static void reset_stopped_animation(keyframe_animation_t* animation) {
     animation->current_frame = animation->num_frames;
     animation->time_left_in_frame = 0;
     animation->need_update = true;
     animation->first_update_of_frame = false;
     animation->last_update_of_frame = false;
-    for (int i=0;i<MAX_SIMULTANEOUS_ANIMATIONS;i++) {
-        if (animations[i] == animation) {
-            animations[i] = NULL;
-            return;
-        }
+}
+
+void start_keyframe_animation(keyframe_animation_t* animation) {
+    animation->current_frame = -1;
+    animation->time_left_in_frame = 0;
+    animation->need_update = true;
+    animation->last_update = gfxSystemTicks();
+    animation->next_update = animation->last_update;
+    if (animation == updating_animation) {
+        updating_animation_restarted = true;
+        return;
     }
+    // A running animation is restarted
+    unschedule_animation(animation);
+    schedule_animation(animation);
 }
 
-void stop_all_keyframe_animations(void) {
-    for (int i=0;i<MAX_SIMULTANEOUS_ANIMATIONS;i++) {
-        if (animations[i]) {
-            animations[i]->current_frame = animations[i]->num_frames;
-            animations[i]->time_left_in_frame = 0;
-            animations[i]->need_update = true;
-            animations[i]->first_update_of_frame = false;
-            animations[i]->last_update_of_frame = false;
-            animations[i] = NULL;
-        }
+void stop_keyframe_animation(keyframe_animation_t* animation) {
+    reset_stopped_animation(animation);
+    if (animation == updating_animation) {
+        updating_animation_restarted = false;
+        return;
     }
+    unschedule_animation(animation);
 }
 
-static uint8_t get_num_running_animations(void) {
-    uint8_t count = 0;
-    for (int i=0;i<MAX_SIMULTANEOUS_ANIMATIONS;i++) {
-        count += animations[i] ? 1 : 0;
+void stop_all_keyframe_animations(void) {
+    while (animations) {
+        keyframe_animation_t* animation = animations;
+        animations = animation->next;
+        animation->next = NULL;
+        reset_stopped_animation(animation);
     }
-    return count;
 }
 
 static bool update_keyframe_animation(keyframe_animation_t* animation, visualizer_state_t* state, systemticks_t delta, systemticks_t* sleep_time) {
@@ -218,7 +264,14 @@ static bool update_keyframe_animation(keyframe_animation_t* animation, visualize
         animation->first_update_of_frame = false;
     }
 
-    systemticks_t wanted_sleep = animation->need_update ? gfxMillisecondsToTicks(10) : (unsigned)animation->time_left_in_frame;
+    systemticks_t wanted_sleep = (unsigned)animation->time_left_in_frame;
+    if (animation->need_update) {
+        // Don't go past the end of the frame
+        systemticks_t refresh = gfxMillisecondsToTicks(VISUALIZER_REFRESH_INTERVAL);
+        if (refresh < wanted_sleep) {
+            wanted_sleep = refresh;
+        }
+    }
     if (wanted_sleep < *sleep_time) {
         *sleep_time = wanted_sleep;
     }
@@ -226,6 +279,46 @@ static bool update_keyframe_animation(keyframe_animation_t* animation, visualize
     return true;
 }
 
+// Updates the animations that have reached their next update time
+static void update_due_animations(visualizer_state_t* state) {
+    systemticks_t now = gfxSystemTicks();
+
+    // Rescheduled animations always end up after now, so each animation is
+    // updated at most once, even if they are started or stopped by the
+    // frame functions
+    while (animations && !time_before(now, animations->next_update)) {
+        keyframe_animation_t* animation = animations;
+        animations = animation->next;
+        animation->next = NULL;
+        systemticks_t delta = now - animation->last_update;
+        animation->last_update = now;
+        systemticks_t sleep_time = TIME_INFINITE;
+        updating_animation = animation;
+        updating_animation_restarted = false;
+        bool running = update_keyframe_animation(animation, state, delta, &sleep_time);
+        updating_animation = NULL;
+        if (running && animation->current_frame != animation->num_frames) {
+            animation->next_update = now + sleep_time;
+            schedule_animation(animation);
+        }
+        else if (updating_animation_restarted) {
+            schedule_animation(animation);
+        }
+    }
+}
+
+// The time until the first animation in the list needs to be updated
+static systemticks_t get_time_to_next_animation(void) {
+    if (!animations) {
+        return TIME_INFINITE;
+    }
+    systemticks_t now = gfxSystemTicks();
+    if (time_before(now, animations->next_update)) {
+        return animations->next_update - now;
+    }
+    return 0;
+}
+
 void run_next_keyframe(keyframe_animation_t* animation, visualizer_state_t* state) {
     int next_frame = animation->current_frame + 1;
     if (next_frame == animation->num_frames) {
@@ -282,46 +375,55 @@ static DECLARE_THREAD_FUNCTION(visualizerThread, arg) {
             LCD_INT(state.current_lcd_color));
 #endif
 
-    systemticks_t sleep_time = TIME_INFINITE;
-    systemticks_t current_time = gfxSystemTicks();
     bool force_update = true;
 
     while(true) {
-        systemticks_t new_time = gfxSystemTicks();
-        systemticks_t delta = new_time - current_time;
-        current_time = new_time;
         bool enabled = visualizer_enabled;
-        if (force_update || !same_status(&state.status, &current_status)) {
+
+        // The producer has already worked out what changed, so waking up
+        // for an animation frame doesn't cost a status comparison
+        gfxSystemLock();
+        visualizer_keyboard_status_t new_status = current_status;
+        uint8_t changes = pending_changes;
+        pending_changes = 0;
+        gfxSystemUnlock();
+
+        if (force_update) {
             force_update = false;
+            changes = VISUALIZER_CHANGED_ALL;
+        }
+        if (changes) {
     #if BACKLIGHT_ENABLE
-            if(current_status.backlight_level != state.status.backlight_level) {
-                if (current_status.backlight_level != 0) {
+            if((changes & VISUALIZER_CHANGED_BACKLIGHT) &&
+                    new_status.backlight_level != state.status.backlight_level) {
+                if (new_status.backlight_level != 0) {
                     gdispGSetPowerMode(LED_DISPLAY, powerOn);
-                    uint16_t percent = (uint16_t)current_status.backlight_level * 100 / BACKLIGHT_LEVELS;
+                    uint16_t percent = (uint16_t)new_status.backlight_level * 100 / BACKLIGHT_LEVELS;
                     gdispGSetBacklight(LED_DISPLAY, percent);
                 }
                 else {
                     gdispGSetPowerMode(LED_DISPLAY, powerOff);
                 }
-                state.status.backlight_level = current_status.backlight_level;
+                state.status.backlight_level = new_status.backlight_level;
             }
     #endif
             if (visualizer_enabled) {
-                if (current_status.suspended) {
+                state.changes = changes;
+                if (new_status.suspended) {
                     stop_all_keyframe_animations();
                     visualizer_enabled = false;
-                    state.status = current_status;
+                    state.status = new_status;
                     user_visualizer_suspend(&state);
                 }
                 else {
                     visualizer_keyboard_status_t prev_status = state.status;
-                    state.status = current_status;
+                    state.status = new_status;
                     update_user_visualizer_state(&state, &prev_status);
                 }
                 state.prev_lcd_color = state.current_lcd_color;
             }
         }
-        if (!enabled && state.status.suspended && current_status.suspended == false) {
+        if (!enabled && state.status.suspended && new_status.suspended == false) {
             // Setting the status to the initial status will force an update
             // when the visualizer is enabled again
             state.status = initial_status;
@@ -330,12 +432,7 @@ static DECLARE_THREAD_FUNCTION(visualizerThread, arg) {
             user_visualizer_resume(&state);
             state.prev_lcd_color = state.current_lcd_color;
         }
-        sleep_time = TIME_INFINITE;
-        for (int i=0;i<MAX_SIMULTANEOUS_ANIMATIONS;i++) {
-            if (animations[i]) {
-                update_keyframe_animation(animations[i], &state, delta, &sleep_time);
-            }
-        }
+        update_due_animations(&state);
 #ifdef BACKLIGHT_ENABLE
         gdispGFlush(LED_DISPLAY);
 #endif
@@ -348,23 +445,14 @@ static DECLARE_THREAD_FUNCTION(visualizerThread, arg) {
         draw_emulator();
 #endif
         // Enable the visualizer when the startup or the suspend animation has finished
-        if (!visualizer_enabled && state.status.suspended == false && get_num_running_animations() == 0) {
+        if (!visualizer_enabled && state.status.suspended == false && animations == NULL) {
             visualizer_enabled = true;
             force_update = true;
-            sleep_time = 0;
         }
 
-        systemticks_t after_update = gfxSystemTicks();
-        unsigned update_delta = after_update - current_time;
-        if (sleep_time != TIME_INFINITE) {
-            if (sleep_time > update_delta) {
-                sleep_time -= update_delta;
-            }
-            else {
-                sleep_time = 0;
-            }
-        }
-        dprintf("Update took %d, last delta %d, sleep_time %d\n", update_delta, delta, sleep_time);
+        // Sleep until the next animation frame, or until the status changes
+        systemticks_t sleep_time = force_update ? 0 : get_time_to_next_animation();
+        dprintf("Sleep time %d\n", sleep_time);
 #ifdef PROTOCOL_CHIBIOS
         // The gEventWait function really takes milliseconds, even if the documentation says ticks.
         // Unfortunately there's no generic ugfx conversion from system time to milliseconds,
@@ -443,65 +531,91 @@ uint8_t visualizer_get_mods() {
 
 #ifdef VISUALIZER_USER_DATA_SIZE
 void visualizer_set_user_data(void* u) {
-    memcpy(user_data, u, VISUALIZER_USER_DATA_SIZE);
+    // Only compare the user data when it's set, instead of on every scan
+    if (memcmp(user_data, u, VISUALIZER_USER_DATA_SIZE) != 0) {
+        memcpy(user_data, u, VISUALIZER_USER_DATA_SIZE);
+        user_data_changed = true;
+    }
 }
 #endif
 
-void visualizer_update(uint32_t default_state, uint32_t state, uint8_t mods, uint32_t leds) {
-    // Note that there's a small race condition here, the thread could read
-    // a state where one of these are set but not the other. But this should
-    // not really matter as it will be fixed during the next loop step.
-    // Alternatively a mutex could be used instead of the volatile variables
+// Applies the changes to current_status and wakes up the visualizer thread
+static void post_status_changes(visualizer_keyboard_status_t* new_status, uint8_t changes) {
+    if (changes) {
+        gfxSystemLock();
+        current_status = *new_status;
+        pending_changes |= changes;
+        gfxSystemUnlock();
+    }
+    update_status(changes != 0);
+}
 
-    bool changed = false;
+void visualizer_update(uint32_t default_state, uint32_t state, uint8_t mods, uint32_t leds) {
+    // This is called on every scan, so the change mask is computed here once,
+    // field by field, and posted together with the status. The visualizer
+    // thread then only has to look at the mask.
 #ifdef SERIAL_LINK_ENABLE
     if (is_serial_link_connected ()) {
         visualizer_keyboard_status_t* new_status = read_current_status();
+        uint8_t changes = 0;
         if (new_status) {
-            if (!same_status(&current_status, new_status)) {
-                changed = true;
-                current_status = *new_status;
-            }
+            changes = get_status_changes(&current_status, new_status);
         }
+        post_status_changes(new_status, changes);
+        return;
     }
-    else {
-#else
-   {
 #endif
-        visualizer_keyboard_status_t new_status = {
-            .layer = state,
-            .default_layer = default_state,
-            .mods = mods,
-            .leds = leds,
-#ifdef BACKLIGHT_ENABLE
-            .backlight_level = current_status.backlight_level,
+    uint8_t changes = 0;
+    if (current_status.layer != state) {
+        changes |= VISUALIZER_CHANGED_LAYER;
+    }
+    if (current_status.default_layer != default_state) {
+        changes |= VISUALIZER_CHANGED_DEFAULT_LAYER;
+    }
+    if (current_status.mods != mods) {
+        changes |= VISUALIZER_CHANGED_MODS;
+    }
+    if (current_status.leds != leds) {
+        changes |= VISUALIZER_CHANGED_LEDS;
+    }
+#ifdef VISUALIZER_USER_DATA_SIZE
+    if (user_data_changed) {
+        user_data_changed = false;
+        changes |= VISUALIZER_CHANGED_USER_DATA;
+    }
 #endif
-            .suspended = current_status.suspended,
-        };
+    if (changes) {
+        visualizer_keyboard_status_t new_status = current_status;
+        new_status.layer = state;
+        new_status.default_layer = default_state;
+        new_status.mods = mods;
+        new_status.leds = leds;
 #ifdef VISUALIZER_USER_DATA_SIZE
-       memcpy(new_status.user_data, user_data, VISUALIZER_USER_DATA_SIZE);
+        memcpy(new_status.user_data, user_data, VISUALIZER_USER_DATA_SIZE);
 #endif
-        if (!same_status(&current_status, &new_status)) {
-            changed = true;
-            current_status = new_status;
-        }
+        post_status_changes(&new_status, changes);
+    }
+    else {
+        update_status(false);
     }
-    update_status(changed);
 }
 
 void visualizer_suspend(void) {
-    current_status.suspended = true;
-    update_status(true);
+    visualizer_keyboard_status_t new_status = current_status;
+    new_status.suspended = true;
+    post_status_changes(&new_status, VISUALIZER_CHANGED_SUSPENDED);
 }
 
 void visualizer_resume(void) {
-    current_status.suspended = false;
-    update_status(true);
+    visualizer_keyboard_status_t new_status = current_status;
+    new_status.suspended = false;
+    post_status_changes(&new_status, VISUALIZER_CHANGED_SUSPENDED);
 }
 
 #ifdef BACKLIGHT_ENABLE
 void backlight_set(uint8_t level) {
-    current_status.backlight_level = level;
-    update_status(true);
+    visualizer_keyboard_status_t new_status = current_status;
+    new_status.backlight_level = level;
+    post_status_changes(&new_status, VISUALIZER_CHANGED_BACKLIGHT);
 }
 #endif
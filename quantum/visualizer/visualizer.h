@@ -62,8 +62,10 @@ GDisplay* get_led_display(void);
 void draw_emulator(void);
 #endif
 
-// If you need support for more than 16 keyframes per animation, you can change this
+// If you need support for more than 16 keyframes per animation, you can change this in config.h
+#ifndef MAX_VISUALIZER_KEY_FRAMES
 #define MAX_VISUALIZER_KEY_FRAMES 16
+#endif
 
 struct keyframe_animation_t;
 
@@ -81,6 +83,17 @@ typedef struct {
 #endif
 } visualizer_keyboard_status_t;
 
+// Bits telling which fields of the status have changed since the previous
+// call to update_user_visualizer_state, see visualizer_state_t.changes
+#define VISUALIZER_CHANGED_LAYER (1 << 0)
+#define VISUALIZER_CHANGED_DEFAULT_LAYER (1 << 1)
+#define VISUALIZER_CHANGED_LEDS (1 << 2)
+#define VISUALIZER_CHANGED_MODS (1 << 3)
+#define VISUALIZER_CHANGED_SUSPENDED (1 << 4)
+#define VISUALIZER_CHANGED_BACKLIGHT (1 << 5)
+#define VISUALIZER_CHANGED_USER_DATA (1 << 6)
+#define VISUALIZER_CHANGED_ALL 0xFF
+
 // The state struct is used by the various keyframe functions
 // It's also used for setting the LCD color and layer text
 // from the user customized code
@@ -91,6 +104,9 @@ typedef struct visualizer_state_t {
 
     // The user visualizer(and animation functions) can read these
     visualizer_keyboard_status_t status;
+    // A combination of the VISUALIZER_CHANGED_ bits, all of them are set
+    // when the visualizer starts or resumes
+    uint8_t changes;
 
     // These are used by the animation functions
     uint32_t current_lcd_color;
@@ -123,6 +139,10 @@ typedef struct keyframe_animation_t {
     bool last_update_of_frame;
     bool need_update;
 
+    // Used by the scheduler, any number of animations can run at the same time
+    systemticks_t last_update;
+    systemticks_t next_update;
+    struct keyframe_animation_t* next;
 } keyframe_animation_t;
 
 extern GDisplay* LCD_DISPLAY;
@@ -141,6 +161,7 @@ void visualizer_set_user_data(void* user_data);
 
 // These functions have to be implemented by the user
 // Called regularly each time the state has changed (but not every scan loop)
+// state->changes tells which parts of the status are different from prev_status
 void update_user_visualizer_state(visualizer_state_t* state, visualizer_keyboard_status_t* prev_status);
 // Called when the computer goes to suspend, will also stop calling update_user_visualizer_state
 void user_visualizer_suspend(visualizer_state_t* state);
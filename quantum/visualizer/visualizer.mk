@@ -45,7 +45,8 @@ endef
 GDISP_DRIVER_LIST:=
 
 SRC += $(VISUALIZER_DIR)/visualizer.c \
-	$(VISUALIZER_DIR)/visualizer_keyframes.c
+	$(VISUALIZER_DIR)/visualizer_keyframes.c \
+	$(VISUALIZER_DIR)/visualizer_math.c
 EXTRAINCDIRS += $(GFXINC) $(VISUALIZER_DIR)
 GFXLIB = $(LIB_PATH)/ugfx
 VPATH += $(VISUALIZER_PATH)
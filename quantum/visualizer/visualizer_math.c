@@ -0,0 +1,145 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "visualizer_math.h"
+
+// cos(x) * 32767 for the first quarter of a turn, in 64 steps
+static const int16_t cos_table[65] = {
+    32767, 32757, 32728, 32678, 32609, 32521, 32412, 32285,
+    32137, 31971, 31785, 31580, 31356, 31113, 30852, 30571,
+    30273, 29956, 29621, 29268, 28898, 28510, 28105, 27683,
+    27245, 26790, 26319, 25832, 25329, 24811, 24279, 23731,
+    23170, 22594, 22005, 21403, 20787, 20159, 19519, 18868,
+    18204, 17530, 16846, 16151, 15446, 14732, 14010, 13279,
+    12539, 11793, 11039, 10278, 9512, 8739, 7962, 7179,
+    6393, 5602, 4808, 4011, 3212, 2410, 1608, 804,
+    0,
+};
+
+#define QUARTER_TURN (VISUALIZER_FULL_TURN / 4)
+
+// Linear interpolation in the table, angle is at most a quarter turn
+static int16_t quarter_cos(uint16_t angle) {
+    uint8_t index = angle >> 8;
+    if (index == 64) {
+        return 0;
+    }
+    int32_t from = cos_table[index];
+    int32_t to = cos_table[index + 1];
+    return from + (((to - from) * (angle & 0xFF)) >> 8);
+}
+
+int16_t visualizer_cos(uint16_t angle) {
+    uint16_t in_quarter = angle & (QUARTER_TURN - 1);
+    switch (angle / QUARTER_TURN) {
+    case 0:
+        return quarter_cos(in_quarter);
+    case 1:
+        return -quarter_cos(QUARTER_TURN - in_quarter);
+    case 2:
+        return -quarter_cos(in_quarter);
+    default:
+        return quarter_cos(QUARTER_TURN - in_quarter);
+    }
+}
+
+uint8_t visualizer_raised_cos8(uint16_t angle) {
+    return ((int32_t)visualizer_cos(angle) + 32767) * 255 / 65534;
+}
+
+uint32_t visualizer_frame_position(int frame_length, int time_left_in_frame) {
+    if (frame_length <= 0) {
+        return 0;
+    }
+    int current_pos = frame_length - time_left_in_frame;
+    // keep the multiplication below from overflowing for very long frames
+    while (frame_length > 0xFFFF) {
+        frame_length >>= 1;
+        current_pos >>= 1;
+    }
+    return ((uint32_t)current_pos * VISUALIZER_FULL_TURN) / (uint32_t)frame_length;
+}
+
+uint8_t visualizer_gradient_color(uint32_t position, uint8_t index, uint8_t num) {
+    uint32_t normalized_index = VISUALIZER_FULL_TURN;
+    if (num > 1) {
+        normalized_index -= (uint32_t)index * VISUALIZER_FULL_TURN / (num - 1);
+    }
+    return visualizer_raised_cos8(position + normalized_index);
+}
+
+// This code is based on Brian Neltner's blogpost and example code
+// "Why every LED light should be using HSI colorspace".
+// http://blog.saikoled.com/post/43693602826/why-every-led-light-should-be-using-hsi
+// The cosine ratio is computed in Q14 instead of floating point.
+void visualizer_hsi_to_rgb(uint8_t hue, uint8_t saturation, uint16_t intensity,
+        uint16_t* r, uint16_t* g, uint16_t* b) {
+    // The hue in 1/65536 turns, multiplied by three so that each of the three
+    // sectors is a full 65536 turn
+    uint32_t h3 = (uint32_t)hue * 3 * VISUALIZER_FULL_TURN / 255;
+    uint8_t sector = (h3 >> 16) % 3;
+    uint16_t h = (h3 & 0xFFFF) / 3;
+
+    // cos(h) / cos(60 degrees - h), the denominator is at least 0.5
+    int32_t numerator = visualizer_cos(h);
+    int32_t denominator = visualizer_cos(VISUALIZER_FULL_TURN / 6 - h);
+    int32_t ratio = (numerator << 14) / denominator;
+
+    int32_t base = (uint32_t)intensity / 3;
+    int32_t s = saturation;
+    int32_t first = base * ((1 << 14) + s * ratio / 255) >> 14;
+    int32_t second = base * ((1 << 14) + s * ((1 << 14) - ratio) / 255) >> 14;
+    int32_t third = base * (255 - s) / 255;
+
+    if (first > 65535) {
+        first = 65535;
+    }
+    if (second > 65535) {
+        second = 65535;
+    }
+    if (first < 0) {
+        first = 0;
+    }
+    if (second < 0) {
+        second = 0;
+    }
+
+    switch (sector) {
+    case 0:
+        *r = first;
+        *g = second;
+        *b = third;
+        break;
+    case 1:
+        *g = first;
+        *b = second;
+        *r = third;
+        break;
+    default:
+        *b = first;
+        *r = second;
+        *g = third;
+        break;
+    }
+}
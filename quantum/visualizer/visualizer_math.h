@@ -0,0 +1,56 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef QUANTUM_VISUALIZER_VISUALIZER_MATH_H_
+#define QUANTUM_VISUALIZER_VISUALIZER_MATH_H_
+
+#include <stdint.h>
+
+// Fixed point math for the keyframe animations, so that they don't need
+// floating point support, which is slow or missing on most of the boards.
+
+// Angles are expressed in 1/65536 of a full turn, so they wrap around
+// naturally, and the position in a frame can be used directly as an angle
+#define VISUALIZER_FULL_TURN 65536
+
+// The cosine of the angle as a signed Q15 value, between -32767 and 32767
+int16_t visualizer_cos(uint16_t angle);
+
+// Maps the cosine of the angle to 0-255, this is 255 * (cos(angle) + 1) / 2
+uint8_t visualizer_raised_cos8(uint16_t angle);
+
+// Returns how far the animation has progressed in the current frame,
+// 0 at the start and VISUALIZER_FULL_TURN at the end
+uint32_t visualizer_frame_position(int frame_length, int time_left_in_frame);
+
+// The luma of a cosine wave travelling over num leds, index is the led and
+// position is a value returned by visualizer_frame_position
+uint8_t visualizer_gradient_color(uint32_t position, uint8_t index, uint8_t num);
+
+// Converts a HSI color to 16 bit rgb values, the intensity is in the range
+// 0-65535 and the hue covers a full turn in the range 0-255
+void visualizer_hsi_to_rgb(uint8_t hue, uint8_t saturation, uint16_t intensity,
+    uint16_t* r, uint16_t* g, uint16_t* b);
+
+#endif /* QUANTUM_VISUALIZER_VISUALIZER_MATH_H_ */
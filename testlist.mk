@@ -2,6 +2,12 @@ TEST_LIST = $(notdir $(patsubst %/rules.mk,%,$(wildcard $(ROOT_DIR)/tests/*/rule
 FULL_TESTS := $(TEST_LIST)
 
 include $(ROOT_DIR)/quantum/serial_link/tests/testlist.mk
+include $(ROOT_DIR)/quantum/split_common/tests/testlist.mk
+include $(ROOT_DIR)/drivers/ugfx/gdisp/st7565/tests/testlist.mk
+include $(ROOT_DIR)/drivers/arm/tests/testlist.mk
+include $(ROOT_DIR)/quantum/visualizer/tests/testlist.mk
+include $(ROOT_DIR)/quantum/tests/testlist.mk
+include $(ROOT_DIR)/quantum/audio/tests/testlist.mk
 
 define VALIDATE_TEST_LIST
     ifneq ($1,)
@@ -23,6 +23,8 @@ endif
 # Project, sources and paths
 #
 
+COMMON_VPATH += $(DRIVER_PATH)/arm
+
 # Imported source files and paths
 CHIBIOS = $(TOP_DIR)/lib/chibios
 CHIBIOS_CONTRIB = $(TOP_DIR)/lib/chibios-contrib
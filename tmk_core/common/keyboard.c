@@ -207,7 +207,11 @@ void keyboard_task(void)
                         action_exec((keyevent_t){
                             .key = (keypos_t){ .row = r, .col = c },
                             .pressed = (matrix_row & ((matrix_row_t)1<<c)),
+#ifdef SERIAL_LINK_ENABLE
+                            .time = (serial_link_get_key_time(r, c) | 1) /* time should not be 0 */
+#else
                             .time = (timer_read() | 1) /* time should not be 0 */
+#endif
                         });
                         // record a processed key
                         matrix_prev[r] ^= ((matrix_row_t)1<<c);